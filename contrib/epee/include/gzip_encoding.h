@@ -30,7 +30,7 @@
 #ifndef _GZIP_ENCODING_H_
 #define _GZIP_ENCODING_H_
 #include "net/http_client_base.h"
-#include "zlib/zlib.h"
+#include <zlib.h>
 //#include "http.h"
 
 
@@ -59,6 +59,10 @@
 #include "../../../../src/p2p/network_throttle-detail.hpp"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES (64 * 1024 * 1024) // unsent data a peer may leave us holding before it is dropped
+#define ABSTRACT_SERVER_SEND_QUE_STALL_SECONDS 60 // a full send que only drops the peer once a write has been stuck on its socket this long
+#define ABSTRACT_SERVER_SEND_QUE_HARD_LIMIT_FACTOR 4 // a que that still drains may grow this many times the limits above, never further
+#define ABSTRACT_SERVER_SEND_CHUNK_SIZE (32 * 1024) // largest single write, so a socket that still drains completes writes often
 
 namespace epee
 {
@@ -73,6 +77,23 @@ namespace net_utils
   };
   
 
+  /************************************************************************/
+  /* Protocol handlers which know how much data they are waiting for can  */
+  /* provide get_recv_buffer(ptr, size) to have it read straight into     */
+  /* their own memory. Others are handed data read into buffer_.          */
+  /************************************************************************/
+  template<class t_protocol_handler>
+  auto get_protocol_recv_buffer(t_protocol_handler& handler, char*& ptr, size_t& size, int) -> decltype(handler.get_recv_buffer(ptr, size))
+  {
+    return handler.get_recv_buffer(ptr, size);
+  }
+
+  template<class t_protocol_handler>
+  bool get_protocol_recv_buffer(t_protocol_handler& handler, char*& ptr, size_t& size, long)
+  {
+    return false;
+  }
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -109,14 +130,13 @@ namespace net_utils
     void save_dbg_log();
 
 
-		bool speed_limit_is_enabled() const; ///< tells us should we be sleeping here (e.g. do not sleep on RPC connections)
+		bool speed_limit_is_enabled() const; ///< tells us whether this connection is rate limited (RPC connections are not)
 
     bool cancel();
     
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -126,6 +146,9 @@ namespace net_utils
     //------------------------------------------------------
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
+    /// Start reading into buffer_ or the protocol handler's own buffer.
+    void start_read(const boost::shared_ptr<connection<t_protocol_handler> >& self);
+
     /// Handle completion of a read operation.
     void handle_read(const boost::system::error_code& e,
       std::size_t bytes_transferred);
@@ -133,9 +156,20 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Write the next part of m_send_que.front(), after the rate limit allows it. Call with m_send_que_lock held.
+    void start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self);
+
+    /// The rate limit allows cb more bytes to be written.
+    void handle_send_timer(const boost::system::error_code& e, size_t cb);
+
+    /// The rate limit allows the next read.
+    void handle_recv_timer(const boost::system::error_code& e);
+
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
     //boost::array<char, 1024> buffer_;
+    /// Where the pending read goes.
+    char* m_recv_ptr;
 
     t_connection_context context;
     i_connection_filter* &m_pfilter;
@@ -146,7 +180,6 @@ namespace net_utils
     //typename t_protocol_handler::config_type m_dummy_config;
     std::list<boost::shared_ptr<connection<t_protocol_handler> > > m_self_refs; // add_ref/release support
     critical_section m_self_refs_lock;
-    critical_section m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
     
     t_connection_type m_connection_type;
     
@@ -77,6 +77,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 	)
 	: 
 		connection_basic(io_service, ref_sock_count, sock_number), 
+		m_recv_ptr(NULL),
 		m_protocol_handler(this, config, context),
 		m_pfilter( pfilter ),
 		m_connection_type( connection_type ),
@@ -160,11 +161,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     m_protocol_handler.after_init_connection();
 
-    socket_.async_read_some(boost::asio::buffer(buffer_),
-      strand_.wrap(
-        boost::bind(&connection<t_protocol_handler>::handle_read, self,
-          boost::asio::placeholders::error,
-          boost::asio::placeholders::bytes_transferred)));
+    start_read(self);
 #if !defined(_WIN32) || !defined(__i686)
 	// not supported before Windows7, too lazy for runtime check
 	// Just exclude for 32bit windows builds
@@ -273,6 +270,22 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_read(const boost::shared_ptr<connection<t_protocol_handler> >& self)
+  {
+    size_t size = 0;
+    if(!get_protocol_recv_buffer(m_protocol_handler, m_recv_ptr, size, 0) || !size)
+    {
+      m_recv_ptr = buffer_.data();
+      size = buffer_.size();
+    }
+    socket_.async_read_some(boost::asio::buffer(m_recv_ptr, size),
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_read, self,
+          boost::asio::placeholders::error,
+          boost::asio::placeholders::bytes_transferred)));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void connection<t_protocol_handler>::handle_read(const boost::system::error_code& e,
     std::size_t bytes_transferred)
   {
@@ -286,37 +299,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			m_throttle_speed_in.handle_trafic_exact(bytes_transferred);
 			context.m_current_speed_down = m_throttle_speed_in.get_current_speed();
 		}
-    
-    {
-			CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_in );
-			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred * 1024);
-		}
-
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
 
-
-		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-					CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred ); // decission from global throttle
-				}
-				
-				delay *= 0.5;
-				if (delay > 0) {
-					long int ms = (long int)(delay * 100);
-					epee::net_utils::data_logger::get_instance().add_data("sleep_down", ms);
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
-				}
-			} while(delay > 0);
-		} // any form of sleeping
-		
       //_info("[sock " << socket_.native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
       context.m_last_recv = time(NULL);
       context.m_recv_cnt += bytes_transferred;
-      bool recv_res = m_protocol_handler.handle_recv(buffer_.data(), bytes_transferred);
+      bool recv_res = m_protocol_handler.handle_recv(m_recv_ptr, bytes_transferred);
       if(!recv_res)
       {  
         //_info("[sock " << socket_.native_handle() << "] protocol_want_close");
@@ -332,11 +320,18 @@ PRAGMA_WARNING_DISABLE_VS(4355)
           shutdown();
       }else
       {
-        socket_.async_read_some(boost::asio::buffer(buffer_),
-          strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
-              boost::asio::placeholders::error,
-              boost::asio::placeholders::bytes_transferred)));
+        // over the download limit: leave the data in the socket until the bucket refills
+        double delay = speed_limit_is_enabled() ? reserve_recv(bytes_transferred) : 0;
+        if (delay > 0)
+        {
+          CRITICAL_REGION_LOCAL(m_send_que_lock);
+          m_recv_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(delay * 1000000)));
+          m_recv_timer.async_wait(boost::bind(&connection<t_protocol_handler>::handle_recv_timer, connection<t_protocol_handler>::shared_from_this(), _1));
+        }
+        else
+        {
+          start_read(connection<t_protocol_handler>::shared_from_this());
+        }
         //_info("[sock " << socket_.native_handle() << "]Async read requested.");
       }
     }else
@@ -380,92 +375,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     return true;
     CATCH_ENTRY_L0("connection<t_protocol_handler>::call_run_once_service_io", false);
   }
-  //---------------------------------------------------------------------------------
-    template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb) {
-    TRY_ENTRY();
-
-    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
-    auto self = safe_shared_from_this();
-    if (!self) return false;
-    if (m_was_shutdown) return false;
-		// TODO avoid copy
-
-		const double factor = 32; // TODO config
-		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
-		const t_safe chunksize_good = (t_safe)( 1024 * std::max(1.0,factor) );
-        const t_safe chunksize_max = chunksize_good * 2 ;
-		const bool allow_split = (m_connection_type == e_connection_type_RPC) ? false : true; // do not split RPC data
-
-        ASRT(! (chunksize_max<0) ); // make sure it is unsigned before removin sign with cast:
-        long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
-
-        if (allow_split && (cb > chunksize_max_unsigned)) {
-			{ // LOCK: chunking
-    		epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical *** 
-
-				_dbg3_c("net/out/size", "do_send() will SPLIT into small chunks, from packet="<<cb<<" B for ptr="<<ptr);
-				t_safe all = cb; // all bytes to send 
-				t_safe pos = 0; // current sending position
-				// 01234567890 
-				// ^^^^        (pos=0, len=4)     ;   pos:=pos+len, pos=4
-				//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
-				//         ^^^ (pos=8, len=4)    ;   
-
-				// const size_t bufsize = chunksize_good; // TODO safecast
-				// char* buf = new char[ bufsize ];
-
-				bool all_ok = true;
-				while (pos < all) {
-					t_safe lenall = all-pos; // length from here to end
-					t_safe len = std::min( chunksize_good , lenall); // take a smaller part
-					ASRT(len<=chunksize_good);
-					// pos=8; len=4; all=10;	len=3;
-
-                    ASRT(! (len<0) ); // check before we cast away sign:
-                    unsigned long long int len_unsigned = static_cast<long long int>( len );
-                    ASRT(len>0); // (redundand)
-                    ASRT(len_unsigned < std::numeric_limits<size_t>::max());   // yeap we want strong < then max size, to be sure
-					
-					void *chunk_start = ((char*)ptr) + pos;
-					_fact_c("net/out/size","chunk_start="<<chunk_start<<" ptr="<<ptr<<" pos="<<pos);
-					ASRT(chunk_start >= ptr); // not wrapped around address?
-					//std::memcpy( (void*)buf, chunk_start, len);
-
-					_dbg3_c("net/out/size", "part of " << lenall << ": pos="<<pos << " len="<<len);
-
-					bool ok = do_send_chunk(chunk_start, len); // <====== ***
-
-					all_ok = all_ok && ok;
-					if (!all_ok) {
-						_dbg1_c("net/out/size", "do_send() DONE ***FAILED*** from packet="<<cb<<" B for ptr="<<ptr);
-						_dbg1("do_send() SEND was aborted in middle of big package - this is mostly harmless "
-							<< " (e.g. peer closed connection) but if it causes trouble tell us at #monero-dev. " << cb);
-						return false; // partial failure in sending
-					}
-					pos = pos+len; ASRT(pos >0);
-
-					// (in catch block, or uniq pointer) delete buf;
-				} // each chunk
-
-				_dbg3_c("net/out/size", "do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
-				_dbg3  (                "do_send() DONE SPLIT from packet="<<cb<<" B for ptr="<<ptr);
-
-                _info_c("net/sleepRPC", "do_send() m_connection_type = " << m_connection_type);
-
-				return all_ok; // done - e.g. queued - all the chunks of current do_send call
-			} // LOCK: chunking
-		} // a big block (to be chunked) - all chunks
-		else { // small block
-			return do_send_chunk(ptr,cb); // just send as 1 big chunk
-		}
-
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
-
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -474,93 +386,107 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     if(m_was_shutdown)
       return false;
-    {
-		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
-		m_throttle_speed_out.handle_trafic_exact(cb);
-		context.m_current_speed_up = m_throttle_speed_out.get_current_speed();
-	}
 
     //_info("[sock " << socket_.native_handle() << "] SEND " << cb);
     context.m_last_send = time(NULL);
     context.m_send_cnt += cb;
     //some data should be wrote to stream
     //request complete
-    
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
 
     m_send_que_lock.lock(); // *** critical ***
     epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){m_send_que_lock.unlock();});
 
-    long int retry=0;
-    const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    // a peer that does not read what we send only gets to make us buffer so much;
+    // a single message is always accepted so that large responses still go out.
+    // A que held back by our own upload limit is not the peer's fault, so a full
+    // que is only dropped once its socket stopped taking data, or once it grew
+    // past the hard limit, which a peer reading just a trickle would reach.
+    // The bytes waiting on the rate limit right now don't count.
+    const size_t queued = m_send_que_bytes - m_send_que_offset - m_send_que_throttled;
+    const size_t count = m_send_que.size();
+    const bool que_full = count >= ABSTRACT_SERVER_SEND_QUE_MAX_COUNT || (count && queued + cb > ABSTRACT_SERVER_SEND_QUE_MAX_BYTES);
+    const bool que_over_hard_limit = count >= ABSTRACT_SERVER_SEND_QUE_MAX_COUNT * ABSTRACT_SERVER_SEND_QUE_HARD_LIMIT_FACTOR
+      || (count && queued + cb > (size_t)ABSTRACT_SERVER_SEND_QUE_MAX_BYTES * ABSTRACT_SERVER_SEND_QUE_HARD_LIMIT_FACTOR);
+    const bool stalled = m_write_started && time(NULL) - m_write_started >= ABSTRACT_SERVER_SEND_QUE_STALL_SECONDS;
+    if (que_over_hard_limit || (que_full && stalled))
     {
-        retry++;
-
-        /* if ( ::cryptonote::core::get_is_stopping() ) { // TODO re-add fast stop
-            _fact("ABORT queue wait due to stopping");
-            return false; // aborted
-        }*/
-
-        long int ms = 250 + (rand()%50);
-        _info_c("net/sleep", "Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<cb); // XXX debug sleep
-        m_send_que_lock.unlock();
-        boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-        m_send_que_lock.lock();
-        _dbg1("sleep for queue: " << ms);
-
-        if (retry > retry_limit) {
-            _erro("send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            //	_dbg1_c("net/sleep", "send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
-            shutdown();
-            return false;
-        }
+      _erro("[sock " << socket_.native_handle() << "] send que is full (" << count << " messages, " << queued << " bytes)" << (stalled ? " and the peer stopped reading" : "") << ", shutting down connection");
+      shutdown();
+      return false;
     }
 
     m_send_que.resize(m_send_que.size()+1);
     m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que_bytes += cb;
     
     if(m_send_que.size() > 1)
     { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = cb;
-        _info_c("net/out/size", "do_send() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
+        _info_c("net/out/size", "do_send() NOW just queues: packet="<<cb<<" B, is added to queue-size="<<m_send_que.size());
       LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
     }
     else
     { // no active operation
-
-        if(m_send_que.size()!=1)
-        {
-            _erro("Looks like no active operations, but send que size != 1!!");
-            return false;
-        }
-
-        auto size_now = m_send_que.front().size();
-        _dbg1_c("net/out/size", "do_send() NOW SENSD: packet="<<size_now<<" B");
-        if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
-
-        ASRT( size_now == m_send_que.front().size() );
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 //strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 //)
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
+        _dbg1_c("net/out/size", "do_send() NOW SENSD: packet="<<cb<<" B");
+        m_send_que_offset = 0;
+        start_write(self);
     }
-    
-    //do_send_handler_stop( ptr , cb ); // empty function
 
     return true;
 
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-  } // do_send_chunk
+  } // do_send()
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self)
+  {
+    // one chunk at a time, so connections waiting on the limit take turns and
+    // m_write_started shows whether the peer still reads
+    size_t size_now = std::min<size_t>(m_send_que.front().size() - m_send_que_offset, ABSTRACT_SERVER_SEND_CHUNK_SIZE);
+    if (speed_limit_is_enabled())
+    {
+      double delay = reserve_send(size_now);
+      if (delay > 0)
+      {
+        _dbg3_c("net/out/size", "start_write() delays packet="<<size_now<<" B by "<<delay<<" s");
+        m_send_que_throttled = size_now;
+        m_send_timer.expires_from_now(boost::posix_time::microseconds((int64_t)(delay * 1000000)));
+        m_send_timer.async_wait(boost::bind(&connection<t_protocol_handler>::handle_send_timer, self, _1, size_now));
+        return;
+      }
+    }
+    m_write_started = time(NULL);
+    boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data() + m_send_que_offset, size_now),
+                             boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
+                             );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_send_timer(const boost::system::error_code& e, size_t cb)
+  {
+    TRY_ENTRY();
+    if (e)
+      return; // cancelled by shutdown()
+    CRITICAL_REGION_LOCAL(m_send_que_lock);
+    m_send_que_throttled = 0;
+    if (m_was_shutdown || m_send_que.empty())
+      return;
+    // the bytes were already taken from the bucket in start_write()
+    m_write_started = time(NULL);
+    boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data() + m_send_que_offset, cb),
+                             boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
+                             );
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_send_timer", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::handle_recv_timer(const boost::system::error_code& e)
+  {
+    TRY_ENTRY();
+    if (e || m_was_shutdown)
+      return;
+    start_read(connection<t_protocol_handler>::shared_from_this());
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_recv_timer", void());
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   bool connection<t_protocol_handler>::shutdown()
@@ -569,6 +495,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     boost::system::error_code ignored_ec;
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     m_was_shutdown = true;
+    CRITICAL_REGION_BEGIN(m_send_que_lock);
+    m_send_timer.cancel(ignored_ec);
+    m_recv_timer.cancel(ignored_ec);
+    CRITICAL_REGION_END();
     m_protocol_handler.release_protocol();
     return true;
   }
@@ -612,9 +542,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     logger_handle_net_write(cb);
 
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
+    {
+      CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
+      m_throttle_speed_out.handle_trafic_exact(cb);
+      context.m_current_speed_up = m_throttle_speed_out.get_current_speed();
+    }
 
     bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
@@ -624,7 +556,14 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    m_write_started = 0;
+    m_send_que_offset += cb;
+    if(m_send_que_offset >= m_send_que.front().size())
+    {
+      m_send_que_bytes -= m_send_que.front().size();
+      m_send_que.pop_front();
+      m_send_que_offset = 0;
+    }
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -634,17 +573,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		auto size_now = m_send_que.front().size();
-		_dbg1_c("net/out/size", "handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
-		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		ASRT( size_now == m_send_que.front().size() );
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) , 
-        // strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-				// )
-        );
-      //_dbg3("(normal)" << size_now);
+      _dbg1_c("net/out/size", "handle_write() NOW SENDS: packet="<<m_send_que.front().size() - m_send_que_offset<<" B" <<", from  queue size="<<m_send_que.size());
+      start_write(connection<t_protocol_handler>::shared_from_this());
     }
     CRITICAL_REGION_END();
 
@@ -34,6 +34,9 @@
 #include "net_utils_base.h"
 #include "to_nonconst_iterator.h"
 #include "http_base.h"
+#ifdef HTTP_ENABLE_GZIP
+#include "http_server_compression.h"
+#endif
 
 namespace epee
 {
@@ -48,8 +51,16 @@ namespace net_utils
 		/************************************************************************/
 		struct http_server_config
 		{
+			http_server_config(): m_compression_level(0), m_compression_min_size(0)
+			{}
+
 			std::string m_folder;
 			critical_section m_lock;
+			int m_compression_level; //gzip level for responses, 0 disables compression
+			size_t m_compression_min_size; //smaller responses are sent as is
+#ifdef HTTP_ENABLE_GZIP
+			gzip_response_cache m_compression_cache;
+#endif
 		};
 
 		/************************************************************************/
@@ -118,6 +129,7 @@ namespace net_utils
 			bool slash_to_back_slash(std::string& str);
 			std::string get_file_mime_tipe(const std::string& path);
 			std::string get_response_header(const http_response_info& response);
+			void compress_response(const http::http_request_info& query_info, http_response_info& response);
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
@@ -539,6 +539,7 @@ namespace net_utils
 		http_response_info response;
 		bool res = handle_request(query_info, response);
 		//CHECK_AND_ASSERT_MES(res, res, "handle_request(query_info, response) returned false" );
+		compress_response(query_info, response);
 
 		std::string response_data = get_response_header(response);
 		
@@ -551,6 +552,33 @@ namespace net_utils
 		return res;
 	}
 	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::compress_response(const http::http_request_info& query_info, http_response_info& response)
+	{
+#ifdef HTTP_ENABLE_GZIP
+		if(!m_config.m_compression_level || response.m_response_code != 200 || response.m_body.size() < m_config.m_compression_min_size)
+			return;
+		if(get_value_from_fields_list("Content-Encoding", response.m_additional_fields).size() || !accepts_gzip(query_info.m_header_info))
+			return;
+
+		std::string gz;
+		if(!m_config.m_compression_cache.get(response.m_body, gz))
+		{
+			if(!gzip_compress(response.m_body, gz, m_config.m_compression_level))
+				return;
+			m_config.m_compression_cache.put(response.m_body, gz);
+		}
+		//already compressed content, not worth the header
+		if(gz.size() >= response.m_body.size())
+			return;
+
+		LOG_PRINT_L3("HTTP response compressed " << response.m_body.size() << " -> " << gz.size());
+		response.m_body.swap(gz);
+		response.m_additional_fields.push_back(std::make_pair("Content-Encoding", " gzip"));
+		response.m_additional_fields.push_back(std::make_pair("Vary", " Accept-Encoding"));
+#endif
+	}
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_request(const http::http_request_info& query_info, http_response_info& response)
 	{
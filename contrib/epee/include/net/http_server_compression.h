@@ -0,0 +1,170 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <zlib.h>
+#include "syncobj.h"
+#include "misc_log_ex.h"
+#include "reg_exp_definer.h"
+#include "http_base.h"
+
+namespace epee
+{
+namespace net_utils
+{
+  namespace http
+  {
+    /************************************************************************/
+    /*                                                                      */
+    /************************************************************************/
+    inline
+    bool gzip_compress(const std::string& in, std::string& out, int level)
+    {
+      z_stream zs;
+      memset(&zs, 0, sizeof(zs));
+      //window bits + 16 selects the gzip wrapper
+      int ret = deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+      CHECK_AND_ASSERT_MES(ret == Z_OK, false, "Failed to init deflate, err = " << ret);
+      out.resize(deflateBound(&zs, in.size()));
+      zs.next_in = (Bytef*)in.data();
+      zs.avail_in = (uInt)in.size();
+      zs.next_out = (Bytef*)&out[0];
+      zs.avail_out = (uInt)out.size();
+      ret = deflate(&zs, Z_FINISH);
+      deflateEnd(&zs);
+      CHECK_AND_ASSERT_MES(ret == Z_STREAM_END, false, "Failed to deflate, err = " << ret);
+      out.resize(zs.total_out);
+      return true;
+    }
+
+    /************************************************************************/
+    /*                                                                      */
+    /************************************************************************/
+    inline
+    bool accepts_gzip(const http_header_info& header_info)
+    {
+      STATIC_REGEXP_EXPR_1(rexp_match_gzip, "(^|,)\\s*(gzip|\\*)\\s*(;\\s*q\\s*=\\s*([0-9.]+))?\\s*(,|$)", boost::regex::icase | boost::regex::normal);
+      //                                       1       2                         4
+      std::string accept_encoding = get_value_from_fields_list("Accept-Encoding", header_info.m_etc_fields);
+      boost::smatch result;
+      if(!boost::regex_search(accept_encoding, result, rexp_match_gzip, boost::match_default) || !result[0].matched)
+        return false;
+      //"gzip;q=0" means the client refuses it
+      if(result[4].matched)
+      {
+        double q = 0;
+        if(!string_tools::get_xtype_from_string(q, result[4]))
+          return false;
+        return q > 0;
+      }
+      return true;
+    }
+
+    /************************************************************************/
+    /* Compressed bodies keyed by the uncompressed body, so identical       */
+    /* responses (the same block range served to several wallets) are only */
+    /* compressed once. A limit of 0 disables the cache.                    */
+    /************************************************************************/
+    class gzip_response_cache
+    {
+    public:
+      gzip_response_cache(): m_limit(0), m_size(0)
+      {}
+
+      void set_limit(size_t limit)
+      {
+        CRITICAL_REGION_LOCAL(m_lock);
+        m_limit = limit;
+        trim();
+      }
+
+      bool get(const std::string& body, std::string& gz)
+      {
+        CRITICAL_REGION_LOCAL(m_lock);
+        if(!m_limit)
+          return false;
+        auto it = m_index.find(std::hash<std::string>()(body));
+        if(it == m_index.end() || it->second->body != body)
+          return false;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        gz = it->second->gz;
+        return true;
+      }
+
+      void put(const std::string& body, const std::string& gz)
+      {
+        CRITICAL_REGION_LOCAL(m_lock);
+        const size_t cost = body.size() + gz.size();
+        if(cost > m_limit)
+          return;
+        const size_t key = std::hash<std::string>()(body);
+        auto it = m_index.find(key);
+        if(it != m_index.end())
+        {
+          m_size -= it->second->body.size() + it->second->gz.size();
+          m_entries.erase(it->second);
+          m_index.erase(it);
+        }
+        m_entries.push_front(entry{key, body, gz});
+        m_index[key] = m_entries.begin();
+        m_size += cost;
+        trim();
+      }
+
+    private:
+      struct entry
+      {
+        size_t key;
+        std::string body;
+        std::string gz;
+      };
+
+      void trim()
+      {
+        while(m_size > m_limit && !m_entries.empty())
+        {
+          const entry& e = m_entries.back();
+          m_size -= e.body.size() + e.gz.size();
+          m_index.erase(e.key);
+          m_entries.pop_back();
+        }
+      }
+
+      critical_section m_lock;
+      std::list<entry> m_entries;
+      std::unordered_map<size_t, std::list<entry>::iterator> m_index;
+      size_t m_limit;
+      size_t m_size;
+    };
+  }
+}
+}
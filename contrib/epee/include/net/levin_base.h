@@ -69,6 +69,7 @@ namespace levin
 
 #define LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED 0
 #define LEVIN_DEFAULT_MAX_PACKET_SIZE 100000000      //100MB by default
+#define LEVIN_INITIAL_BODY_BUFFER_SIZE (64 * 1024)   //the body buffer starts this big and doubles as data arrives
 
 #define LEVIN_PACKET_REQUEST			0x00000001
 #define LEVIN_PACKET_RESPONSE		0x00000002
@@ -126,6 +126,9 @@ public:
 
   std::string m_cache_in_buffer;
   stream_state m_state;
+  //body of the packet being received, allocated once its size is known
+  std::string m_body;
+  size_t m_body_received;
 
   int32_t m_oponent_protocol_ver;
   bool m_connection_initialized;
@@ -221,7 +224,8 @@ public:
             m_pservice_endpoint(psnd_hndlr), 
             m_config(config), 
             m_connection_context(conn_context), 
-            m_state(stream_state_head)
+            m_state(stream_state_head),
+            m_body_received(0)
   {
     m_close_called = 0;
     m_deletion_initiated = false;
@@ -309,6 +313,27 @@ public:
     m_config.m_pcommands_handler->callback(m_connection_context);
   }
 
+  //lets the connection read the rest of a packet body straight into place
+  //instead of handing it over in small chunks
+  bool get_recv_buffer(char*& ptr, size_t& size)
+  {
+    if(m_state != stream_state_body || m_body_received >= m_current_head.m_cb)
+      return false;
+    if(m_body_received == m_body.size())
+      grow_body();
+    ptr = &m_body[m_body_received];
+    size = m_body.size() - m_body_received;
+    return true;
+  }
+
+  //the body buffer is not sized from the header up front, a peer could claim
+  //a big packet and never send it: it grows at most by what was received
+  void grow_body()
+  {
+    size_t size = std::max<size_t>(m_body.size() * 2, LEVIN_INITIAL_BODY_BUFFER_SIZE);
+    m_body.resize(std::min<size_t>(size, m_current_head.m_cb));
+  }
+
   virtual bool handle_recv(const void* ptr, size_t cb)
   {
     if(boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
@@ -320,15 +345,23 @@ public:
       return false;
     }
 
-    if(m_cache_in_buffer.size() +  cb > m_config.m_max_packet_size)
+    if(m_state == stream_state_body && (const char*)ptr == m_body.data() + m_body_received && cb <= m_body.size() - m_body_received)
     {
-      LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
-                          << ", packet received " << m_cache_in_buffer.size() +  cb 
-                          << ", connection will be closed.");
-      return false;
+      //the connection read this straight into the body, see get_recv_buffer()
+      m_body_received += cb;
     }
+    else
+    {
+      if(m_cache_in_buffer.size() +  cb > m_config.m_max_packet_size)
+      {
+        LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
+                            << ", packet received " << m_cache_in_buffer.size() +  cb 
+                            << ", connection will be closed.");
+        return false;
+      }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
+      m_cache_in_buffer.append((const char*)ptr, cb);
+    }
 
     bool is_continue = true;
     while(is_continue)
@@ -336,20 +369,25 @@ public:
       switch(m_state)
       {
       case stream_state_body:
-        if(m_cache_in_buffer.size() < m_current_head.m_cb)
+        while(m_cache_in_buffer.size() && m_body_received < m_current_head.m_cb)
+        {
+          //data which came in together with the header
+          if(m_body_received == m_body.size())
+            grow_body();
+          size_t n = std::min(m_cache_in_buffer.size(), m_body.size() - m_body_received);
+          memcpy(&m_body[m_body_received], m_cache_in_buffer.data(), n);
+          m_cache_in_buffer.erase(0, n);
+          m_body_received += n;
+        }
+        if(m_body_received < m_current_head.m_cb)
         {
           is_continue = false;
           break;
         }
         {
           std::string buff_to_invoke;
-          if(m_cache_in_buffer.size()  == m_current_head.m_cb)
-            buff_to_invoke.swap(m_cache_in_buffer);
-          else
-          {
-            buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-            m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-          }
+          buff_to_invoke.swap(m_body);
+          m_body_received = 0;
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -456,6 +494,9 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          m_body.clear();
+          m_body_received = 0;
+          grow_body();
         }
         break;
       default:
@@ -96,6 +96,17 @@ namespace epee
       return obj.v._load(stg, hchild_section);
     }
     //-------------------------------------------------------------------------------------------------------------------
+    template<class stl_container>
+    static void reserve_stl_container(stl_container& container, size_t count)
+    {
+    }
+    //-------------------------------------------------------------------------------------------------------------------
+    template<class t_type>
+    static void reserve_stl_container(std::vector<t_type>& container, size_t count)
+    {
+      container.reserve(count);
+    }
+    //-------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
     static bool serialize_stl_container_t_val  (const stl_container& container, t_storage& stg, typename t_storage::hsection hparent_section, const char* pname)
     {
@@ -152,6 +163,7 @@ namespace epee
           false, 
           "size in blob " << loaded_size << " not have not zero modulo for sizeof(value_type) = " << sizeof(typename stl_container::value_type));
         size_t count = (loaded_size/sizeof(typename stl_container::value_type));
+        reserve_stl_container(container, count);
         for(size_t i = 0; i < count; i++)
           container.push_back(*(pelem++));
       }
@@ -187,7 +199,7 @@ namespace epee
       typename t_storage::harray hsec_array = stg.get_first_section(pname, hchild_section, hparent_section);
       if(!hsec_array || !hchild_section) return false;
       res = val._load(stg, hchild_section);
-      container.push_back(val);
+      container.push_back(std::move(val));
       while(stg.get_next_section(hsec_array, hchild_section))
       {
         typename stl_container::value_type val_l = typename stl_container::value_type();
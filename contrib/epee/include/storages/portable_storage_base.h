@@ -32,6 +32,7 @@
 #include <boost/any.hpp>
 #include <string>
 #include <list>
+#include <deque>
 
 #define PORTABLE_STORAGE_SIGNATUREA 0x01011101
 #define PORTABLE_STORAGE_SIGNATUREB 0x01020101 // bender's nightmare 
@@ -77,39 +78,39 @@ namespace epee
     template<class t_entry_type>
     struct array_entry_t
     {
-      array_entry_t():m_it(m_array.end()){}        
+      array_entry_t():m_it(0){}
 
       const t_entry_type* get_first_val() const 
       {
-        m_it = m_array.begin();
+        m_it = 0;
         return get_next_val();
       }
 
       t_entry_type* get_first_val() 
       {
-        m_it = m_array.begin();
+        m_it = 0;
         return get_next_val();
       }
 
 
       const t_entry_type* get_next_val() const 
       {
-        if(m_it == m_array.end())
+        if(m_it >= m_array.size())
           return nullptr;
-        return &(*(m_it++));
+        return &m_array[m_it++];
       }
 
       t_entry_type* get_next_val() 
       {
-        if(m_it == m_array.end())
+        if(m_it >= m_array.size())
           return nullptr;
-        return (t_entry_type*)&(*(m_it++));//fuckoff
+        return &m_array[m_it++];
       }
 
       t_entry_type& insert_first_val(const t_entry_type& v)
       {
         m_array.clear();
-        m_it = m_array.end();
+        m_it = 0;
         return insert_next_value(v);
       }
 
@@ -119,8 +120,9 @@ namespace epee
         return m_array.back();
       }
 
-      std::list<t_entry_type> m_array;
-      mutable typename std::list<t_entry_type>::const_iterator m_it;
+      //deque rather than vector: handles to inserted sections must survive later inserts
+      std::deque<t_entry_type> m_array;
+      mutable size_t m_it;
     };
 
 
@@ -0,0 +1,314 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+#pragma once 
+
+#include <deque>
+#include <sstream>
+#include <type_traits>
+#include "misc_language.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Writes JSON straight into a string while a KV_SERIALIZE map is     */
+    /* being stored, laid out the same way as portable_storage::          */
+    /* dump_as_json. Entries come out in the order they are serialized    */
+    /* rather than sorted by name.                                        */
+    /************************************************************************/
+    class portable_storage_json_writer
+    {
+    public:
+      //a section or array still being written; it is closed once something
+      //outside it is touched
+      struct frame
+      {
+        size_t count;
+        size_t indent;
+        bool is_array;
+      };
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_json_writer(size_t indent = 0, bool insert_newlines = true);
+      hsection   open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       set_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      bool       set_value(const std::string& value_name, const storage_entry& target, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool          insert_next_value(harray hval_array, const t_value& target);
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section);
+      bool            insert_next_section(harray hSecArray, hsection& hinserted_childsection);
+
+      //-------------------------------------------------------------------------------
+      //finishes the buffer, nothing may be written afterwards
+      bool		store_to_json(std::string& target);
+
+    private:
+      void enter(frame* pframe);
+      void close_top_frame();
+      frame* push_section(size_t indent);
+      void add_entry_name(const std::string& name, hsection hparent_section);
+      void write_indent(size_t indent) { m_buff.append(indent * 2, ' '); }
+      void write_string(const std::string& v);
+      void write_value(const std::string& v) { write_string(v); }
+      void write_value(bool v) { m_buff += v ? "true" : "false"; }
+      void write_value(double v);
+      template<class t_value>
+      void write_value(const t_value& v);
+
+      std::string m_buff;
+      std::string m_newline;
+      std::deque<frame> m_frames;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_json_writer::portable_storage_json_writer(size_t indent, bool insert_newlines):
+      m_newline(insert_newlines ? "\r\n" : "")
+    {
+      push_section(indent);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_json_writer::frame* portable_storage_json_writer::push_section(size_t indent)
+    {
+      m_buff += '{';
+      m_buff += m_newline;
+      m_frames.push_back(frame{0, indent, false});
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_json_writer::close_top_frame()
+    {
+      const frame& f = m_frames.back();
+      if(f.is_array)
+      {
+        m_buff += ']';
+      }
+      else
+      {
+        if(f.count)
+          m_buff += m_newline;
+        write_indent(f.indent);
+        m_buff += '}';
+      }
+      m_frames.pop_back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_json_writer::enter(frame* pframe)
+    {
+      if(!pframe)
+        pframe = &m_frames.front();
+      while(!m_frames.empty() && &m_frames.back() != pframe)
+        close_top_frame();
+      CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "portable_storage_json_writer: writing to a section or array which is already closed");
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_json_writer::write_string(const std::string& v)
+    {
+      m_buff += '"';
+      size_t start = 0;
+      for(size_t i = 0; i != v.size(); ++i)
+      {
+        const char* esc;
+        switch(v[i])
+        {
+        case '\b': esc = "\\b"; break;
+        case '\f': esc = "\\f"; break;
+        case '\n': esc = "\\n"; break;
+        case '\r': esc = "\\r"; break;
+        case '\t': esc = "\\t"; break;
+        case '\v': esc = "\\v"; break;
+        case '"':  esc = "\\\""; break;
+        case '\\': esc = "\\\\"; break;
+        case '/':  esc = "\\/"; break;
+        default: continue;
+        }
+        m_buff.append(v, start, i - start);
+        m_buff += esc;
+        start = i + 1;
+      }
+      m_buff.append(v, start, std::string::npos);
+      m_buff += '"';
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_json_writer::write_value(double v)
+    {
+      //same as the default ostream formatting used by dump_as_json
+      char buf[32];
+      int len = snprintf(buf, sizeof(buf), "%g", v);
+      m_buff.append(buf, len);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_json_writer::write_value(const t_value& v)
+    {
+      static_assert(std::is_integral<t_value>::value, "portable_storage_json_writer: unsupported value type");
+      //int8_t and uint8_t are written as numbers too, not as characters
+      typedef typename std::conditional<std::is_signed<t_value>::value, int64_t, uint64_t>::type wide_type;
+      wide_type w = v;
+      const bool negative = w < 0;
+      char buf[24];
+      char* p = buf + sizeof(buf);
+      do
+      {
+        wide_type digit = w % 10;
+        *--p = static_cast<char>('0' + (negative ? -digit : digit));
+        w /= 10;
+      } while(w);
+      if(negative)
+        *--p = '-';
+      m_buff.append(p, buf + sizeof(buf) - p);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_json_writer::add_entry_name(const std::string& name, hsection hparent_section)
+    {
+      enter(hparent_section);
+      frame& f = m_frames.back();
+      CHECK_AND_ASSERT_THROW_MES(!f.is_array, "portable_storage_json_writer: named entry written to an array");
+      if(f.count++)
+      {
+        m_buff += ',';
+        m_buff += m_newline;
+      }
+      write_indent(f.indent + 1);
+      write_string(name);
+      m_buff += ": ";
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_json_writer::hsection portable_storage_json_writer::open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      add_entry_name(section_name, hparent_section);
+      return push_section(m_frames.back().indent + 1);
+      CATCH_ENTRY("portable_storage_json_writer::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_json_writer::set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(value_name, hparent_section);
+      write_value(v);
+      return true;
+      CATCH_ENTRY("portable_storage_json_writer::template<>set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_json_writer::set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(value_name, hparent_section);
+      //only used for small values such as json rpc ids
+      std::stringstream ss;
+      dump_as_json(ss, v, m_frames.back().indent + 1, !m_newline.empty());
+      m_buff += ss.str();
+      return true;
+      CATCH_ENTRY("portable_storage_json_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_json_writer::harray portable_storage_json_writer::insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(value_name, hparent_section);
+      m_buff += '[';
+      m_frames.push_back(frame{1, m_frames.back().indent + 1, true});
+      harray hval_array = &m_frames.back();
+      write_value(target);
+      return hval_array;
+      CATCH_ENTRY("portable_storage_json_writer::insert_first_value", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_json_writer::insert_next_value(harray hval_array, const t_value& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+      enter(hval_array);
+      ++hval_array->count;
+      m_buff += ',';
+      write_value(target);
+      return true;
+      CATCH_ENTRY("portable_storage_json_writer::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_json_writer::harray portable_storage_json_writer::insert_first_section(const std::string& sec_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(sec_name, hparent_section);
+      m_buff += '[';
+      m_frames.push_back(frame{1, m_frames.back().indent + 1, true});
+      harray hsec_array = &m_frames.back();
+      hinserted_childsection = push_section(hsec_array->indent);
+      return hsec_array;
+      CATCH_ENTRY("portable_storage_json_writer::insert_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_json_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      enter(hsec_array);
+      ++hsec_array->count;
+      m_buff += ',';
+      hinserted_childsection = push_section(hsec_array->indent);
+      return true;
+      CATCH_ENTRY("portable_storage_json_writer::insert_next_section", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_json_writer::store_to_json(std::string& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(!m_frames.empty(), false, "portable_storage_json_writer: buffer already stored");
+      while(!m_frames.empty())
+        close_top_frame();
+      target.swap(m_buff);
+      m_buff.clear();
+      return true;
+      CATCH_ENTRY("portable_storage_json_writer::store_to_json", false);
+    }
+  }
+}
@@ -0,0 +1,426 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+#pragma once 
+
+#include <deque>
+#include <vector>
+#include "misc_language.h"
+#include "portable_storage_base.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Reads the binary portable storage format for a KV_SERIALIZE map     */
+    /* without building the section tree. Loading only indexes where each */
+    /* entry lives in the buffer; values are decoded from there straight  */
+    /* into the target fields. The buffer must outlive the reader.        */
+    /************************************************************************/
+    class portable_storage_reader
+    {
+    public:
+      struct entry
+      {
+        const char* name;
+        uint8_t name_len;
+        uint8_t type;           //for arrays, the type of the elements with SERIALIZE_FLAG_ARRAY set
+        const uint8_t* data;    //the type byte, for handing the entry to throwable_buffer_reader
+        const uint8_t* value;   //the value, or first array element
+        size_t count;           //number of array elements
+        size_t section;         //index of the section, or of the first section of an array
+      };
+      struct section_index
+      {
+        size_t first;           //index of the first entry
+        size_t count;
+      };
+      struct array_cursor
+      {
+        const entry* pentry;
+        size_t index;
+        const uint8_t* pos;
+      };
+      typedef const section_index* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_reader(): m_end(nullptr) { m_empty_section.first = m_empty_section.count = 0; }
+      hsection   open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool       get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool          get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const std::string& pSectionName, hsection& h_child_section, hsection hparent_section);
+      bool            get_next_section(harray hSecArray, hsection& h_child_section);
+
+      //-------------------------------------------------------------------------------
+      bool		load_from_binary(const binarybuffer& source);
+
+    private:
+      const entry* find_entry(const std::string& name, hsection hparent_section) const;
+      template<class t_value>
+      void read_value(uint8_t type, const uint8_t*& pos, t_value& target) const;
+
+      //index building
+      void need(const uint8_t* pos, size_t count) const;
+      size_t read_varint(const uint8_t*& pos) const;
+      void index_section(size_t section, const uint8_t*& pos, size_t depth);
+      void index_array(entry& e, const uint8_t*& pos, size_t depth);
+
+      const uint8_t* m_end;
+      std::vector<entry> m_entries;
+      std::vector<section_index> m_sections;
+      std::deque<array_cursor> m_cursors;
+      section_index m_empty_section;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::need(const uint8_t* pos, size_t count) const
+    {
+      CHECK_AND_ASSERT_THROW_MES(count <= static_cast<size_t>(m_end - pos), " attempt to read " << count << " bytes from buffer with " << (m_end - pos) << " bytes remained");
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_reader::read_varint(const uint8_t*& pos) const
+    {
+      need(pos, 1);
+      uint64_t v = 0;
+      switch (*pos & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE: need(pos, 1); v = *pos; pos += 1; break;
+      case PORTABLE_RAW_SIZE_MARK_WORD: { uint16_t w; need(pos, 2); memcpy(&w, pos, 2); v = w; pos += 2; break; }
+      case PORTABLE_RAW_SIZE_MARK_DWORD: { uint32_t d; need(pos, 4); memcpy(&d, pos, 4); v = d; pos += 4; break; }
+      case PORTABLE_RAW_SIZE_MARK_INT64: need(pos, 8); memcpy(&v, pos, 8); pos += 8; break;
+      }
+      return static_cast<size_t>(v >> 2);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::index_section(size_t section, const uint8_t*& pos, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      size_t count = read_varint(pos);
+      //every entry takes at least a name length and a type byte
+      CHECK_AND_ASSERT_THROW_MES(count <= static_cast<size_t>(m_end - pos) / 2, "section entry count " << count << " goes out of remain storage len " << (m_end - pos));
+      size_t first = m_entries.size();
+      m_sections[section].first = first;
+      m_sections[section].count = count;
+      m_entries.resize(first + count);
+      for(size_t n = 0; n != count; ++n)
+      {
+        //nested sections append to m_entries, so work on a copy
+        entry e = AUTO_VAL_INIT(e);
+        need(pos, 1);
+        e.name_len = *pos++;
+        need(pos, e.name_len);
+        e.name = (const char*)pos;
+        pos += e.name_len;
+        need(pos, 1);
+        e.data = pos;
+        e.type = *pos++;
+        if(e.type == SERIALIZE_TYPE_ARRAY)
+        {
+          need(pos, 1);
+          e.type = *pos++;
+          CHECK_AND_ASSERT_THROW_MES(e.type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+        }
+        if(e.type & SERIALIZE_FLAG_ARRAY)
+        {
+          index_array(e, pos, depth + 1);
+        }
+        else
+        {
+          e.value = pos;
+          switch(e.type)
+          {
+          case SERIALIZE_TYPE_INT64:  case SERIALIZE_TYPE_UINT64: case SERIALIZE_TYPE_DUOBLE: need(pos, 8); pos += 8; break;
+          case SERIALIZE_TYPE_INT32:  case SERIALIZE_TYPE_UINT32: need(pos, 4); pos += 4; break;
+          case SERIALIZE_TYPE_INT16:  case SERIALIZE_TYPE_UINT16: need(pos, 2); pos += 2; break;
+          case SERIALIZE_TYPE_INT8:   case SERIALIZE_TYPE_UINT8: case SERIALIZE_TYPE_BOOL: need(pos, 1); pos += 1; break;
+          case SERIALIZE_TYPE_STRING:
+            {
+              size_t len = read_varint(pos);
+              CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+              need(pos, len);
+              pos += len;
+              break;
+            }
+          case SERIALIZE_TYPE_OBJECT:
+            e.section = m_sections.size();
+            m_sections.resize(e.section + 1);
+            index_section(e.section, pos, depth + 1);
+            break;
+          default:
+            CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << (unsigned)e.type);
+          }
+        }
+        m_entries[first + n] = e;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::index_array(entry& e, const uint8_t*& pos, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      e.count = read_varint(pos);
+      e.value = pos;
+      size_t elem_size = 0;
+      switch(e.type & ~SERIALIZE_FLAG_ARRAY)
+      {
+      case SERIALIZE_TYPE_INT64:  case SERIALIZE_TYPE_UINT64: case SERIALIZE_TYPE_DUOBLE: elem_size = 8; break;
+      case SERIALIZE_TYPE_INT32:  case SERIALIZE_TYPE_UINT32: elem_size = 4; break;
+      case SERIALIZE_TYPE_INT16:  case SERIALIZE_TYPE_UINT16: elem_size = 2; break;
+      case SERIALIZE_TYPE_INT8:   case SERIALIZE_TYPE_UINT8: case SERIALIZE_TYPE_BOOL: elem_size = 1; break;
+      case SERIALIZE_TYPE_STRING:
+        CHECK_AND_ASSERT_THROW_MES(e.count <= static_cast<size_t>(m_end - pos), "array size " << e.count << " goes out of remain storage len " << (m_end - pos));
+        for(size_t n = 0; n != e.count; ++n)
+        {
+          size_t len = read_varint(pos);
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          need(pos, len);
+          pos += len;
+        }
+        return;
+      case SERIALIZE_TYPE_OBJECT:
+        CHECK_AND_ASSERT_THROW_MES(e.count <= static_cast<size_t>(m_end - pos), "array size " << e.count << " goes out of remain storage len " << (m_end - pos));
+        e.section = m_sections.size();
+        m_sections.resize(e.section + e.count);
+        for(size_t n = 0; n != e.count; ++n)
+          index_section(e.section + n, pos, depth + 1);
+        return;
+      case SERIALIZE_TYPE_ARRAY:
+        //arrays of arrays can't be loaded into a KV_SERIALIZE map, only check and skip them
+        CHECK_AND_ASSERT_THROW_MES(e.count <= static_cast<size_t>(m_end - pos), "array size " << e.count << " goes out of remain storage len " << (m_end - pos));
+        for(size_t n = 0; n != e.count; ++n)
+        {
+          entry inner = AUTO_VAL_INIT(inner);
+          need(pos, 1);
+          inner.type = *pos++;
+          CHECK_AND_ASSERT_THROW_MES(inner.type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+          index_array(inner, pos, depth + 1);
+        }
+        return;
+      default:
+        CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << (unsigned)e.type);
+      }
+      CHECK_AND_ASSERT_THROW_MES(e.count <= static_cast<size_t>(m_end - pos) / elem_size, "array size " << e.count << " goes out of remain storage len " << (m_end - pos));
+      pos += e.count * elem_size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::load_from_binary(const binarybuffer& source)
+    {
+      m_entries.clear();
+      m_sections.clear();
+      m_cursors.clear();
+      const size_t header_size = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << header_size);
+        return false;
+      }
+      uint32_t signature_a, signature_b;
+      memcpy(&signature_a, source.data(), sizeof(uint32_t));
+      memcpy(&signature_b, source.data() + sizeof(uint32_t), sizeof(uint32_t));
+      uint8_t ver = source[2 * sizeof(uint32_t)];
+      if(signature_a != PORTABLE_STORAGE_SIGNATUREA ||
+        signature_b != PORTABLE_STORAGE_SIGNATUREB
+        )
+      {
+        LOG_ERROR("portable_storage: wrong binary format - signature missmatch");
+        return false;
+      }
+      if(ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << ver);
+        return false;
+      }
+      TRY_ENTRY();
+      const uint8_t* pos = (const uint8_t*)source.data() + header_size;
+      m_end = (const uint8_t*)source.data() + source.size();
+      CHECK_AND_ASSERT_THROW_MES(pos != m_end, "throwable_buffer_reader: sz==0");
+      m_sections.resize(1);
+      index_section(0, pos, 0);
+      return true;
+      CATCH_ENTRY("portable_storage_reader::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_reader::entry* portable_storage_reader::find_entry(const std::string& name, hsection hparent_section) const
+    {
+      if(!hparent_section)
+      {
+        if(m_sections.empty())
+          return nullptr;
+        hparent_section = &m_sections.front();
+      }
+      //sections are small, a linear scan beats building a map
+      const entry* e = m_entries.data() + hparent_section->first;
+      for(const entry* end = e + hparent_section->count; e != end; ++e)
+      {
+        if(e->name_len == name.size() && !memcmp(e->name, name.data(), name.size()))
+          return e;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void convert_from_blob(const uint8_t* data, size_t len, t_value& to)
+    {
+      std::string from((const char*)data, len);
+      convert_t(from, to);
+    }
+    inline
+    void convert_from_blob(const uint8_t* data, size_t len, std::string& to)
+    {
+      to.assign((const char*)data, len);
+    }
+    template<class from_type, class t_value>
+    void convert_from_pod(const uint8_t*& pos, t_value& to)
+    {
+      from_type from;
+      memcpy(&from, pos, sizeof(from_type));
+      pos += sizeof(from_type);
+      convert_t(from, to);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_reader::read_value(uint8_t type, const uint8_t*& pos, t_value& target) const
+    {
+      switch(type & ~SERIALIZE_FLAG_ARRAY)
+      {
+      case SERIALIZE_TYPE_INT64:  convert_from_pod<int64_t>(pos, target); break;
+      case SERIALIZE_TYPE_INT32:  convert_from_pod<int32_t>(pos, target); break;
+      case SERIALIZE_TYPE_INT16:  convert_from_pod<int16_t>(pos, target); break;
+      case SERIALIZE_TYPE_INT8:   convert_from_pod<int8_t>(pos, target); break;
+      case SERIALIZE_TYPE_UINT64: convert_from_pod<uint64_t>(pos, target); break;
+      case SERIALIZE_TYPE_UINT32: convert_from_pod<uint32_t>(pos, target); break;
+      case SERIALIZE_TYPE_UINT16: convert_from_pod<uint16_t>(pos, target); break;
+      case SERIALIZE_TYPE_UINT8:  convert_from_pod<uint8_t>(pos, target); break;
+      case SERIALIZE_TYPE_DUOBLE: convert_from_pod<double>(pos, target); break;
+      case SERIALIZE_TYPE_BOOL:   convert_from_pod<bool>(pos, target); break;
+      case SERIALIZE_TYPE_STRING:
+        {
+          //lengths were checked when indexing
+          size_t len = read_varint(pos);
+          convert_from_blob(pos, len, target);
+          pos += len;
+          break;
+        }
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from type code=" << (unsigned)type << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::hsection portable_storage_reader::open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist)
+    {
+      const entry* e = find_entry(section_name, hparent_section);
+      if(e && e->type == SERIALIZE_TYPE_OBJECT)
+        return &m_sections[e->section];
+      //like portable_storage, hand out an empty section rather than fail
+      return create_if_notexist ? &m_empty_section : nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e)
+        return false;
+      CHECK_AND_ASSERT_THROW_MES(!(e->type & SERIALIZE_FLAG_ARRAY), "WRONG DATA CONVERSION: from array to type " << typeid(t_value).name());
+      const uint8_t* pos = e->value;
+      read_value(e->type, pos, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e)
+        return false;
+      throwable_buffer_reader buf_reader(e->data, m_end - e->data);
+      val = buf_reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_reader::harray portable_storage_reader::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e || !(e->type & SERIALIZE_FLAG_ARRAY) || !e->count)
+        return nullptr;
+      array_cursor c = {e, 1, e->value};
+      read_value(e->type, c.pos, target);
+      m_cursors.push_back(c);
+      return &m_cursors.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      CHECK_AND_ASSERT(hval_array, false);
+      if(hval_array->index == hval_array->pentry->count)
+        return false;
+      read_value(hval_array->pentry->type, hval_array->pos, target);
+      ++hval_array->index;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::harray portable_storage_reader::get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section)
+    {
+      const entry* e = find_entry(sec_name, hparent_section);
+      if(!e || e->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !e->count)
+        return nullptr;
+      h_child_section = &m_sections[e->section];
+      array_cursor c = {e, 1, nullptr};
+      m_cursors.push_back(c);
+      return &m_cursors.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(hsec_array->pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || hsec_array->index == hsec_array->pentry->count)
+        return false;
+      h_child_section = &m_sections[hsec_array->pentry->section + hsec_array->index++];
+      return true;
+    }
+  }
+}
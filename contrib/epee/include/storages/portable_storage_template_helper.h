@@ -30,6 +30,9 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_reader.h"
+#include "portable_storage_writer.h"
+#include "portable_storage_json_writer.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -61,10 +64,9 @@ namespace epee
     template<class t_struct>
     bool store_t_to_json(t_struct& str_in, std::string& json_buff, size_t indent = 0, bool insert_newlines = true)
     {
-      portable_storage ps;
+      portable_storage_json_writer ps(indent, insert_newlines);
       str_in.store(ps);
-      ps.dump_as_json(json_buff, indent, insert_newlines);
-      return true;
+      return ps.store_to_json(json_buff);
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -86,7 +88,7 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const std::string& binary_buff)
     {
-      portable_storage ps;
+      portable_storage_reader ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
         return false;
@@ -107,7 +109,7 @@ namespace epee
     template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, size_t indent = 0)
     {
-      portable_storage ps;
+      portable_storage_writer ps;
       str_in.store(ps);
       return ps.store_to_binary(binary_buff);
     }
@@ -0,0 +1,262 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+#pragma once 
+
+#include <deque>
+#include <sstream>
+#include "misc_language.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_bin.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    template<class t_value> struct storage_type_code;
+    template<> struct storage_type_code<int64_t>     { static const uint8_t value = SERIALIZE_TYPE_INT64; };
+    template<> struct storage_type_code<int32_t>     { static const uint8_t value = SERIALIZE_TYPE_INT32; };
+    template<> struct storage_type_code<int16_t>     { static const uint8_t value = SERIALIZE_TYPE_INT16; };
+    template<> struct storage_type_code<int8_t>      { static const uint8_t value = SERIALIZE_TYPE_INT8; };
+    template<> struct storage_type_code<uint64_t>    { static const uint8_t value = SERIALIZE_TYPE_UINT64; };
+    template<> struct storage_type_code<uint32_t>    { static const uint8_t value = SERIALIZE_TYPE_UINT32; };
+    template<> struct storage_type_code<uint16_t>    { static const uint8_t value = SERIALIZE_TYPE_UINT16; };
+    template<> struct storage_type_code<uint8_t>     { static const uint8_t value = SERIALIZE_TYPE_UINT8; };
+    template<> struct storage_type_code<double>      { static const uint8_t value = SERIALIZE_TYPE_DUOBLE; };
+    template<> struct storage_type_code<bool>        { static const uint8_t value = SERIALIZE_TYPE_BOOL; };
+    template<> struct storage_type_code<std::string> { static const uint8_t value = SERIALIZE_TYPE_STRING; };
+
+    /************************************************************************/
+    /* Writes the binary portable storage format straight into a buffer   */
+    /* while a KV_SERIALIZE map is being stored, without building the     */
+    /* section tree first. Entries come out in the order they are         */
+    /* serialized rather than sorted by name, which readers don't rely on.*/
+    /************************************************************************/
+    class portable_storage_writer
+    {
+    public:
+      //a section or array still being written; its element count is only
+      //known, and written, once something outside it is touched
+      struct frame
+      {
+        size_t count_pos;
+        size_t count;
+      };
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_writer();
+      hsection   open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       set_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      bool       set_value(const std::string& value_name, const storage_entry& target, hsection hparent_section);
+
+      //serial access for arrays of values --------------------------------------
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool          insert_next_value(harray hval_array, const t_value& target);
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section);
+      bool            insert_next_section(harray hSecArray, hsection& hinserted_childsection);
+
+      //-------------------------------------------------------------------------------
+      //finishes the buffer, nothing may be written afterwards
+      bool		store_to_binary(binarybuffer& target);
+
+      //stream interface for pack_varint and friends
+      void write(const char* data, size_t count) { m_buff.append(data, count); }
+
+    private:
+      void enter(frame* pframe);
+      void close_top_frame();
+      frame* push_frame(size_t count);
+      void add_entry_name(const std::string& name, uint8_t type, hsection hparent_section);
+      template<class t_value>
+      void write_value(const t_value& v) { write((const char*)&v, sizeof(t_value)); }
+      void write_value(const std::string& v) { put_string(*this, v); }
+
+      binarybuffer m_buff;
+      std::deque<frame> m_frames;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::portable_storage_writer()
+    {
+      uint32_t signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      uint32_t signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      uint8_t ver = PORTABLE_STORAGE_FORMAT_VER;
+      write_value(signature_a);
+      write_value(signature_b);
+      write_value(ver);
+      push_frame(0);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::frame* portable_storage_writer::push_frame(size_t count)
+    {
+      //reserve one byte for the count, enough for up to 63 elements
+      m_frames.push_back(frame{m_buff.size(), count});
+      m_buff.push_back(0);
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::close_top_frame()
+    {
+      const frame& f = m_frames.back();
+      if(f.count <= 63)
+      {
+        m_buff[f.count_pos] = static_cast<char>((f.count << 2) | PORTABLE_RAW_SIZE_MARK_BYTE);
+      }
+      else
+      {
+        //only large arrays and sections get here, so moving their contents
+        //up a few bytes once is cheap
+        std::stringstream ss;
+        pack_varint(ss, f.count);
+        m_buff.replace(f.count_pos, 1, ss.str());
+      }
+      m_frames.pop_back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::enter(frame* pframe)
+    {
+      if(!pframe)
+        pframe = &m_frames.front();
+      while(!m_frames.empty() && &m_frames.back() != pframe)
+        close_top_frame();
+      CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "portable_storage_writer: writing to a section or array which is already closed");
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::add_entry_name(const std::string& name, uint8_t type, hsection hparent_section)
+    {
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+      enter(hparent_section);
+      ++m_frames.back().count;
+      uint8_t len = static_cast<uint8_t>(name.size());
+      write_value(len);
+      write(name.data(), name.size());
+      write_value(type);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::hsection portable_storage_writer::open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      add_entry_name(section_name, SERIALIZE_TYPE_OBJECT, hparent_section);
+      return push_frame(0);
+      CATCH_ENTRY("portable_storage_writer::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(value_name, storage_type_code<t_value>::value, hparent_section);
+      write_value(v);
+      return true;
+      CATCH_ENTRY("portable_storage_writer::template<>set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_THROW_MES(value_name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << value_name.size() << ", val: " << value_name);
+      enter(hparent_section);
+      ++m_frames.back().count;
+      uint8_t len = static_cast<uint8_t>(value_name.size());
+      write_value(len);
+      write(value_name.data(), value_name.size());
+      //the entry writes its own type
+      return pack_entry_to_buff(*this, v);
+      CATCH_ENTRY("portable_storage_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_writer::harray portable_storage_writer::insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(value_name, storage_type_code<t_value>::value | SERIALIZE_FLAG_ARRAY, hparent_section);
+      harray hval_array = push_frame(1);
+      write_value(target);
+      return hval_array;
+      CATCH_ENTRY("portable_storage_writer::insert_first_value", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::insert_next_value(harray hval_array, const t_value& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+      enter(hval_array);
+      ++hval_array->count;
+      write_value(target);
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::harray portable_storage_writer::insert_first_section(const std::string& sec_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      add_entry_name(sec_name, SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY, hparent_section);
+      harray hsec_array = push_frame(1);
+      hinserted_childsection = push_frame(0);
+      return hsec_array;
+      CATCH_ENTRY("portable_storage_writer::insert_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      enter(hsec_array);
+      ++hsec_array->count;
+      hinserted_childsection = push_frame(0);
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_section", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::store_to_binary(binarybuffer& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(!m_frames.empty(), false, "portable_storage_writer: buffer already stored");
+      while(!m_frames.empty())
+        close_top_frame();
+      target.swap(m_buff);
+      m_buff.clear();
+      return true;
+      CATCH_ENTRY("portable_storage_writer::store_to_binary", false);
+    }
+  }
+}
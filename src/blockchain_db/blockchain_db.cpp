@@ -190,10 +190,14 @@ void BlockchainDB::reset_stats()
   time_add_block1 = 0;
   time_add_transaction = 0;
   time_commit1 = 0;
+  m_block_cache.reset_stats();
+  m_tx_cache.reset_stats();
+  m_output_cache.reset_stats();
 }
 
 void BlockchainDB::show_stats()
 {
+  const db_cache_stats cache_stats = get_cache_stats();
   LOG_PRINT_L1(ENDL
     << "*********************************"
     << ENDL
@@ -209,11 +213,57 @@ void BlockchainDB::show_stats()
     << ENDL
     << "time_commit1: " << time_commit1 << "ms"
     << ENDL
+    << "block cache hits/misses: " << cache_stats.blocks.hits << "/" << cache_stats.blocks.misses
+    << ENDL
+    << "tx cache hits/misses: " << cache_stats.txs.hits << "/" << cache_stats.txs.misses
+    << ENDL
+    << "output cache hits/misses: " << cache_stats.outputs.hits << "/" << cache_stats.outputs.misses
+    << ENDL
     << "*********************************"
     << ENDL
   );
 }
 
+void BlockchainDB::has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool>& spent) const
+{
+  spent.clear();
+  spent.reserve(imgs.size());
+  for (const crypto::key_image &img: imgs)
+    spent.push_back(has_key_image(img));
+}
+
+void BlockchainDB::set_cache_limits(size_t blocks, size_t txs, size_t outputs)
+{
+  m_block_cache.set_limit(blocks);
+  m_tx_cache.set_limit(txs);
+  m_output_cache.set_limit(outputs);
+}
+
+db_cache_stats BlockchainDB::get_cache_stats() const
+{
+  db_cache_stats stats;
+  stats.blocks = m_block_cache.get_stats();
+  stats.txs = m_tx_cache.get_stats();
+  stats.outputs = m_output_cache.get_stats();
+  return stats;
+}
+
+db_cache_generation BlockchainDB::get_cache_generation() const
+{
+  db_cache_generation gen;
+  gen.blocks = m_block_cache.generation();
+  gen.txs = m_tx_cache.generation();
+  gen.outputs = m_output_cache.generation();
+  return gen;
+}
+
+void BlockchainDB::invalidate_caches() const
+{
+  m_block_cache.clear();
+  m_tx_cache.clear();
+  m_output_cache.clear();
+}
+
 void BlockchainDB::fixup()
 {
   if (is_read_only()) {
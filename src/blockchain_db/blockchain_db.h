@@ -34,6 +34,7 @@
 #include <string>
 #include <exception>
 #include "crypto/hash.h"
+#include "common/lru_cache.h"
 #include "cryptonote_core/cryptonote_basic.h"
 #include "cryptonote_core/difficulty.h"
 #include "cryptonote_core/hardfork.h"
@@ -113,6 +114,41 @@ struct output_data_t
 };
 #pragma pack(pop)
 
+/**
+ * @brief hasher for (amount, amount output index) pairs
+ */
+struct amount_index_hash
+{
+  size_t operator()(const std::pair<uint64_t, uint64_t> &k) const
+  {
+    return std::hash<uint64_t>()(k.first * 0x9e3779b97f4a7c15ull ^ k.second);
+  }
+};
+
+/**
+ * @brief snapshot of the generations of the BlockchainDB object caches
+ *
+ * A reader records this before opening its read snapshot, and passes it
+ * back when caching what it read, so that a concurrent pop_block cannot
+ * leave objects read from the old chain in the caches.
+ */
+struct db_cache_generation
+{
+  uint64_t blocks;
+  uint64_t txs;
+  uint64_t outputs;
+};
+
+/**
+ * @brief hit/miss statistics for the BlockchainDB object caches
+ */
+struct db_cache_stats
+{
+  tools::lru_cache_stats blocks;
+  tools::lru_cache_stats txs;
+  tools::lru_cache_stats outputs;
+};
+
 #pragma pack(push, 1)
 struct tx_data_t
 {
@@ -498,6 +534,29 @@ protected:
 
   HardFork* m_hardfork;
 
+  /**
+   * @brief drop everything from the object caches
+   *
+   * This must be called whenever data which may have been cached can no
+   * longer be trusted to match the db, such as after a write txn which
+   * popped blocks is committed, or after a write txn is aborted.
+   */
+  void invalidate_caches() const;
+
+  /**
+   * @brief get the current generation of the object caches
+   *
+   * @return the generation of each of the object caches
+   */
+  db_cache_generation get_cache_generation() const;
+
+  // Parsed objects, for subclasses to cache lookups in.  A subclass which
+  // fills these must also evict from them in remove_block(),
+  // remove_transaction_data() and remove_output().
+  mutable tools::lru_cache<uint64_t, block> m_block_cache;  //!< parsed blocks, by height
+  mutable tools::lru_cache<crypto::hash, transaction> m_tx_cache;  //!< parsed transactions, by hash
+  mutable tools::lru_cache<std::pair<uint64_t, uint64_t>, output_data_t, amount_index_hash> m_output_cache;  //!< output data, by amount and amount output index
+
 public:
 
   /**
@@ -1199,6 +1258,19 @@ public:
    */
   virtual bool has_key_image(const crypto::key_image& img) const = 0;
 
+  /**
+   * @brief check which of a set of key images are stored as spent
+   *
+   * The subclass should set spent[i] to whether imgs[i] is stored, as
+   * has_key_image() would.  The default implementation simply calls
+   * has_key_image() for each key image; a subclass should override it
+   * if it can do the lookups more efficiently as a batch.
+   *
+   * @param imgs the key images to check for
+   * @param spent return-by-reference whether each key image is present
+   */
+  virtual void has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool>& spent) const;
+
   /**
    * @brief runs a function over all key images stored
    *
@@ -1335,6 +1407,26 @@ public:
    */
   void set_auto_remove_logs(bool auto_remove) { m_auto_remove_logs = auto_remove; }
 
+  /**
+   * @brief set the memory limits of the object caches
+   *
+   * A BlockchainDB implementation may keep recently used blocks, transactions
+   * and output data in memory to avoid fetching and parsing them again.
+   * Limits are approximate, in bytes.  A limit of 0 disables that cache.
+   *
+   * @param blocks the limit for the block cache
+   * @param txs the limit for the transaction cache
+   * @param outputs the limit for the output data cache
+   */
+  void set_cache_limits(size_t blocks, size_t txs, size_t outputs);
+
+  /**
+   * @brief get hit/miss statistics for the object caches
+   *
+   * @return the statistics for each of the object caches
+   */
+  db_cache_stats get_cache_stats() const;
+
   bool m_open;  //!< Whether or not the BlockchainDB is open/ready for use
   mutable epee::critical_section m_synchronization_lock;  //!< A lock, currently for when BlockchainLMDB needs to resize the backing db file
 
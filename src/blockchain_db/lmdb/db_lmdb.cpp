@@ -32,6 +32,7 @@
 #include <boost/current_function.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <algorithm>
 #include <random>
 
 #include "cryptonote_core/cryptonote_format_utils.h"
@@ -48,6 +49,10 @@ using epee::string_tools::pod_to_hex;
 // is no automatic conversion, so that a full resync is needed.
 #define VERSION 1
 
+// approximate memory charged per cached output: the data, its key, and
+// list/hash map node overhead
+#define OUTPUT_CACHE_ENTRY_SIZE (sizeof(cryptonote::output_data_t) + 2 * sizeof(uint64_t) + 6 * sizeof(void*))
+
 namespace
 {
 
@@ -254,6 +259,55 @@ typedef struct outtx {
     uint64_t local_index;
 } outtx;
 
+// how far ahead the cursor may step through an amount's outputs to reach
+// the next wanted one before a seek from the root is cheaper
+#define OUTPUT_WALK_MAX_STEP 16
+
+// Looks up the output_amounts entries for a set of amount output indices
+// in ascending order, so that one cursor sweeps forward over each amount's
+// outputs, stepping to nearby indices rather than seeking for each one.
+// Calls f(n, entry) with the position n of each index in offsets.
+template<typename F>
+static void walk_output_amounts(MDB_cursor *cur, const uint64_t amount, const std::vector<uint64_t> &offsets, F f)
+{
+  std::vector<size_t> order(offsets.size());
+  for (size_t n = 0; n < order.size(); ++n)
+    order[n] = n;
+  if (!std::is_sorted(offsets.begin(), offsets.end()))
+    std::stable_sort(order.begin(), order.end(), [&offsets](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+  MDB_val_set(k, amount);
+  MDB_val v;
+  const outkey *okp = NULL;
+  for (size_t n: order)
+  {
+    const uint64_t index = offsets[n];
+    int result = 0;
+    if (okp && index >= okp->amount_index && index - okp->amount_index <= OUTPUT_WALK_MAX_STEP)
+    {
+      while (okp && okp->amount_index < index)
+      {
+        result = mdb_cursor_get(cur, &k, &v, MDB_NEXT_DUP);
+        okp = result ? NULL : (const outkey *)v.mv_data;
+      }
+      if (!okp || okp->amount_index != index)
+        result = MDB_NOTFOUND;
+    }
+    else
+    {
+      v.mv_size = sizeof(index);
+      v.mv_data = (void *)&index;
+      result = mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH);
+      okp = result ? NULL : (const outkey *)v.mv_data;
+    }
+    if (result == MDB_NOTFOUND)
+      throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output from the db", result).c_str()));
+    f(n, *okp);
+  }
+}
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
 
@@ -668,6 +722,9 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+  m_block_cache.erase(m_height - 1);
+  m_caches_dirty = true;
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const transaction& tx, const crypto::hash& tx_hash)
@@ -759,6 +816,8 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   if (mdb_cursor_del(m_cur_tx_indices, 0))
       throw1(DB_ERROR("Failed to add removal of tx index to db transaction"));
 
+  m_tx_cache.erase(tx_hash);
+  m_caches_dirty = true;
   m_num_txs--;
 }
 
@@ -897,6 +956,8 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting amount for output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
 
+  m_output_cache.erase(std::make_pair(amount, out_index));
+  m_caches_dirty = true;
   m_num_outputs--;
 }
 
@@ -967,6 +1028,25 @@ void BlockchainLMDB::check_open() const
     throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
 }
 
+void BlockchainLMDB::invalidate_caches_if_dirty()
+{
+  // other threads may have cached what this write txn removed, from read
+  // txns started before it was committed
+  if (m_caches_dirty)
+  {
+    m_caches_dirty = false;
+    invalidate_caches();
+  }
+}
+
+db_cache_generation BlockchainLMDB::read_cache_generation(const mdb_txn_cursors *cursors) const
+{
+  // the writer sees its own changes, and evicts what it removes as it goes
+  if (cursors == &m_wcursors)
+    return get_cache_generation();
+  return m_tinfo->m_ti_cache_gen;
+}
+
 BlockchainLMDB::~BlockchainLMDB()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -990,6 +1070,7 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions)
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_caches_dirty = false;
   m_height = 0;
   m_cum_size = 0;
   m_cum_count = 0;
@@ -1207,6 +1288,7 @@ void BlockchainLMDB::close()
   }
   this->sync();
   m_tinfo.reset();
+  invalidate_caches();
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
@@ -1256,6 +1338,7 @@ void BlockchainLMDB::reset()
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
   txn.commit();
+  invalidate_caches();
   m_height = 0;
   m_num_outputs = 0;
   m_cum_size = 0;
@@ -1418,6 +1501,10 @@ block BlockchainLMDB::get_block_from_height(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  block b;
+  if (m_block_cache.get(height, b))
+    return b;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(blocks);
 
@@ -1434,10 +1521,11 @@ block BlockchainLMDB::get_block_from_height(const uint64_t& height) const
   blobdata bd;
   bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
 
-  block b;
   if (!parse_and_validate_block_from_blob(bd, b))
     throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
 
+  m_block_cache.insert(height, b, sizeof(block) + bd.size(), read_cache_generation(m_cursors).blocks);
+
   TXN_POSTFIX_RDONLY();
 
   return b;
@@ -1751,6 +1839,10 @@ transaction BlockchainLMDB::get_tx(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  transaction tx;
+  if (m_tx_cache.get(h, tx))
+    return tx;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
   RCURSOR(txs);
@@ -1772,10 +1864,11 @@ transaction BlockchainLMDB::get_tx(const crypto::hash& h) const
   blobdata bd;
   bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
 
-  transaction tx;
   if (!parse_and_validate_tx_from_blob(bd, tx))
     throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
 
+  m_tx_cache.insert(h, tx, sizeof(transaction) + bd.size(), read_cache_generation(m_cursors).txs);
+
   TXN_POSTFIX_RDONLY();
 
   return tx;
@@ -1913,6 +2006,10 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  output_data_t ret;
+  if (m_output_cache.get(std::make_pair(amount, index), ret))
+    return ret;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(output_amounts);
 
@@ -1924,7 +2021,8 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve an output pubkey from the db"));
   outkey *okp = (outkey *)v.mv_data;
-  output_data_t ret = okp->data;
+  ret = okp->data;
+  m_output_cache.insert(std::make_pair(amount, index), ret, OUTPUT_CACHE_ENTRY_SIZE, read_cache_generation(m_cursors).outputs);
   TXN_POSTFIX_RDONLY();
   return ret;
 }
@@ -2019,6 +2117,56 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   return ret;
 }
 
+void BlockchainLMDB::has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool>& spent) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  spent.assign(imgs.size(), false);
+  if (imgs.empty())
+    return;
+
+  // look the key images up in db order, so that a single cursor moves
+  // forward through the table, and keys which fall before the cursor's
+  // current position need no lookup at all
+  std::vector<size_t> order(imgs.size());
+  for (size_t n = 0; n < order.size(); ++n)
+    order[n] = n;
+  std::sort(order.begin(), order.end(), [&imgs](size_t a, size_t b) {
+    MDB_val va = {sizeof(crypto::key_image), (void *)&imgs[a]};
+    MDB_val vb = {sizeof(crypto::key_image), (void *)&imgs[b]};
+    return compare_hash32(&va, &vb) < 0;
+  });
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(spent_keys);
+
+  MDB_val cur = {0, NULL};
+  for (size_t idx: order)
+  {
+    MDB_val k = {sizeof(crypto::key_image), (void *)&imgs[idx]};
+    if (cur.mv_data)
+    {
+      int cmp = compare_hash32(&cur, &k);
+      if (cmp >= 0)
+      {
+        spent[idx] = cmp == 0;
+        continue;
+      }
+    }
+    auto result = mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH_RANGE);
+    if (result == MDB_NOTFOUND)
+      break; // all remaining key images sort after the last one stored
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to look up key image: ", result).c_str()));
+    // k now holds the first stored key image not before the one we want
+    cur = k;
+    spent[idx] = memcmp(cur.mv_data, &imgs[idx], sizeof(crypto::key_image)) == 0;
+  }
+
+  TXN_POSTFIX_RDONLY();
+}
+
 bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2230,6 +2378,7 @@ void BlockchainLMDB::batch_commit()
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
   LOG_PRINT_L3("batch transaction: committed");
+  invalidate_caches_if_dirty();
 
   m_write_txn = nullptr;
   delete m_write_batch_txn;
@@ -2252,6 +2401,7 @@ void BlockchainLMDB::batch_stop()
   m_write_txn->commit();
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
+  invalidate_caches_if_dirty();
   // for destruction of batch transaction
   m_write_txn = nullptr;
   delete m_write_batch_txn;
@@ -2277,6 +2427,9 @@ void BlockchainLMDB::batch_abort()
   m_write_batch_txn = nullptr;
   m_batch_active = false;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+  // anything the writer cached may have come from the aborted txn
+  m_caches_dirty = false;
+  invalidate_caches();
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
@@ -2305,11 +2458,13 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
     m_tinfo.reset(new mdb_threadinfo);
     memset(&m_tinfo->m_ti_rcursors, 0, sizeof(m_tinfo->m_ti_rcursors));
     memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+    m_tinfo->m_ti_cache_gen = get_cache_generation();
     if (auto mdb_res = mdb_txn_begin(m_env, NULL, MDB_RDONLY, &m_tinfo->m_ti_rtxn))
       throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a read transaction for the db: ", mdb_res).c_str()));
     ret = true;
   } else if (!m_tinfo->m_ti_rflags.m_rf_txn)
   {
+    m_tinfo->m_ti_cache_gen = get_cache_generation();
     if (auto mdb_res = mdb_txn_renew(m_tinfo->m_ti_rtxn))
       throw0(DB_ERROR_TXN_START(lmdb_error("Failed to renew a read transaction for the db: ", mdb_res).c_str()));
     ret = true;
@@ -2343,11 +2498,13 @@ void BlockchainLMDB::block_txn_start(bool readonly)
       m_tinfo.reset(new mdb_threadinfo);
       memset(&m_tinfo->m_ti_rcursors, 0, sizeof(m_tinfo->m_ti_rcursors));
       memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+      m_tinfo->m_ti_cache_gen = get_cache_generation();
       if (auto mdb_res = mdb_txn_begin(m_env, NULL, MDB_RDONLY, &m_tinfo->m_ti_rtxn))
         throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a read transaction for the db: ", mdb_res).c_str()));
       didit = true;
     } else if (!m_tinfo->m_ti_rflags.m_rf_txn)
     {
+      m_tinfo->m_ti_cache_gen = get_cache_generation();
       if (auto mdb_res = mdb_txn_renew(m_tinfo->m_ti_rtxn))
         throw0(DB_ERROR_TXN_START(lmdb_error("Failed to renew a read transaction for the db: ", mdb_res).c_str()));
       didit = true;
@@ -2395,6 +2552,7 @@ void BlockchainLMDB::block_txn_stop()
       m_write_txn->commit();
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
+      invalidate_caches_if_dirty();
 
       delete m_write_txn;
       m_write_txn = nullptr;
@@ -2418,6 +2576,9 @@ void BlockchainLMDB::block_txn_abort()
       delete m_write_txn;
       m_write_txn = nullptr;
       memset(&m_wcursors, 0, sizeof(m_wcursors));
+      // anything the writer cached may have come from the aborted txn
+      m_caches_dirty = false;
+      invalidate_caches();
     }
   }
   else if (m_tinfo->m_ti_rtxn)
@@ -2536,22 +2697,26 @@ void BlockchainLMDB::get_output_key(const uint64_t &amount, const std::vector<ui
 
   RCURSOR(output_amounts);
 
-  MDB_val_set(k, amount);
-  for (const uint64_t &index : offsets)
+  // serve what we can from the cache, and fetch the rest in one sweep
+  std::vector<output_data_t> found(offsets.size());
+  std::vector<uint64_t> missing;
+  std::vector<size_t> missing_pos;
+  for (size_t n = 0; n < offsets.size(); ++n)
   {
-    MDB_val_set(v, index);
-
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
-      throw1(OUTPUT_DNE("Attempting to get output pubkey by global index, but key does not exist"));
-    else if (get_result)
-      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
-
-    outkey *okp = (outkey *)v.mv_data;
-    output_data_t data = okp->data;
-    outputs.push_back(data);
+    if (!m_output_cache.get(std::make_pair(amount, offsets[n]), found[n]))
+    {
+      missing.push_back(offsets[n]);
+      missing_pos.push_back(n);
+    }
   }
 
+  const uint64_t cache_gen = read_cache_generation(m_cursors).outputs;
+  walk_output_amounts(m_cur_output_amounts, amount, missing, [&](size_t n, const outkey &ok) {
+    found[missing_pos[n]] = ok.data;
+    m_output_cache.insert(std::make_pair(amount, ok.amount_index), ok.data, OUTPUT_CACHE_ENTRY_SIZE, cache_gen);
+  });
+  outputs.swap(found);
+
   TXN_POSTFIX_RDONLY();
 
   TIME_MEASURE_FINISH(db3);
@@ -2564,25 +2729,14 @@ void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::
   check_open();
   indices.clear();
 
-  std::vector <uint64_t> tx_indices;
+  std::vector <uint64_t> tx_indices(offsets.size());
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
 
-  MDB_val_set(k, amount);
-  for (const uint64_t &index : offsets)
-  {
-    MDB_val_set(v, index);
-
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
-      throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
-    else if (get_result)
-      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output from the db", get_result).c_str()));
-
-    outkey *okp = (outkey *)v.mv_data;
-    tx_indices.push_back(okp->output_id);
-  }
+  walk_output_amounts(m_cur_output_amounts, amount, offsets, [&tx_indices](size_t n, const outkey &ok) {
+    tx_indices[n] = ok.output_id;
+  });
 
   TIME_MEASURE_START(db3);
   if(tx_indices.size() > 0)
@@ -2605,6 +2759,32 @@ std::map<uint64_t, uint64_t> BlockchainLMDB::get_output_histogram(const std::vec
   MDB_val k;
   MDB_val v;
 
+  // The number of outputs for an amount is kept by LMDB in the amount's
+  // duplicate subtree, so counting is O(1).  For the unlocked count, step
+  // back from the newest output while it's too young to be spent: the
+  // output data holds its height, so no tx lookups are needed, and only
+  // the outputs from the last few blocks are visited.
+  const uint64_t blockchain_height = height();
+  auto count_outputs = [&](uint64_t amount) {
+    mdb_size_t num_elems = 0;
+    mdb_cursor_count(m_cur_output_amounts, &num_elems);
+    if (unlocked)
+    {
+      int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_LAST_DUP);
+      while (ret == MDB_SUCCESS && num_elems > 0)
+      {
+        const outkey *okp = (const outkey *)v.mv_data;
+        if (okp->data.height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
+          break;
+        --num_elems;
+        ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_PREV_DUP);
+      }
+      if (ret && ret != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", ret).c_str()));
+    }
+    histogram[amount] = num_elems;
+  };
+
   if (amounts.empty())
   {
     MDB_cursor_op op = MDB_FIRST;
@@ -2616,10 +2796,7 @@ std::map<uint64_t, uint64_t> BlockchainLMDB::get_output_histogram(const std::vec
         break;
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", ret).c_str()));
-      mdb_size_t num_elems = 0;
-      mdb_cursor_count(m_cur_output_amounts, &num_elems);
-      uint64_t amount = *(const uint64_t*)k.mv_data;
-      histogram[amount] = num_elems;
+      count_outputs(*(const uint64_t*)k.mv_data);
     }
   }
   else
@@ -2634,9 +2811,7 @@ std::map<uint64_t, uint64_t> BlockchainLMDB::get_output_histogram(const std::vec
       }
       else if (ret == MDB_SUCCESS)
       {
-        mdb_size_t num_elems = 0;
-        mdb_cursor_count(m_cur_output_amounts, &num_elems);
-        histogram[amount] = num_elems;
+        count_outputs(amount);
       }
       else
       {
@@ -2645,23 +2820,6 @@ std::map<uint64_t, uint64_t> BlockchainLMDB::get_output_histogram(const std::vec
     }
   }
 
-  if (unlocked) {
-    const uint64_t blockchain_height = height();
-    for (auto i: histogram) {
-      uint64_t amount = i.first;
-      uint64_t num_elems = i.second;
-      while (num_elems > 0) {
-        const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-        const uint64_t height = get_tx_block_height(toi.first);
-        if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
-          break;
-        --num_elems;
-      }
-      // modifying second does not invalidate the iterator
-      i.second = num_elems;
-    }
-  }
-
   TXN_POSTFIX_RDONLY();
 
   return histogram;
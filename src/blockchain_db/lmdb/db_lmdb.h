@@ -88,6 +88,7 @@ typedef struct mdb_threadinfo
   MDB_txn *m_ti_rtxn;	// per-thread read txn
   mdb_txn_cursors m_ti_rcursors;	// per-thread read cursors
   mdb_rflags m_ti_rflags;	// per-thread read state
+  db_cache_generation m_ti_cache_gen;	// object cache generation when the read txn was started
 
   ~mdb_threadinfo();
 } mdb_threadinfo;
@@ -231,6 +232,8 @@ public:
 
   virtual bool has_key_image(const crypto::key_image& img) const;
 
+  virtual void has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool>& spent) const;
+
   virtual bool for_all_key_images(std::function<bool(const crypto::key_image&)>) const;
   virtual bool for_all_blocks(std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)>) const;
   virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>) const;
@@ -333,6 +336,13 @@ private:
 
   void check_open() const;
 
+  // generation of the object caches the data seen through these cursors
+  // belongs to; see BlockchainDB::get_cache_generation()
+  db_cache_generation read_cache_generation(const mdb_txn_cursors *cursors) const;
+
+  // drop the object caches if the write txn just committed removed data
+  void invalidate_caches_if_dirty();
+
   virtual bool is_read_only() const;
 
   // fix up anything that may be wrong due to past bugs
@@ -376,6 +386,7 @@ private:
 
   bool m_batch_transactions; // support for batch transactions
   bool m_batch_active; // whether batch transaction is in progress
+  bool m_caches_dirty; // whether the write txn removed data which may be cached
 
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
@@ -71,6 +71,16 @@ namespace command_line
   , "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[nblocks_per_sync]." 
   , "fastest:async:1000"
   };
+  const command_line::arg_descriptor<std::string> arg_db_cache_size = {
+    "db-cache-size"
+  , "Memory to use for caching blocks, transactions and outputs read from the database, in MB, using format [blocks]:[txs]:[outputs]. 0 disables a cache."
+  , "16:32:16"
+  };
+  const command_line::arg_descriptor<uint64_t> arg_ring_member_cache_size = {
+    "ring-member-cache-size"
+  , "Memory to use for caching precomputed ring members when verifying signatures, in MB. 0 disables the cache."
+  , 32
+  };
   const command_line::arg_descriptor<uint64_t> arg_fast_block_sync = {
     "fast-block-sync"
   , "Sync up most of the way by using embedded, known block hashes."
@@ -211,6 +211,8 @@ namespace command_line
   extern const arg_descriptor<bool> arg_dns_checkpoints;
   extern const arg_descriptor<std::string> arg_db_type;
   extern const arg_descriptor<std::string> arg_db_sync_mode;
+  extern const arg_descriptor<std::string> arg_db_cache_size;
+  extern const arg_descriptor<uint64_t> arg_ring_member_cache_size;
   extern const arg_descriptor<uint64_t> arg_fast_block_sync;
   extern const arg_descriptor<uint64_t> arg_prep_blocks_threads;
   extern const arg_descriptor<uint64_t> arg_db_auto_remove_logs;
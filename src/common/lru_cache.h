@@ -0,0 +1,242 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace tools
+{
+  struct lru_cache_stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t limit;
+  };
+
+  /**
+   * @brief a thread safe, size bounded LRU cache
+   *
+   * Entries are spread over a number of shards by key hash, each with its
+   * own lock, LRU list and share of the byte budget, so that concurrent
+   * readers rarely contend.  Each entry is charged a caller supplied cost,
+   * and the least recently used entries of a shard are evicted once that
+   * shard goes over budget.  A limit of 0 disables the cache.
+   *
+   * The cache carries a generation number, which clear() advances.  A caller
+   * which reads from a snapshot (such as a db read txn) may record the
+   * generation before taking the snapshot and pass it to insert(), so that
+   * data read from a snapshot older than the last clear() is dropped.
+   */
+  template<typename K, typename V, typename Hash = std::hash<K>>
+  class lru_cache
+  {
+  public:
+    typedef lru_cache_stats stats;
+
+    lru_cache(size_t max_bytes = 0, size_t shards = 16)
+      : m_limit(max_bytes)
+      , m_generation(0)
+      , m_hits(0)
+      , m_misses(0)
+      , m_evictions(0)
+    {
+      if (shards == 0)
+        shards = 1;
+      for (size_t n = 0; n < shards; ++n)
+        m_shards.emplace_back(new shard());
+    }
+
+    bool enabled() const { return m_limit != 0; }
+
+    uint64_t generation() const { return m_generation; }
+
+    void set_limit(size_t max_bytes)
+    {
+      m_limit = max_bytes;
+      for (auto &s: m_shards)
+      {
+        boost::lock_guard<boost::mutex> lock(s->mutex);
+        trim(*s);
+      }
+    }
+
+    bool get(const K &key, V &value)
+    {
+      if (!enabled())
+        return false;
+      shard &s = shard_for(key);
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      auto i = s.index.find(key);
+      if (i == s.index.end())
+      {
+        ++m_misses;
+        return false;
+      }
+      s.entries.splice(s.entries.begin(), s.entries, i->second);
+      value = i->second->value;
+      ++m_hits;
+      return true;
+    }
+
+    void insert(const K &key, const V &value, size_t cost)
+    {
+      insert(key, value, cost, m_generation);
+    }
+
+    void insert(const K &key, const V &value, size_t cost, uint64_t generation)
+    {
+      if (!enabled())
+        return;
+      shard &s = shard_for(key);
+      const size_t shard_limit = m_limit / m_shards.size();
+      if (cost > shard_limit)
+        return;
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      if (generation != m_generation)
+        return;
+      auto i = s.index.find(key);
+      if (i != s.index.end())
+      {
+        s.bytes -= i->second->cost;
+        s.entries.erase(i->second);
+        s.index.erase(i);
+      }
+      s.entries.push_front(entry{key, value, cost});
+      s.index[key] = s.entries.begin();
+      s.bytes += cost;
+      trim(s);
+    }
+
+    void erase(const K &key)
+    {
+      shard &s = shard_for(key);
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      auto i = s.index.find(key);
+      if (i == s.index.end())
+        return;
+      s.bytes -= i->second->cost;
+      s.entries.erase(i->second);
+      s.index.erase(i);
+    }
+
+    void clear()
+    {
+      ++m_generation;
+      for (auto &s: m_shards)
+      {
+        boost::lock_guard<boost::mutex> lock(s->mutex);
+        s->index.clear();
+        s->entries.clear();
+        s->bytes = 0;
+      }
+    }
+
+    stats get_stats() const
+    {
+      stats st;
+      st.hits = m_hits;
+      st.misses = m_misses;
+      st.evictions = m_evictions;
+      st.entries = 0;
+      st.bytes = 0;
+      st.limit = m_limit;
+      for (const auto &s: m_shards)
+      {
+        boost::lock_guard<boost::mutex> lock(s->mutex);
+        st.entries += s->index.size();
+        st.bytes += s->bytes;
+      }
+      return st;
+    }
+
+    void reset_stats()
+    {
+      m_hits = 0;
+      m_misses = 0;
+      m_evictions = 0;
+    }
+
+  private:
+    struct entry
+    {
+      K key;
+      V value;
+      size_t cost;
+    };
+
+    struct shard
+    {
+      shard(): bytes(0) {}
+
+      boost::mutex mutex;
+      std::list<entry> entries;
+      std::unordered_map<K, typename std::list<entry>::iterator, Hash> index;
+      size_t bytes;
+    };
+
+    shard &shard_for(const K &key)
+    {
+      return *m_shards[m_hash(key) % m_shards.size()];
+    }
+
+    // shard lock must be held
+    void trim(shard &s)
+    {
+      const size_t shard_limit = m_limit / m_shards.size();
+      while (s.bytes > shard_limit && !s.entries.empty())
+      {
+        const entry &e = s.entries.back();
+        s.bytes -= e.cost;
+        s.index.erase(e.key);
+        s.entries.pop_back();
+        ++m_evictions;
+      }
+    }
+
+    std::vector<std::unique_ptr<shard>> m_shards;
+    Hash m_hash;
+    std::atomic<size_t> m_limit;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+  };
+}
@@ -1196,16 +1196,21 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_base_precomp_vartime(r, a, Ai, b);
+}
+
+void ge_double_scalarmult_base_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b) {
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
 
@@ -2003,16 +2008,21 @@ void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
 }
 
 void ge_double_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b, const ge_dsmp Bi) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_precomp_vartime2(r, a, Ai, b, Bi);
+}
+
+void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
 
@@ -2052,6 +2062,39 @@ void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
   ge_p2_dbl(r, &u);
 }
 
+/* Same as ge_tobytes on each of the n points, with a single field inversion.
+ * scratch must hold n field elements. */
+void ge_tobytes_batch(unsigned char *const *s, const ge_p2 *h, fe *scratch, int n) {
+  fe recip;
+  fe x;
+  fe y;
+  int i;
+
+  if (n <= 0) {
+    return;
+  }
+  /* scratch[i] = Z_0 * ... * Z_i */
+  fe_copy(scratch[0], h[0].Z);
+  for (i = 1; i < n; i++) {
+    fe_mul(scratch[i], scratch[i - 1], h[i].Z);
+  }
+  fe_invert(recip, scratch[n - 1]);
+  for (i = n - 1; i >= 0; i--) {
+    fe z;
+    if (i > 0) {
+      /* 1 / Z_i, then drop Z_i from the running inverse */
+      fe_mul(z, recip, scratch[i - 1]);
+      fe_mul(recip, recip, h[i].Z);
+    } else {
+      fe_copy(z, recip);
+    }
+    fe_mul(x, h[i].X, z);
+    fe_mul(y, h[i].Y, z);
+    fe_tobytes(s[i], y);
+    s[i][31] ^= fe_isnegative(x) << 7;
+  }
+}
+
 void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
   fe u, v, w, x, y, z;
   unsigned char sign;
@@ -183,6 +183,34 @@ namespace crypto {
     return true;
   }
 
+  static_assert(sizeof(public_key_precomp) == sizeof(ge_cached), "Invalid public_key_precomp size");
+
+  bool crypto_ops::precompute_public_key(const public_key &pub, public_key_precomp &precomp) {
+    ge_p3 point;
+    ge_cached cached;
+    if (ge_frombytes_vartime(&point, &pub) != 0) {
+      return false;
+    }
+    ge_p3_to_cached(&cached, &point);
+    memcpy(&precomp, &cached, sizeof(cached));
+    return true;
+  }
+
+  void crypto_ops::derive_public_key(const key_derivation &derivation, size_t output_index,
+    const public_key_precomp &base, public_key &derived_key) {
+    ec_scalar scalar;
+    ge_cached point1;
+    ge_p3 point2;
+    ge_p1p1 point3;
+    ge_p2 point4;
+    memcpy(&point1, &base, sizeof(point1));
+    derivation_to_scalar(derivation, output_index, scalar);
+    ge_scalarmult_base(&point2, &scalar);
+    ge_add(&point3, &point2, &point1);
+    ge_p1p1_to_p2(&point4, &point3);
+    ge_tobytes(&derived_key, &point4);
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -338,19 +366,43 @@ POP_WARNINGS
     sc_mulsub(&sig[sec_index].r, &sig[sec_index].c, &sec, &k);
   }
 
-  bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
-    const public_key *const *pubs, size_t pubs_count,
-    const signature *sig) {
+  struct ring_member_tables {
+    ge_dsmp key;
+    ge_dsmp key_hash;
+  };
+
+  static_assert(sizeof(ring_member_precomp) == sizeof(ring_member_tables), "Invalid ring_member_precomp size");
+
+  static bool precompute_ring_member_tables(const public_key &pub, ring_member_tables &tables) {
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, &pub) != 0) {
+      return false;
+    }
+    ge_dsm_precomp(tables.key, &point);
+    hash_to_ec(pub, point);
+    ge_dsm_precomp(tables.key_hash, &point);
+    return true;
+  }
+
+  // get_member(i, scratch) returns the tables of ring member i, possibly built in scratch
+  template<typename get_member_t>
+  static bool check_ring_signature_tables(const hash &prefix_hash, const key_image &image,
+    size_t pubs_count, const signature *sig, get_member_t get_member) {
     size_t i;
     ge_p3 image_unp;
     ge_dsmp image_pre;
     ec_scalar sum, h;
+    ring_member_tables scratch;
     rs_comm *const buf = reinterpret_cast<rs_comm *>(alloca(rs_comm_size(pubs_count)));
-#if !defined(NDEBUG)
+    // the a and b points of every ring member, compressed together at the end
+    ge_p2 *const points = reinterpret_cast<ge_p2 *>(alloca(2 * pubs_count * sizeof(ge_p2)));
+    unsigned char **const points_bytes = reinterpret_cast<unsigned char **>(alloca(2 * pubs_count * sizeof(unsigned char *)));
+    fe *const fe_scratch = reinterpret_cast<fe *>(alloca(2 * pubs_count * sizeof(fe)));
     for (i = 0; i < pubs_count; i++) {
-      assert(check_key(*pubs[i]));
+      if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
+        return false;
+      }
     }
-#endif
     if (ge_frombytes_vartime(&image_unp, &image) != 0) {
       return false;
     }
@@ -358,23 +410,53 @@ POP_WARNINGS
     sc_0(&sum);
     buf->h = prefix_hash;
     for (i = 0; i < pubs_count; i++) {
-      ge_p2 tmp2;
-      ge_p3 tmp3;
-      if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
-        return false;
-      }
-      if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
-        abort();
-      }
-      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
-      ge_tobytes(&buf->ab[i].a, &tmp2);
-      hash_to_ec(*pubs[i], tmp3);
-      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
-      ge_tobytes(&buf->ab[i].b, &tmp2);
+      const ring_member_tables &member = get_member(i, scratch);
+      ge_double_scalarmult_base_precomp_vartime(&points[2 * i], &sig[i].c, member.key, &sig[i].r);
+      points_bytes[2 * i] = reinterpret_cast<unsigned char *>(&buf->ab[i].a);
+      ge_double_scalarmult_precomp_vartime2(&points[2 * i + 1], &sig[i].r, member.key_hash, &sig[i].c, image_pre);
+      points_bytes[2 * i + 1] = reinterpret_cast<unsigned char *>(&buf->ab[i].b);
       sc_add(&sum, &sum, &sig[i].c);
     }
+    ge_tobytes_batch(points_bytes, points, fe_scratch, static_cast<int>(2 * pubs_count));
     hash_to_scalar(buf, rs_comm_size(pubs_count), h);
     sc_sub(&h, &h, &sum);
     return sc_isnonzero(&h) == 0;
   }
+
+  bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
+    const public_key *const *pubs, size_t pubs_count,
+    const signature *sig) {
+#if !defined(NDEBUG)
+    for (size_t i = 0; i < pubs_count; i++) {
+      assert(check_key(*pubs[i]));
+    }
+#endif
+    return check_ring_signature_tables(prefix_hash, image, pubs_count, sig,
+      [pubs](size_t i, ring_member_tables &scratch) -> const ring_member_tables & {
+        if (!precompute_ring_member_tables(*pubs[i], scratch)) {
+          abort();
+        }
+        return scratch;
+      });
+  }
+
+  bool crypto_ops::precompute_ring_member(const public_key &pub, ring_member_precomp &precomp) {
+    ring_member_tables tables;
+    if (!precompute_ring_member_tables(pub, tables)) {
+      return false;
+    }
+    memcpy(&precomp, &tables, sizeof(tables));
+    return true;
+  }
+
+  bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
+    const ring_member_precomp *const *members, size_t members_count,
+    const signature *sig) {
+    return check_ring_signature_tables(prefix_hash, image, members_count, sig,
+      [members](size_t i, ring_member_tables &scratch) -> const ring_member_tables & {
+        memcpy(&scratch, members[i], sizeof(scratch));
+        return scratch;
+      });
+  }
+
 }
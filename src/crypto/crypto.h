@@ -31,6 +31,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <vector>
@@ -78,6 +79,22 @@ namespace crypto {
   };
 #pragma pack(pop)
 
+  /* Decompressed form of a public key used as the base of many derivations,
+   * such as an account's spend public key while scanning.
+   */
+  POD_CLASS public_key_precomp {
+    int32_t data[40];
+    friend class crypto_ops;
+  };
+
+  /* Precomputed multiples of a public key and of its hash to the curve, as
+   * used when the key is a ring member.
+   */
+  POD_CLASS ring_member_precomp {
+    int32_t data[640];
+    friend class crypto_ops;
+  };
+
   static_assert(sizeof(ec_point) == 32 && sizeof(ec_scalar) == 32 &&
     sizeof(public_key) == 32 && sizeof(secret_key) == 32 &&
     sizeof(key_derivation) == 32 && sizeof(key_image) == 32 &&
@@ -99,6 +116,10 @@ namespace crypto {
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool precompute_public_key(const public_key &, public_key_precomp &);
+    friend bool precompute_public_key(const public_key &, public_key_precomp &);
+    static void derive_public_key(const key_derivation &, std::size_t, const public_key_precomp &, public_key &);
+    friend void derive_public_key(const key_derivation &, std::size_t, const public_key_precomp &, public_key &);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
@@ -115,6 +136,12 @@ namespace crypto {
       const public_key *const *, std::size_t, const signature *);
     friend bool check_ring_signature(const hash &, const key_image &,
       const public_key *const *, std::size_t, const signature *);
+    static bool precompute_ring_member(const public_key &, ring_member_precomp &);
+    friend bool precompute_ring_member(const public_key &, ring_member_precomp &);
+    static bool check_ring_signature(const hash &, const key_image &,
+      const ring_member_precomp *const *, std::size_t, const signature *);
+    friend bool check_ring_signature(const hash &, const key_image &,
+      const ring_member_precomp *const *, std::size_t, const signature *);
   };
 
   /* Generate N random bytes
@@ -165,6 +192,15 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Same as derive_public_key, with the base decompressed once by precompute_public_key.
+   */
+  inline bool precompute_public_key(const public_key &pub, public_key_precomp &precomp) {
+    return crypto_ops::precompute_public_key(pub, precomp);
+  }
+  inline void derive_public_key(const key_derivation &derivation, std::size_t output_index,
+    const public_key_precomp &base, public_key &derived_key) {
+    crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
+  }
   inline void derive_secret_key(const key_derivation &derivation, std::size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     crypto_ops::derive_secret_key(derivation, output_index, base, derived_key);
@@ -200,6 +236,18 @@ namespace crypto {
     return crypto_ops::check_ring_signature(prefix_hash, image, pubs, pubs_count, sig);
   }
 
+  /* Same as check_ring_signature, with ring members precomputed by
+   * precompute_ring_member, so that keys used in many rings can be cached.
+   */
+  inline bool precompute_ring_member(const public_key &pub, ring_member_precomp &precomp) {
+    return crypto_ops::precompute_ring_member(pub, precomp);
+  }
+  inline bool check_ring_signature(const hash &prefix_hash, const key_image &image,
+    const ring_member_precomp *const *members, std::size_t members_count,
+    const signature *sig) {
+    return crypto_ops::check_ring_signature(prefix_hash, image, members, members_count, sig);
+  }
+
   /* Variants with vector<const public_key *> parameters.
    */
   inline void generate_ring_signature(const hash &prefix_hash, const key_image &image,
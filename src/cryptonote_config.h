@@ -85,6 +85,10 @@
 
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          10000  //by default, blocks ids count in synchronizing
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              200    //by default, blocks count in blocks downloading
+#define BLOCKS_SYNCHRONIZING_MAX_REQUESTS               4      //blocks requests kept in flight to one peer at most
+#define BLOCKS_SYNCHRONIZING_MAX_COUNT                  2000   //blocks in one request at most
+#define BLOCKS_SYNCHRONIZING_MAX_BYTES                  (10*1024*1024) //size one blocks request aims for at most
+#define BLOCKS_SYNCHRONIZING_TARGET_TIME                1      //seconds one blocks response should take at the peer's speed
 #define CRYPTONOTE_PROTOCOL_HOP_RELAX_COUNT             3      //value of hop, after which we use only announce of new block
 
 #define CRYPTONOTE_MEMPOOL_TX_LIVETIME                    86400 //seconds, one day
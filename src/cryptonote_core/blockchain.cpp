@@ -101,10 +101,14 @@ static const struct {
 };
 static const uint64_t testnet_hard_fork_version_1_till = 624633;
 
+// precomputed ring members take 2.5 kB each, this holds about 13000
+static const size_t DEFAULT_RING_MEMBER_CACHE_SIZE = 32 << 20;
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
-  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_sz_limit(0), m_is_in_checkpoint_zone(false),
-  m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0)
+  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_current_block_cumul_sz_limit(0), m_is_in_checkpoint_zone(false),
+  m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0),
+  m_ring_member_cache(DEFAULT_RING_MEMBER_CACHE_SIZE)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -123,6 +127,14 @@ bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
   return  m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
+bool Blockchain::are_key_images_spent(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_db->has_key_images(key_im, spent);
+  return true;
+}
+//------------------------------------------------------------------
 // This function makes sure that each "input" in an input (mixins) exists
 // and collects the public key for each from the transaction it was included in
 // via the visitor passed to it.
@@ -447,14 +459,16 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
-
   block popped_block;
   std::vector<transaction> popped_txs;
 
   try
   {
     m_db->pop_block(popped_block, popped_txs);
+    if (m_chain_stats.height() == m_db->height() + 1)
+      m_chain_stats.pop(*m_db);
+    else
+      m_chain_stats.clear();
   }
   // anything that could cause this to throw is likely catastrophic,
   // so we re-throw
@@ -510,6 +524,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_alternative_chains.clear();
   m_db->reset();
+  m_chain_stats.clear();
   m_hardfork->init();
 
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -673,49 +688,21 @@ difficulty_type Blockchain::get_difficulty_for_next_block()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> difficulties;
-  auto height = m_db->height();
-  // ND: Speedup
-  // 1. Keep a list of the last 735 (or less) blocks that is used to compute difficulty,
-  //    then when the next block difficulty is queried, push the latest height data and
-  //    pop the oldest one from the list. This only requires 1x read per height instead
-  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT).
-  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1))
-  {
-    uint64_t index = height - 1;
-    m_timestamps.push_back(m_db->get_block_timestamp(index));
-    m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
-
-    while (m_timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_timestamps.erase(m_timestamps.begin());
-    while (m_difficulties.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_difficulties.erase(m_difficulties.begin());
-
-    m_timestamps_and_difficulties_height = height;
-    timestamps = m_timestamps;
-    difficulties = m_difficulties;
-  }
-  else
-  {
-    size_t offset = height - std::min < size_t > (height, static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    if (offset == 0)
-      ++offset;
+  size_t target = get_current_hard_fork_version() < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
 
-    timestamps.clear();
-    difficulties.clear();
-    for (; offset < height; offset++)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(offset));
-      difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
-    }
+  // the window is kept up to date as blocks are added and popped, and the
+  // result is reused until the top block changes
+  sync_chain_stats();
+  difficulty_type diff;
+  if (m_chain_stats.get_next_difficulty(target, diff))
+    return diff;
 
-    m_timestamps_and_difficulties_height = height;
-    m_timestamps = timestamps;
-    m_difficulties = difficulties;
-  }
-  size_t target = get_current_hard_fork_version() < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
-  return next_difficulty(timestamps, difficulties, target);
+  std::vector<uint64_t> timestamps;
+  std::vector<difficulty_type> difficulties;
+  m_chain_stats.get_difficulty_window(timestamps, difficulties);
+  diff = next_difficulty(timestamps, difficulties, target);
+  m_chain_stats.set_next_difficulty(target, diff);
+  return diff;
 }
 //------------------------------------------------------------------
 // This function removes blocks from the blockchain until it gets to the
@@ -732,8 +719,6 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
     return true;
   }
 
-  m_timestamps_and_difficulties_height = 0;
-
   // remove blocks from blockchain until we get back to where we should be.
   while (m_db->height() != rollback_height)
   {
@@ -765,8 +750,6 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
-
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
 
@@ -855,67 +838,135 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
 //------------------------------------------------------------------
 // This function calculates the difficulty target for the block being added to
 // an alternate chain.
-difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei) const
+difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const alt_chain_state* parent, const alt_chain_base& base, block_extended_info& bei) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::vector<uint64_t> timestamps;
   std::vector<difficulty_type> cumulative_difficulties;
 
-  // if the alt chain isn't long enough to calculate the difficulty target
-  // based on its blocks alone, need to get more blocks from the main chain
-  if(alt_chain.size()< DIFFICULTY_BLOCKS_COUNT)
+  // the most recent blocks of the alt chain, completed with the main chain
+  // blocks below it if the alt chain isn't long enough
+  get_alternative_chain_window(parent, base, DIFFICULTY_BLOCKS_COUNT, timestamps, &cumulative_difficulties);
+
+  // FIXME: This will fail if fork activation heights are subject to voting
+  size_t target = get_ideal_hard_fork_version(bei.height) < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
+
+  // calculate the difficulty target for the block and return it
+  return next_difficulty(timestamps, cumulative_difficulties, target);
+}
+//------------------------------------------------------------------
+Blockchain::alt_chain_state::~alt_chain_state()
+{
+  // unlink the parents one by one, so freeing a long chain does not recurse
+  std::shared_ptr<alt_chain_state> p = std::move(parent);
+  while (p && p.use_count() == 1)
   {
-    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    std::shared_ptr<alt_chain_state> next = std::move(p->parent);
+    p = std::move(next);
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::get_alternative_chain_window(const alt_chain_state* tip, const alt_chain_base& base, size_t count, std::vector<uint64_t>& timestamps, std::vector<difficulty_type>* cumulative_difficulties) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  std::vector<const alt_chain_state*> blocks;
+  for (; tip && blocks.size() < count; tip = tip->parent.get())
+    blocks.push_back(tip);
 
-    // Figure out start and stop offsets for main chain blocks
-    size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
-    size_t main_chain_count = DIFFICULTY_BLOCKS_COUNT - std::min(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT), alt_chain.size());
-    main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
-    size_t main_chain_start_offset = main_chain_stop_offset - main_chain_count;
+  const size_t from_base = std::min(count - blocks.size(), base.timestamps.size());
+  timestamps.assign(base.timestamps.end() - from_base, base.timestamps.end());
+  if (cumulative_difficulties)
+    cumulative_difficulties->assign(base.cumulative_difficulties.end() - from_base, base.cumulative_difficulties.end());
 
-    if(!main_chain_start_offset)
-      ++main_chain_start_offset; //skip genesis block
+  for (auto i = blocks.rbegin(); i != blocks.rend(); ++i)
+  {
+    timestamps.push_back((*i)->timestamp);
+    if (cumulative_difficulties)
+      cumulative_difficulties->push_back((*i)->cumulative_difficulty);
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::get_alternative_chain_timestamps(const alt_chain_state* tip, const alt_chain_base& base, std::vector<uint64_t>& timestamps) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  timestamps.clear();
+  for (; tip; tip = tip->parent.get())
+    timestamps.push_back(tip->timestamp);
 
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
-    }
+  // the main chain only fills in for a short alternate chain, a long one
+  // is checked against the median of all its blocks
+  if (timestamps.size() < BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+  {
+    const size_t from_base = std::min(BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW - timestamps.size(), base.timestamps.size());
+    timestamps.insert(timestamps.end(), base.timestamps.end() - from_base, base.timestamps.end());
+  }
+}
+//------------------------------------------------------------------
+std::shared_ptr<const Blockchain::alt_chain_base> Blockchain::make_alternative_chain_base(const crypto::hash& fork_id, uint64_t fork_height) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  std::shared_ptr<alt_chain_base> base = std::make_shared<alt_chain_base>();
+  base->fork_id = fork_id;
+  base->fork_height = fork_height;
 
-    // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= DIFFICULTY_BLOCKS_COUNT, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << DIFFICULTY_BLOCKS_COUNT);
+  uint64_t start_height = fork_height + 1 - std::min<uint64_t>(fork_height + 1, DIFFICULTY_BLOCKS_COUNT);
+  if (!start_height)
+    ++start_height; //skip genesis block
 
-    for (auto it : alt_chain)
+  // most forks are near the top of the main chain, which the main chain
+  // stats already hold
+  sync_chain_stats();
+  if (!m_chain_stats.get_blocks(start_height, fork_height + 1, base->timestamps, base->cumulative_difficulties))
+  {
+    m_db->block_txn_start(true);
+    for (uint64_t h = start_height; h <= fork_height; ++h)
     {
-      timestamps.push_back(it->second.bl.timestamp);
-      cumulative_difficulties.push_back(it->second.cumulative_difficulty);
+      base->timestamps.push_back(m_db->get_block_timestamp(h));
+      base->cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(h));
     }
+    m_db->block_txn_stop();
   }
-  // if the alt chain is long enough for the difficulty calc, grab difficulties
-  // and timestamps from it alone
-  else
+  return base;
+}
+//------------------------------------------------------------------
+std::shared_ptr<Blockchain::alt_chain_state> Blockchain::get_alternative_chain_state(blocks_ext_by_hash::iterator it)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  std::shared_ptr<alt_chain_state> state = it->second.alt_state;
+
+  // the state holds as long as the main chain block it forks from does
+  if (state)
   {
-    timestamps.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    cumulative_difficulties.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
-    // get difficulties and timestamps from most recent blocks in alt chain
-    BOOST_REVERSE_FOREACH(auto it, alt_chain)
-    {
-      timestamps[max_i - count] = it->second.bl.timestamp;
-      cumulative_difficulties[max_i - count] = it->second.cumulative_difficulty;
-      count++;
-      if(count >= DIFFICULTY_BLOCKS_COUNT)
-        break;
-    }
+    const alt_chain_base &base = *state->base;
+    if (base.fork_height < m_db->height() && m_db->get_block_hash_from_height(base.fork_height) == base.fork_id)
+      return state;
   }
 
-  // FIXME: This will fail if fork activation heights are subject to voting
-  size_t target = get_ideal_hard_fork_version(bei.height) < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
+  // otherwise the main chain was reorganized below the alt chain, so
+  // rebuild the states of the whole alt chain from its new fork point
+  std::list<blocks_ext_by_hash::iterator> alt_chain;
+  for (auto alt_it = it; alt_it != m_alternative_chains.end(); alt_it = m_alternative_chains.find(alt_it->second.bl.prev_id))
+    alt_chain.push_front(alt_it);
 
-  // calculate the difficulty target for the block and return it
-  return next_difficulty(timestamps, cumulative_difficulties, target);
+  const block_extended_info &front = alt_chain.front()->second;
+  if (!m_db->block_exists(front.bl.prev_id))
+    return nullptr;
+  const uint64_t fork_height = m_db->get_block_height(front.bl.prev_id);
+  CHECK_AND_ASSERT_MES(fork_height + 1 == front.height, nullptr, "alternative chain has wrong connection to main chain");
+
+  std::shared_ptr<const alt_chain_base> base = make_alternative_chain_base(front.bl.prev_id, fork_height);
+  state.reset();
+  for (auto alt_it: alt_chain)
+  {
+    std::shared_ptr<alt_chain_state> next = std::make_shared<alt_chain_state>();
+    next->timestamp = alt_it->second.bl.timestamp;
+    next->cumulative_difficulty = alt_it->second.cumulative_difficulty;
+    next->parent = state;
+    next->base = base;
+    alt_it->second.alt_state = next;
+    state = next;
+  }
+  return state;
 }
 //------------------------------------------------------------------
 // This function does a sanity check on basic things that all miner
@@ -967,9 +1018,8 @@ bool Blockchain::validate_miner_transaction(const block& b, size_t cumulative_bl
     }
   }
 
-  std::vector<size_t> last_blocks_sizes;
-  get_last_n_blocks_sizes(last_blocks_sizes, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-  if (!get_block_reward(epee::misc_utils::median(last_blocks_sizes), cumulative_block_size, already_generated_coins, base_reward, get_current_hard_fork_version()))
+  sync_chain_stats();
+  if (!get_block_reward(m_chain_stats.get_median_block_size(), cumulative_block_size, already_generated_coins, base_reward, get_current_hard_fork_version()))
   {
     LOG_PRINT_L1("block size " << cumulative_block_size << " is bigger than allowed for this blockchain");
     return false;
@@ -1012,6 +1062,10 @@ void Blockchain::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count)
   if(h == 0)
     return;
 
+  sync_chain_stats();
+  if (m_chain_stats.get_block_sizes(sz, count))
+    return;
+
   m_db->block_txn_start(true);
   // add size of last <count> blocks to vector <sz> (or less, if blockchain size < count)
   size_t start_offset = h - std::min<size_t>(h, count);
@@ -1175,27 +1229,6 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
   return false;
 }
 //------------------------------------------------------------------
-// for an alternate chain, get the timestamps from the main chain to complete
-// the needed number of timestamps for the BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW.
-bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vector<uint64_t>& timestamps)
-{
-  LOG_PRINT_L3("Blockchain::" << __func__);
-
-  if(timestamps.size() >= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
-    return true;
-
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  size_t need_elements = BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW - timestamps.size();
-  CHECK_AND_ASSERT_MES(start_top_height < m_db->height(), false, "internal error: passed start_height not < " << " m_db->height() -- " << start_top_height << " >= " << m_db->height());
-  size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
-  while (start_top_height != stop_offset)
-  {
-    timestamps.push_back(m_db->get_block_timestamp(start_top_height));
-    --start_top_height;
-  }
-  return true;
-}
-//------------------------------------------------------------------
 // If a block is to be added and its parent block is not the current
 // main chain top block, then we need to see if we know about its parent block.
 // If its parent block is part of a known forked chain, then we need to see
@@ -1206,7 +1239,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -1233,36 +1265,21 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
   {
     //we have new block in alternative chain
 
-    //build alternative subchain, front -> mainchain, back -> alternative head
-    blocks_ext_by_hash::iterator alt_it = it_prev; //m_alternative_chains.find()
-    std::list<blocks_ext_by_hash::iterator> alt_chain;
-    std::vector<uint64_t> timestamps;
-    while(alt_it != m_alternative_chains.end())
+    // get the state of the alt chain the block builds on, which has what's
+    // needed to check the block without walking back the whole alt chain
+    std::shared_ptr<alt_chain_state> parent_state;
+    std::shared_ptr<const alt_chain_base> base;
+    uint64_t prev_height;
+    if(it_prev != m_alternative_chains.end())
     {
-      alt_chain.push_front(alt_it);
-      timestamps.push_back(alt_it->second.bl.timestamp);
-      alt_it = m_alternative_chains.find(alt_it->second.bl.prev_id);
-    }
-
-    // if block to be added connects to known blocks that aren't part of the
-    // main chain -- that is, if we're adding on to an alternate chain
-    if(alt_chain.size())
-    {
-      // make sure alt chain doesn't somehow start past the end of the main chain
-      CHECK_AND_ASSERT_MES(m_db->height() > alt_chain.front()->second.height, false, "main blockchain wrong height");
-
-      // make sure that the blockchain contains the block that should connect
-      // this alternate chain with it.
-      if (!m_db->block_exists(alt_chain.front()->second.bl.prev_id))
+      parent_state = get_alternative_chain_state(it_prev);
+      if (!parent_state)
       {
         LOG_PRINT_L1("alternate chain does not appear to connect to main chain...");
         return false;
       }
-
-      // make sure block connects correctly to the main chain
-      auto h = m_db->get_block_hash_from_height(alt_chain.front()->second.height - 1);
-      CHECK_AND_ASSERT_MES(h == alt_chain.front()->second.bl.prev_id, false, "alternative chain has wrong connection to main chain");
-      complete_timestamps_vector(m_db->get_block_height(alt_chain.front()->second.bl.prev_id), timestamps);
+      base = parent_state->base;
+      prev_height = it_prev->second.height;
     }
     // if block not associated with known alternate chain
     else
@@ -1271,9 +1288,13 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
       // we ignore it
       CHECK_AND_ASSERT_MES(parent_in_main, false, "internal error: broken imperative condition: parent_in_main");
 
-      complete_timestamps_vector(m_db->get_block_height(b.prev_id), timestamps);
+      prev_height = m_db->get_block_height(b.prev_id);
+      base = make_alternative_chain_base(b.prev_id, prev_height);
     }
 
+    std::vector<uint64_t> timestamps;
+    get_alternative_chain_timestamps(parent_state.get(), *base, timestamps);
+
     // verify that the block's timestamp is within the acceptable range
     // (not earlier than the median of the last X blocks)
     if(!check_block_timestamp(timestamps, b))
@@ -1286,7 +1307,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     // FIXME: consider moving away from block_extended_info at some point
     block_extended_info bei = boost::value_initialized<block_extended_info>();
     bei.bl = b;
-    bei.height = alt_chain.size() ? it_prev->second.height + 1 : m_db->get_block_height(b.prev_id) + 1;
+    bei.height = prev_height + 1;
 
     bool is_a_checkpoint;
     if(!m_checkpoints.check_block(bei.height, id, is_a_checkpoint))
@@ -1298,7 +1319,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 
     // Check the block's hash against the difficulty target for its alt chain
     m_is_in_checkpoint_zone = false;
-    difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
+    difficulty_type current_diff = get_next_difficulty_for_alternative_chain(parent_state.get(), *base, bei);
     CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
     crypto::hash proof_of_work = null_hash;
     get_block_longhash(bei.bl, proof_of_work, bei.height);
@@ -1320,22 +1341,35 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     // this brings up an interesting point: consider allowing to get block
     // difficulty both by height OR by hash, not just height.
     difficulty_type main_chain_cumulative_difficulty = m_db->get_block_cumulative_difficulty(m_db->height() - 1);
-    if (alt_chain.size())
+    if (parent_state)
     {
-      bei.cumulative_difficulty = it_prev->second.cumulative_difficulty;
+      bei.cumulative_difficulty = parent_state->cumulative_difficulty;
     }
     else
     {
       // passed-in block's previous block's cumulative difficulty, found on the main chain
-      bei.cumulative_difficulty = m_db->get_block_cumulative_difficulty(m_db->get_block_height(b.prev_id));
+      bei.cumulative_difficulty = m_db->get_block_cumulative_difficulty(prev_height);
     }
     bei.cumulative_difficulty += current_diff;
 
-    // add block to alternate blocks storage,
-    // as well as the current "alt chain" container
+    bei.alt_state = std::make_shared<alt_chain_state>();
+    bei.alt_state->timestamp = b.timestamp;
+    bei.alt_state->cumulative_difficulty = bei.cumulative_difficulty;
+    bei.alt_state->parent = parent_state;
+    bei.alt_state->base = base;
+
+    // add block to alternate blocks storage
     auto i_res = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, bei));
     CHECK_AND_ASSERT_MES(i_res.second, false, "insertion of new alternative block returned as it already exist");
-    alt_chain.push_back(i_res.first);
+
+    //build alternative subchain, front -> mainchain, back -> alternative head,
+    //only needed if we're going to switch to it
+    std::list<blocks_ext_by_hash::iterator> alt_chain;
+    if(is_a_checkpoint || main_chain_cumulative_difficulty < bei.cumulative_difficulty)
+    {
+      for(auto alt_it = i_res.first; alt_it != m_alternative_chains.end(); alt_it = m_alternative_chains.find(alt_it->second.bl.prev_id))
+        alt_chain.push_front(alt_it);
+    }
 
     // FIXME: is it even possible for a checkpoint to show up not on the main chain?
     if(is_a_checkpoint)
@@ -1427,13 +1461,15 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_db->block_txn_start(true);
   rsp.current_blockchain_height = get_current_blockchain_height();
-  std::list<block> blocks;
+  std::vector<block> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
 
+  rsp.blocks.reserve(blocks.size());
   for (const auto& bl: blocks)
   {
-    std::list<crypto::hash> missed_tx_ids;
-    std::list<transaction> txs;
+    std::vector<crypto::hash> missed_tx_ids;
+    std::vector<transaction> txs;
+    txs.reserve(bl.tx_hashes.size());
 
     // FIXME: s/rsp.missed_ids/missed_tx_id/ ?  Seems like rsp.missed_ids
     //        is for missed blocks, not missed transactions as well.
@@ -1449,7 +1485,7 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
       // append missed transaction hashes to response missed_ids field,
       // as done below if any standalone transactions were requested
       // and missed.
-      rsp.missed_ids.splice(rsp.missed_ids.end(), missed_tx_ids);
+      rsp.missed_ids.insert(rsp.missed_ids.end(), missed_tx_ids.begin(), missed_tx_ids.end());
 	  m_db->block_txn_stop();
       return false;
     }
@@ -1459,13 +1495,15 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
     //pack block
     e.block = t_serializable_object_to_blob(bl);
     //pack transactions
+    e.txs.reserve(txs.size());
     for (transaction& tx: txs)
       e.txs.push_back(t_serializable_object_to_blob(tx));
   }
   //get another transactions, if need
-  std::list<transaction> txs;
+  std::vector<transaction> txs;
   get_transactions(arg.txs, txs, rsp.missed_ids);
   //pack aside transactions
+  rsp.txs.reserve(txs.size());
   for (const auto& tx: txs)
     rsp.txs.push_back(t_serializable_object_to_blob(tx));
 
@@ -1492,17 +1530,48 @@ size_t Blockchain::get_alternative_blocks_count() const
   return m_alternative_chains.size();
 }
 //------------------------------------------------------------------
-// This function adds the output specified by <amount, i> to the result_outs container
-// unlocked and other such checks should be done by here.
-void Blockchain::add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) const
+// This function adds the unlocked outputs among those specified by <amount, indices>
+// to the result_outs container.
+void Blockchain::add_outs_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, const std::vector<uint64_t> &indices) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
-  oen.global_amount_index = i;
-  output_data_t data = m_db->get_output_key(amount, i);
-  oen.out_key = data.pubkey;
+  if (indices.empty())
+    return;
+
+  // the output data carries the unlock time of the output's tx, so
+  // there is no need to look the tx itself up
+  std::vector<output_data_t> outputs;
+  m_db->get_output_key(amount, indices, outputs);
+  for (size_t n = 0; n < indices.size(); ++n)
+  {
+    if (!is_tx_spendtime_unlocked(outputs[n].unlock_time))
+      continue;
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
+    oen.global_amount_index = indices[n];
+    oen.out_key = outputs[n].pubkey;
+  }
+}
+//------------------------------------------------------------------
+uint64_t Blockchain::get_num_mature_outputs(uint64_t amount) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  // outputs are sorted by height, so find the first one which is too
+  // young to be used
+  const uint64_t blockchain_height = m_db->height();
+  uint64_t lo = 0, hi = m_db->get_num_outputs(amount);
+  while (lo < hi)
+  {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (m_db->get_output_key(amount, mid).height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
 }
 //------------------------------------------------------------------
 // This function takes an RPC request for mixins and creates an RPC response
@@ -1518,44 +1587,29 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
   // from BlockchainDB where <n> is req.outs_count (number of mixins).
   for (uint64_t amount : req.amounts)
   {
-    auto num_outs = m_db->get_num_outputs(amount);
     // ensure we don't include outputs that aren't yet eligible to be used
-    // outpouts are sorted by height
-    while (num_outs > 0)
-    {
-      const tx_out_index toi = m_db->get_output_tx_and_index(amount, num_outs - 1);
-      const uint64_t height = m_db->get_tx_block_height(toi.first);
-      if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= m_db->height())
-        break;
-      --num_outs;
-    }
+    const uint64_t num_outs = get_num_mature_outputs(amount);
 
     // create outs_for_amount struct and populate amount field
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
     result_outs.amount = amount;
 
-    std::unordered_set<uint64_t> seen_indices;
-
     // if there aren't enough outputs to mix with (or just enough),
     // use all of them.  Eventually this should become impossible.
     if (num_outs <= req.outs_count)
     {
+      std::vector<uint64_t> indices(num_outs);
       for (uint64_t i = 0; i < num_outs; i++)
-      {
-        // get tx_hash, tx_out_index from DB
-        tx_out_index toi = m_db->get_output_tx_and_index(amount, i);
-
-        // if tx is unlocked, add output to result_outs
-        if (is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first)))
-        {
-          add_out_to_get_random_outs(result_outs, amount, i);
-        }
-
-      }
+        indices[i] = i;
+      add_outs_to_get_random_outs(result_outs, amount, indices);
     }
     else
     {
-      // while we still need more mixins
+      std::unordered_set<uint64_t> seen_indices;
+
+      // while we still need more mixins, pick as many new random outputs as
+      // are missing, and fetch them all at once; locked ones are skipped,
+      // and replaced on the next round
       while (result_outs.outs.size() < req.outs_count)
       {
         // if we've gone through every possible output, we've gotten all we can
@@ -1564,33 +1618,26 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
           break;
         }
 
-        // get a random output index from the DB.  If we've already seen it,
-        // return to the top of the loop and try again, otherwise add it to the
-        // list of output indices we've seen.
-
-        // triangular distribution over [a,b) with a=0, mode c=b=up_index_limit
-        uint64_t r = crypto::rand<uint64_t>() % ((uint64_t)1 << 53);
-        double frac = std::sqrt((double)r / ((uint64_t)1 << 53));
-        uint64_t i = (uint64_t)(frac*num_outs);
-        // just in case rounding up to 1 occurs after sqrt
-        if (i == num_outs)
-          --i;
-
-        if (seen_indices.count(i))
+        std::vector<uint64_t> indices;
+        const size_t wanted = std::min<uint64_t>(req.outs_count - result_outs.outs.size(), num_outs - seen_indices.size());
+        while (indices.size() < wanted)
         {
-          continue;
+          // triangular distribution over [a,b) with a=0, mode c=b=up_index_limit
+          uint64_t r = crypto::rand<uint64_t>() % ((uint64_t)1 << 53);
+          double frac = std::sqrt((double)r / ((uint64_t)1 << 53));
+          uint64_t i = (uint64_t)(frac*num_outs);
+          // just in case rounding up to 1 occurs after sqrt
+          if (i == num_outs)
+            --i;
+
+          // if we've already seen it, try again, otherwise add it to the
+          // list of output indices we've seen.
+          if (!seen_indices.insert(i).second)
+            continue;
+          indices.push_back(i);
         }
-        seen_indices.emplace(i);
-
-        // get tx_hash, tx_out_index from DB
-        tx_out_index toi = m_db->get_output_tx_and_index(amount, i);
 
-        // if the output's transaction is unlocked, add the output's index to
-        // our list.
-        if (is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first)))
-        {
-          add_out_to_get_random_outs(result_outs, amount, i);
-        }
+        add_outs_to_get_random_outs(result_outs, amount, indices);
       }
     }
   }
@@ -1606,12 +1653,11 @@ bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS::request& req, COMMAND_R
   res.outs.reserve(req.outputs.size());
   for (const auto &i: req.outputs)
   {
-    // get tx_hash, tx_out_index from DB
-    crypto::public_key key = m_db->get_output_key(i.amount, i.index).pubkey;
-    tx_out_index toi = m_db->get_output_tx_and_index(i.amount, i.index);
-    bool unlocked = is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first));
+    // the output data carries its tx's unlock time
+    const output_data_t data = m_db->get_output_key(i.amount, i.index);
+    bool unlocked = is_tx_spendtime_unlocked(data.unlock_time);
 
-    res.outs.push_back({key, unlocked});
+    res.outs.push_back({data.pubkey, unlocked});
   }
   return true;
 }
@@ -1822,11 +1868,10 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
   return true;
 }
 //------------------------------------------------------------------
-//FIXME: change argument to std::vector, low priority
 // find split point between ours and foreign blockchain (or start at
 // blockchain height <req_start_block>), and return up to max_count FULL
 // blocks by reference.
-bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
+bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<block, std::vector<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -1850,12 +1895,14 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
   }
 
   total_height = get_current_blockchain_height();
+  blocks.reserve(blocks.size() + std::min<uint64_t>(max_count, total_height - start_height));
   size_t count = 0;
   for(size_t i = start_height; i < total_height && count < max_count; i++, count++)
   {
     blocks.resize(blocks.size()+1);
     blocks.back().first = m_db->get_block_from_height(i);
-    std::list<crypto::hash> mis;
+    blocks.back().second.reserve(blocks.back().first.tx_hashes.size());
+    std::vector<crypto::hash> mis;
     get_transactions(blocks.back().first.tx_hashes, blocks.back().second, mis);
     CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
   }
@@ -2068,13 +2115,16 @@ bool Blockchain::check_tx_outputs(const transaction& tx, tx_verification_context
 bool Blockchain::have_tx_keyimges_as_spent(const transaction &tx) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+  std::vector<crypto::key_image> key_images;
+  key_images.reserve(tx.vin.size());
   for (const txin_v& in: tx.vin)
   {
     CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, in_to_key, true);
-    if(have_tx_keyimg_as_spent(in_to_key.k_image))
-      return true;
+    key_images.push_back(in_to_key.k_image);
   }
-  return false;
+  std::vector<bool> spent;
+  are_key_images_spent(key_images, spent);
+  return std::find(spent.begin(), spent.end(), true) != spent.end();
 }
 //------------------------------------------------------------------
 // This function validates transaction inputs and their keys.
@@ -2172,6 +2222,18 @@ bool Blockchain::check_tx_inputs(const transaction& tx, tx_verification_context
 
   epee::misc_utils::auto_scope_leave_caller ioservice_killer = epee::misc_utils::create_scope_leave_handler([&]() { KILL_IOSERVICE(); });
 
+  // look up all the key images in one go, rather than one db lookup per input
+  std::vector<crypto::key_image> key_images;
+  key_images.reserve(tx.vin.size());
+  for (const auto& txin : tx.vin)
+  {
+    if (txin.type() == typeid(txin_to_key))
+      key_images.push_back(boost::get<txin_to_key>(txin).k_image);
+  }
+  std::vector<bool> key_images_spent;
+  are_key_images_spent(key_images, key_images_spent);
+  size_t key_image_index = 0;
+
   for (const auto& txin : tx.vin)
   {
     // make sure output being spent is of type txin_to_key, rather than
@@ -2182,7 +2244,7 @@ bool Blockchain::check_tx_inputs(const transaction& tx, tx_verification_context
     // make sure tx output has key offset(s) (is signed to be used)
     CHECK_AND_ASSERT_MES(in_to_key.key_offsets.size(), false, "empty in_to_key.key_offsets in transaction with id " << get_transaction_hash(tx));
 
-    if(have_tx_keyimg_as_spent(in_to_key.k_image))
+    if(key_images_spent[key_image_index++])
     {
       LOG_PRINT_L1("Key image already spent in blockchain: " << epee::string_tools::pod_to_hex(in_to_key.k_image));
       tvc.m_double_spend = true;
@@ -2282,6 +2344,25 @@ void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const
     return;
   }
 
+  // popular outputs are ring members in many txes, so their precomputed
+  // form is cached; keys which are not valid points take the plain path
+  std::vector<std::shared_ptr<const crypto::ring_member_precomp>> members;
+  std::vector<const crypto::ring_member_precomp *> p_members;
+  members.reserve(pubkeys.size());
+  p_members.reserve(pubkeys.size());
+  for (auto &key : pubkeys)
+  {
+    members.push_back(get_ring_member_precomp(key));
+    if (!members.back())
+      break;
+    p_members.push_back(members.back().get());
+  }
+  if (p_members.size() == pubkeys.size())
+  {
+    result = crypto::check_ring_signature(tx_prefix_hash, key_image, p_members.data(), p_members.size(), sig.data()) ? 1 : 0;
+    return;
+  }
+
   std::vector<const crypto::public_key *> p_output_keys;
   for (auto &key : pubkeys)
   {
@@ -2290,6 +2371,18 @@ void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const
 
   result = crypto::check_ring_signature(tx_prefix_hash, key_image, p_output_keys, sig.data()) ? 1 : 0;
 }
+//------------------------------------------------------------------
+std::shared_ptr<const crypto::ring_member_precomp> Blockchain::get_ring_member_precomp(const crypto::public_key &pubkey)
+{
+  std::shared_ptr<const crypto::ring_member_precomp> member;
+  if (m_ring_member_cache.get(pubkey, member))
+    return member;
+  std::shared_ptr<crypto::ring_member_precomp> precomp = std::make_shared<crypto::ring_member_precomp>();
+  if (!crypto::precompute_ring_member(pubkey, *precomp))
+    return NULL;
+  m_ring_member_cache.insert(pubkey, precomp, sizeof(crypto::ring_member_precomp) + sizeof(crypto::public_key));
+  return precomp;
+}
 
 //------------------------------------------------------------------
 // This function checks to see if a tx is unlocked.  unlock_time is either
@@ -2415,22 +2508,20 @@ bool Blockchain::check_block_timestamp(const block& b) const
   }
 
   // if not enough blocks, no proper median yet, return true
-  if(m_db->height() < BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+  sync_chain_stats();
+  uint64_t median_ts;
+  if(!m_chain_stats.get_median_timestamp(median_ts))
   {
     return true;
   }
 
-  std::vector<uint64_t> timestamps;
-  auto h = m_db->height();
-
-  // need most recent 60 blocks, get index of first of those
-  size_t offset = h - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW;
-  for(;offset < h; ++offset)
+  if(b.timestamp < median_ts)
   {
-    timestamps.push_back(m_db->get_block_timestamp(offset));
+    LOG_PRINT_L1("Timestamp of block with id: " << get_block_hash(b) << ", " << b.timestamp << ", less than median of last " << BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW << " blocks, " << median_ts);
+    return false;
   }
 
-  return check_block_timestamp(timestamps, b);
+  return true;
 }
 //------------------------------------------------------------------
 void Blockchain::return_tx_to_pool(const std::vector<transaction> &txs)
@@ -2753,6 +2844,10 @@ leave:
     try
     {
       new_height = m_db->add_block(bl, block_size, cumulative_difficulty, already_generated_coins, txs);
+      if (m_chain_stats.height() + 1 == new_height)
+        m_chain_stats.push(bl.timestamp, cumulative_difficulty, block_size);
+      else
+        m_chain_stats.clear();
     }
     catch (const KEY_IMAGE_EXISTS& e)
     {
@@ -2803,10 +2898,9 @@ bool Blockchain::update_next_cumulative_size_limit()
   uint64_t full_reward_zone = get_current_hard_fork_version() < 2 ? CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V1 : CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2;
 
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::vector<size_t> sz;
-  get_last_n_blocks_sizes(sz, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
+  sync_chain_stats();
 
-  uint64_t median = epee::misc_utils::median(sz);
+  uint64_t median = m_chain_stats.get_median_block_size();
   if(median <= full_reward_zone)
     median = full_reward_zone;
 
@@ -2814,6 +2908,18 @@ bool Blockchain::update_next_cumulative_size_limit()
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::sync_chain_stats() const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (m_chain_stats.height() == m_db->height())
+    return;
+
+  LOG_PRINT_L2("Reloading main chain stats from the db");
+  m_db->block_txn_start(true);
+  m_chain_stats.load(*m_db);
+  m_db->block_txn_stop();
+}
+//------------------------------------------------------------------
 bool Blockchain::add_new_block(const block& bl_, block_verification_context& bvc)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2994,10 +3100,11 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
   catch (const std::exception& e)
   {
     LOG_PRINT_L1("EXCEPTION: " << e.what());
+    outputs.clear();
   }
   catch (...)
   {
-
+    outputs.clear();
   }
 }
 
@@ -3008,7 +3115,7 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
 //    vs [k_image, output_keys] (m_scan_table). This is faster because it takes advantage of bulk queries
 //    and is threaded if possible. The table (m_scan_table) will be used later when querying output
 //    keys.
-bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_entry> &blocks_entry)
+bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry)
 {
   LOG_PRINT_YELLOW("Blockchain::" << __func__, LOG_LEVEL_3);
   TIME_MEASURE_START(prepare);
@@ -3140,6 +3247,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
   std::map<uint64_t, std::vector<uint64_t>> offset_map;
   // [output] stores all output_data_t for each absolute_offset
   std::map<uint64_t, std::vector<output_data_t>> tx_map;
+  // the parsed txs and their prefix hashes, to fill m_scan_table from
+  std::vector<std::pair<crypto::hash, transaction>> txs;
 
 #define SCAN_TABLE_QUIT(m) \
         do { \
@@ -3148,7 +3257,9 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
             return false; \
         } while(0); \
 
-  // generate sorted tables for all amounts and absolute offsets
+  // gather the amounts and absolute offsets of every ring member referenced
+  // by every tx in the batch, so that outputs shared between rings are only
+  // fetched once, and each amount's outputs are fetched in index order
   for (const auto &entry : blocks_entry)
   {
     for (const auto &tx_blob : entry.txs)
@@ -3168,7 +3279,6 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
       its = m_scan_table.find(tx_prefix_hash);
       assert(its != m_scan_table.end());
 
-      // get all amounts from tx.vin(s)
       for (const auto &txin : tx.vin)
       {
         const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
@@ -3179,44 +3289,25 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
           SCAN_TABLE_QUIT("Duplicate key_image found from incoming blocks.");
 
         amounts.push_back(in_to_key.amount);
-      }
-
-      // sort and remove duplicate amounts from amounts list
-      std::sort(amounts.begin(), amounts.end());
-      auto last = std::unique(amounts.begin(), amounts.end());
-      amounts.erase(last, amounts.end());
-
-      // add amount to the offset_map and tx_map
-      for (const uint64_t &amount : amounts)
-      {
-        if (offset_map.find(amount) == offset_map.end())
-          offset_map.emplace(amount, std::vector<uint64_t>());
-
-        if (tx_map.find(amount) == tx_map.end())
-          tx_map.emplace(amount, std::vector<output_data_t>());
-      }
-
-      // add new absolute_offsets to offset_map
-      for (const auto &txin : tx.vin)
-      {
-        const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
-        // no need to check for duplicate here.
+        std::vector<uint64_t> &offsets = offset_map[in_to_key.amount];
         auto absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
-        for (const auto & offset : absolute_offsets)
-          offset_map[in_to_key.amount].push_back(offset);
-
+        offsets.insert(offsets.end(), absolute_offsets.begin(), absolute_offsets.end());
       }
 
-      // sort and remove duplicate absolute_offsets in offset_map
-      for (auto &offsets : offset_map)
-      {
-        std::sort(offsets.second.begin(), offsets.second.end());
-        auto last = std::unique(offsets.second.begin(), offsets.second.end());
-        offsets.second.erase(last, offsets.second.end());
-      }
+      txs.push_back(std::make_pair(tx_prefix_hash, std::move(tx)));
     }
   }
 
+  // sort and remove duplicate amounts and absolute_offsets
+  std::sort(amounts.begin(), amounts.end());
+  amounts.erase(std::unique(amounts.begin(), amounts.end()), amounts.end());
+  for (auto &offsets : offset_map)
+  {
+    std::sort(offsets.second.begin(), offsets.second.end());
+    offsets.second.erase(std::unique(offsets.second.begin(), offsets.second.end()), offsets.second.end());
+    tx_map.emplace(offsets.first, std::vector<output_data_t>());
+  }
+
   // [output] stores all transactions for each tx_out_index::hash found
   std::vector<std::unordered_map<crypto::hash, cryptonote::transaction>> transactions(amounts.size());
 
@@ -3257,52 +3348,38 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
   int total_txs = 0;
 
   // now generate a table for each tx_prefix and k_image hashes
-  for (const auto &entry : blocks_entry)
+  for (const auto &tx_entry : txs)
   {
-    for (const auto &tx_blob : entry.txs)
-    {
-      crypto::hash tx_hash = null_hash;
-      crypto::hash tx_prefix_hash = null_hash;
-      transaction tx;
+    const crypto::hash &tx_prefix_hash = tx_entry.first;
+    const transaction &tx = tx_entry.second;
 
-      if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash))
-        SCAN_TABLE_QUIT("Could not parse tx from incoming blocks.");
+    ++total_txs;
+    auto its = m_scan_table.find(tx_prefix_hash);
+    if (its == m_scan_table.end())
+      SCAN_TABLE_QUIT("Tx not found on scan table from incoming blocks.");
 
-      ++total_txs;
-      auto its = m_scan_table.find(tx_prefix_hash);
-      if (its == m_scan_table.end())
-        SCAN_TABLE_QUIT("Tx not found on scan table from incoming blocks.");
+    for (const auto &txin : tx.vin)
+    {
+      const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
+      auto needed_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+      const std::vector<uint64_t> &offsets_found = offset_map[in_to_key.amount];
+      const std::vector<output_data_t> &outputs_found = tx_map[in_to_key.amount];
 
-      for (const auto &txin : tx.vin)
+      // outputs_found is empty if the lookup for this amount failed; stop
+      // at the first missing output, check_tx_inputs fetches the rest
+      std::vector<output_data_t> outputs;
+      outputs.reserve(needed_offsets.size());
+      for (const uint64_t & offset_needed : needed_offsets)
       {
-        const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
-        auto needed_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
-
-        std::vector<output_data_t> outputs;
-        for (const uint64_t & offset_needed : needed_offsets)
-        {
-          size_t pos = 0;
-          bool found = false;
-
-          for (const uint64_t &offset_found : offset_map[in_to_key.amount])
-          {
-            if (offset_needed == offset_found)
-            {
-              found = true;
-              break;
-            }
-
-            ++pos;
-          }
-
-          if (found && pos < tx_map[in_to_key.amount].size())
-            outputs.push_back(tx_map[in_to_key.amount].at(pos));
-          else
-            break;
-        }
-
-        its->second.emplace(in_to_key.k_image, outputs);
+        auto found = std::lower_bound(offsets_found.begin(), offsets_found.end(), offset_needed);
+        size_t pos = found - offsets_found.begin();
+        if (found != offsets_found.end() && *found == offset_needed && pos < outputs_found.size())
+          outputs.push_back(outputs_found[pos]);
+        else
+          break;
       }
+
+      its->second.emplace(in_to_key.k_image, std::move(outputs));
     }
   }
 
@@ -38,6 +38,7 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/foreach.hpp>
 #include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -45,6 +46,7 @@
 #include "string_tools.h"
 #include "cryptonote_basic.h"
 #include "common/util.h"
+#include "common/lru_cache.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "difficulty.h"
@@ -53,6 +55,7 @@
 #include "crypto/hash.h"
 #include "checkpoints.h"
 #include "hardfork.h"
+#include "chain_stats.h"
 #include "blockchain_db/blockchain_db.h"
 
 namespace cryptonote
@@ -70,6 +73,19 @@ namespace cryptonote
     db_nosync //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
   };
 
+  /**
+   * @brief hasher for public keys, which are uniformly distributed already
+   */
+  struct public_key_hash
+  {
+    size_t operator()(const crypto::public_key &k) const
+    {
+      size_t h;
+      memcpy(&h, &k, sizeof(h));
+      return h;
+    }
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -87,6 +103,40 @@ namespace cryptonote
       std::vector<uint64_t> m_global_output_indexes;
     };
 
+    /**
+     * @brief the main chain blocks an alternate chain forks from
+     *
+     * Holds the timestamps and cumulative difficulties of the last
+     * DIFFICULTY_BLOCKS_COUNT main chain blocks up to and including the fork
+     * point, genesis excluded.  It is read once per fork point and shared by
+     * all the alternate blocks above it.
+     */
+    struct alt_chain_base
+    {
+      crypto::hash fork_id; //!< the hash of the main chain block the alternate chain forks from
+      uint64_t fork_height; //!< the height of that block
+      std::vector<uint64_t> timestamps; //!< main chain timestamps, oldest first
+      std::vector<difficulty_type> cumulative_difficulties; //!< main chain cumulative difficulties, oldest first
+    };
+
+    /**
+     * @brief the state of an alternate chain at one of its blocks
+     *
+     * Each alternate block links to the state of its parent, so blocks on
+     * the same branch share their common history rather than copying it,
+     * and the difficulty window for a new block can be read by walking
+     * back at most a window's worth of blocks.
+     */
+    struct alt_chain_state
+    {
+      ~alt_chain_state();
+
+      uint64_t timestamp; //!< the block's timestamp
+      difficulty_type cumulative_difficulty; //!< the accumulated difficulty after that block
+      std::shared_ptr<alt_chain_state> parent; //!< the parent's state, or null if the parent is on the main chain
+      std::shared_ptr<const alt_chain_base> base; //!< the main chain blocks below the alternate chain
+    };
+
     /**
      * @brief container for passing a block and metadata about it on the blockchain
      */
@@ -97,6 +147,7 @@ namespace cryptonote
       size_t block_cumulative_size; //!< the size (in bytes) of the block
       difficulty_type cumulative_difficulty; //!< the accumulated difficulty after that block
       uint64_t already_generated_coins; //!< the total coins minted after that block
+      std::shared_ptr<alt_chain_state> alt_state; //!< the alternate chain state, for alternate blocks
     };
 
     /**
@@ -183,6 +234,20 @@ namespace cryptonote
      */
     size_t get_alternative_blocks_count() const;
 
+    /**
+     * @brief sets the memory limit of the ring member cache
+     *
+     * @param max_bytes the approximate limit, 0 disables the cache
+     */
+    void set_ring_member_cache_limit(size_t max_bytes) { m_ring_member_cache.set_limit(max_bytes); }
+
+    /**
+     * @brief gets hit/miss statistics for the ring member cache
+     *
+     * @return the cache statistics
+     */
+    tools::lru_cache_stats get_ring_member_cache_stats() const { return m_ring_member_cache.get_stats(); }
+
     /**
      * @brief gets a block's hash given a height
      *
@@ -218,7 +283,7 @@ namespace cryptonote
      *
      * @return false on erroneous blocks, else true
      */
-    bool prepare_handle_incoming_blocks(const std::list<block_complete_entry>  &blocks);
+    bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks);
 
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
@@ -261,6 +326,19 @@ namespace cryptonote
      */
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im) const;
 
+    /**
+     * @brief check which of a set of key images are already spent on the blockchain
+     *
+     * The key images are looked up in the database as a batch, which is
+     * much faster than checking them one by one when there are many.
+     *
+     * @param key_im the key images to search for
+     * @param spent return-by-reference whether each key image is spent
+     *
+     * @return true
+     */
+    bool are_key_images_spent(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const;
+
     /**
      * @brief get the current height of the blockchain
      *
@@ -407,7 +485,7 @@ namespace cryptonote
      *
      * @return true if a block found in common or req_start_block specified, else false
      */
-    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const;
+    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<block, std::vector<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const;
 
     /**
      * @brief retrieves a set of blocks and their transactions, and possibly other transactions
@@ -828,9 +906,12 @@ namespace cryptonote
     uint64_t m_fake_pow_calc_time;
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
-    std::vector<uint64_t> m_timestamps;
-    std::vector<difficulty_type> m_difficulties;
-    uint64_t m_timestamps_and_difficulties_height;
+
+    // stats over the top blocks of the main chain, see sync_chain_stats
+    mutable chain_stats m_chain_stats;
+
+    // precomputed ring members, by output public key
+    tools::lru_cache<crypto::public_key, std::shared_ptr<const crypto::ring_member_precomp>, public_key_hash> m_ring_member_cache;
 
     boost::asio::io_service m_async_service;
     boost::thread_group m_async_pool;
@@ -982,12 +1063,61 @@ namespace cryptonote
     /**
      * @brief gets the difficulty requirement for a new block on an alternate chain
      *
-     * @param alt_chain the chain to be added to
+     * @param parent the state of the new block's parent, or null if the parent is on the main chain
+     * @param base the main chain blocks the alternate chain forks from
      * @param bei the block being added (and metadata, see ::block_extended_info)
      *
      * @return the difficulty requirement
      */
-    difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei) const;
+    difficulty_type get_next_difficulty_for_alternative_chain(const alt_chain_state* parent, const alt_chain_base& base, block_extended_info& bei) const;
+
+    /**
+     * @brief gets the most recent timestamps and cumulative difficulties of an alternate chain
+     *
+     * Takes the blocks from the alternate chain first, then from the main
+     * chain blocks it forks from.
+     *
+     * @param tip the state of the alternate chain's top block, or null for an empty alternate chain
+     * @param base the main chain blocks the alternate chain forks from
+     * @param count the maximum number of blocks to get
+     * @param timestamps return-by-reference the timestamps, oldest first
+     * @param cumulative_difficulties return-by-reference the cumulative difficulties, oldest first, or null if not needed
+     */
+    void get_alternative_chain_window(const alt_chain_state* tip, const alt_chain_base& base, size_t count, std::vector<uint64_t>& timestamps, std::vector<difficulty_type>* cumulative_difficulties) const;
+
+    /**
+     * @brief gets the timestamps to check a new alternate block's timestamp against
+     *
+     * Takes every block of the alternate chain back to the fork point, and
+     * if there are fewer than BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW of them, as
+     * many main chain blocks below the fork point as needed to make up the
+     * window.
+     *
+     * @param tip the state of the alternate chain's top block, or null for an empty alternate chain
+     * @param base the main chain blocks the alternate chain forks from
+     * @param timestamps return-by-reference the timestamps, in no particular order
+     */
+    void get_alternative_chain_timestamps(const alt_chain_state* tip, const alt_chain_base& base, std::vector<uint64_t>& timestamps) const;
+
+    /**
+     * @brief reads the main chain blocks an alternate chain forks from
+     *
+     * @param fork_id the hash of the main chain block the alternate chain forks from
+     * @param fork_height the height of that block
+     *
+     * @return the main chain blocks
+     */
+    std::shared_ptr<const alt_chain_base> make_alternative_chain_base(const crypto::hash& fork_id, uint64_t fork_height) const;
+
+    /**
+     * @brief gets the state of an alternate block, rebuilding the states of
+     * its chain if the main chain it forked from has since changed
+     *
+     * @param it the alternate block
+     *
+     * @return the state, or null if the alternate chain no longer connects to the main chain
+     */
+    std::shared_ptr<alt_chain_state> get_alternative_chain_state(blocks_ext_by_hash::iterator it);
 
     /**
      * @brief sanity checks a miner transaction before validating an entire block
@@ -1045,13 +1175,29 @@ namespace cryptonote
     void get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) const;
 
     /**
-     * @brief adds the given output to the requested set of random outputs
+     * @brief adds the unlocked ones of the given outputs to the requested set of random outputs
      *
-     * @param result_outs return-by-reference the set the output is to be added to
+     * The outputs' data, including their unlock times, are fetched in one
+     * bulk lookup.
+     *
+     * @param result_outs return-by-reference the set the outputs are to be added to
      * @param amount the output amount
-     * @param i the output index (indexed to amount)
+     * @param indices the output indices (indexed to amount)
      */
-    void add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) const;
+    void add_outs_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, const std::vector<uint64_t> &indices) const;
+
+    /**
+     * @brief gets the number of outputs of an amount which are old enough to be used
+     *
+     * Outputs of an amount are indexed in the order they were added to the
+     * chain, so their heights are sorted, and the cutoff for outputs younger
+     * than CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE can be found by binary search.
+     *
+     * @param amount the output amount
+     *
+     * @return the number of outputs of that amount that are old enough
+     */
+    uint64_t get_num_mature_outputs(uint64_t amount) const;
 
     /**
      * @brief checks if a transaction is unlocked (its outputs spendable)
@@ -1132,24 +1278,20 @@ namespace cryptonote
     uint64_t get_adjusted_time() const;
 
     /**
-     * @brief finish an alternate chain's timestamp window from the main chain
-     *
-     * for an alternate chain, get the timestamps from the main chain to complete
-     * the needed number of timestamps for the BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW.
-     *
-     * @param start_height the alternate chain's attachment height to the main chain
-     * @param timestamps return-by-value the timestamps set to be populated
+     * @brief calculate the block size limit for the next block to be added
      *
-     * @return true unless start_height is greater than the current blockchain height
+     * @return true
      */
-    bool complete_timestamps_vector(uint64_t start_height, std::vector<uint64_t>& timestamps);
+    bool update_next_cumulative_size_limit();
 
     /**
-     * @brief calculate the block size limit for the next block to be added
+     * @brief makes sure the main chain stats describe the current main chain
      *
-     * @return true
+     * The stats are normally kept in step as blocks are added and popped,
+     * so this only reloads them from the db if their height does not match
+     * the db's, eg after a failed batch.
      */
-    bool update_next_cumulative_size_limit();
+    void sync_chain_stats() const;
     void return_tx_to_pool(const std::vector<transaction> &txs);
 
     /**
@@ -1174,6 +1316,15 @@ namespace cryptonote
     void check_ring_signature(const crypto::hash &tx_prefix_hash, const crypto::key_image &key_image,
         const std::vector<crypto::public_key> &pubkeys, const std::vector<crypto::signature> &sig, uint64_t &result);
 
+    /**
+     * @brief gets the precomputed form of a ring member, from the cache if possible
+     *
+     * @param pubkey the ring member's public key
+     *
+     * @return the precomputed ring member, or NULL if the key is not a valid point
+     */
+    std::shared_ptr<const crypto::ring_member_precomp> get_ring_member_precomp(const crypto::public_key &pubkey);
+
     /**
      * @brief loads block hashes from compiled-in data set
      *
@@ -70,6 +70,15 @@ bool blockchain_storage::have_tx_keyimg_as_spent(const crypto::key_image &key_im
   return  m_spent_keys.find(key_im) != m_spent_keys.end();
 }
 //------------------------------------------------------------------
+bool blockchain_storage::are_key_images_spent(const std::vector<crypto::key_image> &key_im, std::vector<bool> &spent) const
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  spent.clear();
+  for (const auto &ki: key_im)
+    spent.push_back(m_spent_keys.find(ki) != m_spent_keys.end());
+  return true;
+}
+//------------------------------------------------------------------
 const transaction *blockchain_storage::get_tx(const crypto::hash &id) const
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -1244,7 +1253,7 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
   return true;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
+bool blockchain_storage::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<block, std::vector<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if(req_start_block > 0) {
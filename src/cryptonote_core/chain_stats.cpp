@@ -0,0 +1,185 @@
+// Copyright (c) 2014-2016, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "misc_log_ex.h"
+#include "blockchain_db/blockchain_db.h"
+#include "chain_stats.h"
+
+using namespace cryptonote;
+
+const size_t chain_stats::WINDOW_SIZE;
+
+chain_stats::chain_stats():
+  m_blocks(WINDOW_SIZE),
+  m_height(0),
+  m_next_difficulty_target(0),
+  m_next_difficulty(0)
+{
+}
+
+void chain_stats::clear()
+{
+  m_blocks.clear();
+  m_height = 0;
+  m_timestamps.clear();
+  m_sizes.clear();
+  m_next_difficulty_target = 0;
+}
+
+void chain_stats::load(const BlockchainDB &db)
+{
+  clear();
+  const uint64_t height = db.height();
+  m_height = height - std::min<uint64_t>(height, WINDOW_SIZE);
+  for (uint64_t h = m_height; h < height; ++h)
+    push(db.get_block_timestamp(h), db.get_block_cumulative_difficulty(h), db.get_block_size(h));
+}
+
+void chain_stats::push(uint64_t timestamp, difficulty_type cumulative_difficulty, size_t block_size)
+{
+  // drop the blocks which are leaving the median windows
+  const size_t n = m_blocks.size();
+  if (n >= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+    m_timestamps.erase(m_blocks[n - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW].timestamp);
+  if (n >= CRYPTONOTE_REWARD_BLOCKS_WINDOW)
+    m_sizes.erase(m_blocks[n - CRYPTONOTE_REWARD_BLOCKS_WINDOW].block_size);
+
+  m_blocks.push_back(block_stats{timestamp, cumulative_difficulty, block_size});
+  m_timestamps.insert(timestamp);
+  m_sizes.insert(block_size);
+  ++m_height;
+  m_next_difficulty_target = 0;
+}
+
+void chain_stats::pop(const BlockchainDB &db)
+{
+  CHECK_AND_ASSERT_THROW_MES(!m_blocks.empty(), "Attempted to pop from empty chain stats");
+
+  const size_t n = m_blocks.size();
+  const block_stats &top = m_blocks.back();
+  m_timestamps.erase(top.timestamp);
+  m_sizes.erase(top.block_size);
+
+  // bring back the blocks which are coming back into the median windows
+  if (n > BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+    m_timestamps.insert(m_blocks[n - 1 - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW].timestamp);
+  if (n > CRYPTONOTE_REWARD_BLOCKS_WINDOW)
+    m_sizes.insert(m_blocks[n - 1 - CRYPTONOTE_REWARD_BLOCKS_WINDOW].block_size);
+
+  m_blocks.pop_back();
+  --m_height;
+  m_next_difficulty_target = 0;
+
+  // refill the oldest slot from the db, so the window stays full
+  const uint64_t first = m_height - m_blocks.size();
+  if (first > 0)
+  {
+    const uint64_t h = first - 1;
+    push_front(block_stats{db.get_block_timestamp(h), db.get_block_cumulative_difficulty(h), db.get_block_size(h)});
+  }
+}
+
+void chain_stats::push_front(const block_stats &stats)
+{
+  m_blocks.push_front(stats);
+  if (m_blocks.size() <= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+    m_timestamps.insert(stats.timestamp);
+  if (m_blocks.size() <= CRYPTONOTE_REWARD_BLOCKS_WINDOW)
+    m_sizes.insert(stats.block_size);
+}
+
+void chain_stats::get_difficulty_window(std::vector<uint64_t> &timestamps, std::vector<difficulty_type> &cumulative_difficulties) const
+{
+  const size_t n = m_blocks.size();
+  size_t start = n - std::min<size_t>(n, DIFFICULTY_BLOCKS_COUNT);
+  // the genesis block is not taken into account
+  if (m_height - n + start == 0 && start < n)
+    ++start;
+
+  timestamps.clear();
+  cumulative_difficulties.clear();
+  timestamps.reserve(n - start);
+  cumulative_difficulties.reserve(n - start);
+  for (size_t i = start; i < n; ++i)
+  {
+    timestamps.push_back(m_blocks[i].timestamp);
+    cumulative_difficulties.push_back(m_blocks[i].cumulative_difficulty);
+  }
+}
+
+bool chain_stats::get_blocks(uint64_t start_height, uint64_t end_height, std::vector<uint64_t> &timestamps, std::vector<difficulty_type> &cumulative_difficulties) const
+{
+  const uint64_t first = m_height - m_blocks.size();
+  if (start_height < first || end_height > m_height || start_height > end_height)
+    return false;
+
+  timestamps.clear();
+  cumulative_difficulties.clear();
+  for (uint64_t h = start_height; h < end_height; ++h)
+  {
+    const block_stats &stats = m_blocks[h - first];
+    timestamps.push_back(stats.timestamp);
+    cumulative_difficulties.push_back(stats.cumulative_difficulty);
+  }
+  return true;
+}
+
+bool chain_stats::get_block_sizes(std::vector<size_t> &sizes, size_t count) const
+{
+  const size_t n = m_blocks.size();
+  if (count > n && m_height > n)
+    return false;
+
+  for (size_t i = n - std::min(n, count); i < n; ++i)
+    sizes.push_back(m_blocks[i].block_size);
+  return true;
+}
+
+bool chain_stats::get_median_timestamp(uint64_t &median) const
+{
+  if (m_height < BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+    return false;
+  median = m_timestamps.median();
+  return true;
+}
+
+bool chain_stats::get_next_difficulty(size_t target, difficulty_type &difficulty) const
+{
+  if (m_next_difficulty_target == 0 || m_next_difficulty_target != target)
+    return false;
+  difficulty = m_next_difficulty;
+  return true;
+}
+
+void chain_stats::set_next_difficulty(size_t target, difficulty_type difficulty)
+{
+  m_next_difficulty_target = target;
+  m_next_difficulty = difficulty;
+}
@@ -0,0 +1,264 @@
+// Copyright (c) 2014-2016, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <set>
+#include <vector>
+#include <boost/circular_buffer.hpp>
+
+#include "cryptonote_config.h"
+#include "difficulty.h"
+
+namespace cryptonote
+{
+  class BlockchainDB;
+
+  /**
+   * @brief a median over a sliding window of values
+   *
+   * The window is split into a lower and an upper half, each kept sorted,
+   * so that inserting or erasing a value is O(log n) and the median is O(1).
+   * The median is computed the same way as epee::misc_utils::median: for an
+   * even number of values, it is the mean of the two middle values.
+   */
+  template<typename T>
+  class rolling_median
+  {
+  public:
+    size_t size() const { return m_low.size() + m_high.size(); }
+
+    void clear()
+    {
+      m_low.clear();
+      m_high.clear();
+    }
+
+    void insert(const T &value)
+    {
+      if (m_low.empty() || value <= *m_low.rbegin())
+        m_low.insert(value);
+      else
+        m_high.insert(value);
+      rebalance();
+    }
+
+    /**
+     * @brief removes one instance of a value
+     *
+     * @return false if the value was not found, true otherwise
+     */
+    bool erase(const T &value)
+    {
+      auto i = m_low.find(value);
+      if (i != m_low.end())
+      {
+        m_low.erase(i);
+      }
+      else
+      {
+        auto j = m_high.find(value);
+        if (j == m_high.end())
+          return false;
+        m_high.erase(j);
+      }
+      rebalance();
+      return true;
+    }
+
+    T median() const
+    {
+      if (m_low.empty())
+        return T();
+      if (m_low.size() > m_high.size())
+        return *m_low.rbegin();
+      return (*m_low.rbegin() + *m_high.begin()) / 2;
+    }
+
+  private:
+    // m_low holds the lower half, plus the middle value if the size is odd
+    void rebalance()
+    {
+      while (m_low.size() > m_high.size() + 1)
+      {
+        auto i = std::prev(m_low.end());
+        m_high.insert(*i);
+        m_low.erase(i);
+      }
+      while (m_high.size() > m_low.size())
+      {
+        auto i = m_high.begin();
+        m_low.insert(*i);
+        m_high.erase(i);
+      }
+    }
+
+    std::multiset<T> m_low;
+    std::multiset<T> m_high;
+  };
+
+  /**
+   * @brief statistics over the most recent blocks of the main chain
+   *
+   * Keeps the timestamps, cumulative difficulties and sizes of the last
+   * blocks in a ring buffer large enough for the difficulty, timestamp
+   * check and block reward windows, along with running medians of the
+   * timestamp check and block reward windows.  Adding or popping a block
+   * costs O(log n), and popping reads at most one older block back from
+   * the db.
+   *
+   * The caller is responsible for calling push() and pop() in step with
+   * the main chain, and for calling load() if that is not known to hold.
+   */
+  class chain_stats
+  {
+  public:
+    static const size_t WINDOW_SIZE = (DIFFICULTY_BLOCKS_COUNT) > CRYPTONOTE_REWARD_BLOCKS_WINDOW ? (DIFFICULTY_BLOCKS_COUNT) : CRYPTONOTE_REWARD_BLOCKS_WINDOW;
+
+    chain_stats();
+
+    /**
+     * @brief forgets all blocks
+     *
+     * The stats will then describe an empty chain.
+     */
+    void clear();
+
+    /**
+     * @brief rebuilds the stats from the top blocks in the db
+     *
+     * @param db the db to read from
+     */
+    void load(const BlockchainDB &db);
+
+    /**
+     * @brief adds a new top block
+     *
+     * @param timestamp the block's timestamp
+     * @param cumulative_difficulty the block's cumulative difficulty
+     * @param block_size the block's size
+     */
+    void push(uint64_t timestamp, difficulty_type cumulative_difficulty, size_t block_size);
+
+    /**
+     * @brief removes the top block
+     *
+     * This must be called after the block was removed from the db, as the
+     * block which comes back into the window is read from it.
+     *
+     * @param db the db to read from
+     */
+    void pop(const BlockchainDB &db);
+
+    /**
+     * @brief gets the height of the chain the stats describe
+     */
+    uint64_t height() const { return m_height; }
+
+    /**
+     * @brief gets the timestamps and cumulative difficulties of the blocks
+     * used to compute the next block's difficulty
+     *
+     * This is the last DIFFICULTY_BLOCKS_COUNT blocks, genesis excluded.
+     */
+    void get_difficulty_window(std::vector<uint64_t> &timestamps, std::vector<difficulty_type> &cumulative_difficulties) const;
+
+    /**
+     * @brief gets the timestamps and cumulative difficulties of a range of blocks
+     *
+     * @param start_height the height of the first block
+     * @param end_height the height after the last block
+     * @param timestamps return-by-reference the timestamps
+     * @param cumulative_difficulties return-by-reference the cumulative difficulties
+     *
+     * @return false if the stats do not hold all of the blocks, true otherwise
+     */
+    bool get_blocks(uint64_t start_height, uint64_t end_height, std::vector<uint64_t> &timestamps, std::vector<difficulty_type> &cumulative_difficulties) const;
+
+    /**
+     * @brief gets the sizes of the last blocks, oldest first
+     *
+     * @param sizes return-by-reference the block sizes
+     * @param count the number of blocks
+     *
+     * @return false if more blocks were asked for than the stats hold
+     */
+    bool get_block_sizes(std::vector<size_t> &sizes, size_t count) const;
+
+    /**
+     * @brief gets the median size of the last CRYPTONOTE_REWARD_BLOCKS_WINDOW blocks
+     */
+    size_t get_median_block_size() const { return m_sizes.median(); }
+
+    /**
+     * @brief gets the median timestamp of the last BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW blocks
+     *
+     * @param median return-by-reference the median timestamp
+     *
+     * @return false if the chain is shorter than the window, true otherwise
+     */
+    bool get_median_timestamp(uint64_t &median) const;
+
+    /**
+     * @brief gets the next block's difficulty, if it was computed since the
+     * top block last changed
+     *
+     * @param target the difficulty target the value was computed for
+     * @param difficulty return-by-reference the difficulty
+     *
+     * @return true if found, false otherwise
+     */
+    bool get_next_difficulty(size_t target, difficulty_type &difficulty) const;
+
+    /**
+     * @brief remembers the next block's difficulty until the top block changes
+     */
+    void set_next_difficulty(size_t target, difficulty_type difficulty);
+
+  private:
+    struct block_stats
+    {
+      uint64_t timestamp;
+      difficulty_type cumulative_difficulty;
+      size_t block_size;
+    };
+
+    void push_front(const block_stats &stats);
+
+    boost::circular_buffer<block_stats> m_blocks;
+    uint64_t m_height;
+
+    rolling_median<uint64_t> m_timestamps;
+    rolling_median<size_t> m_sizes;
+
+    size_t m_next_difficulty_target;
+    difficulty_type m_next_difficulty;
+  };
+}
@@ -31,14 +31,106 @@
 #pragma once
 #include <unordered_set>
 #include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include "net/net_utils_base.h"
 #include "copyable_atomic.h"
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
 
 namespace cryptonote
 {
 
+  //latency and speed of block downloads from one peer, used to decide how
+  //many blocks to ask for at once and how many requests to keep in flight
+  struct block_download_stats
+  {
+    typedef std::chrono::steady_clock clock;
+
+    block_download_stats(): rtt(0), speed(0), response_size(0), block_size(0), bytes(0), blocks(0), responses(0), busy_time(0), last_response_blocks(0) {}
+
+    //called for each response, in the order the requests were sent
+    void on_response(size_t size, size_t block_count, clock::time_point sent, clock::time_point now)
+    {
+      //responses arrive in order, so this request had the link to itself
+      //only from the moment the previous response was in
+      const bool pipelined = responses && sent < last_response;
+      const clock::time_point busy_since = pipelined ? last_response : sent;
+      const uint64_t interval = std::max<uint64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(now - busy_since).count());
+      if(!pipelined)
+      {
+        //nothing was queued ahead of it: a clean round trip sample
+        const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(now - sent).count();
+        rtt = responses ? (rtt * 3 + latency) / 4 : latency;
+      }
+      const double sample_speed = size * 1000000.0 / interval;
+      speed = responses ? (speed * 3 + sample_speed) / 4 : sample_speed;
+      response_size = responses ? (response_size * 3 + size) / 4 : size;
+      if(block_count)
+      {
+        const double sample_block_size = size / (double)block_count;
+        block_size = blocks ? (block_size * 3 + sample_block_size) / 4 : sample_block_size;
+      }
+      last_response = now;
+      last_response_blocks = block_count;
+      bytes += size;
+      blocks += block_count;
+      busy_time += interval;
+      ++responses;
+    }
+
+    //blocks to ask for next, so that the response takes about
+    //BLOCKS_SYNCHRONIZING_TARGET_TIME at the peer's current speed
+    size_t get_request_size() const
+    {
+      if(!responses || !blocks)
+        return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+      const double target_bytes = std::min<double>(BLOCKS_SYNCHRONIZING_MAX_BYTES, speed * BLOCKS_SYNCHRONIZING_TARGET_TIME);
+      size_t count = target_bytes / std::max(1.0, block_size);
+      //blocks get bigger along the chain, so grow from what is known to work
+      //rather than trusting the size of the blocks seen so far
+      count = std::min<size_t>(count, std::max<size_t>(2 * last_response_blocks, BLOCKS_SYNCHRONIZING_DEFAULT_COUNT));
+      return std::max<size_t>(1, std::min<size_t>(count, BLOCKS_SYNCHRONIZING_MAX_COUNT));
+    }
+
+    //bytes per second over all the time spent receiving blocks
+    double get_average_speed() const
+    {
+      return busy_time ? bytes * 1000000.0 / busy_time : 0;
+    }
+
+    //requests to keep in flight: enough to cover a round trip at the current
+    //speed, plus the one being received
+    size_t get_window(size_t max_window) const
+    {
+      if(!responses || !response_size)
+        return 1;
+      const double in_flight = speed * rtt / 1000000.0 / response_size;
+      return std::max<size_t>(1, std::min<size_t>(max_window, 1 + std::ceil(in_flight)));
+    }
+
+    uint64_t rtt;            //microseconds
+    double speed;            //bytes per second, recent responses
+    double response_size;
+    double block_size;
+    uint64_t bytes;
+    uint64_t blocks;
+    uint64_t responses;
+    uint64_t busy_time;      //microseconds
+    size_t last_response_blocks;
+    clock::time_point last_response;
+  };
+
   struct cryptonote_connection_context: public epee::net_utils::connection_context_base
   {
+    //a NOTIFY_REQUEST_GET_OBJECTS waiting for its response
+    struct objects_request
+    {
+      std::unordered_set<crypto::hash> blocks;
+      block_download_stats::clock::time_point sent;
+    };
 
     enum state
     {
@@ -50,7 +142,9 @@ namespace cryptonote
 
     state m_state;
     std::list<crypto::hash> m_needed_objects;
-    std::unordered_set<crypto::hash> m_requested_objects;
+    std::deque<objects_request> m_requested_objects; //in the order they were sent
+    size_t m_abandoned_requests = 0; //still in flight, their responses are ignored
+    block_download_stats m_download_stats;
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
@@ -143,6 +143,8 @@ namespace cryptonote
     command_line::add_arg(desc, command_line::arg_prep_blocks_threads);
     command_line::add_arg(desc, command_line::arg_fast_block_sync);
     command_line::add_arg(desc, command_line::arg_db_sync_mode);
+    command_line::add_arg(desc, command_line::arg_db_cache_size);
+    command_line::add_arg(desc, command_line::arg_ring_member_cache_size);
     command_line::add_arg(desc, command_line::arg_show_time_stats);
     command_line::add_arg(desc, command_line::arg_db_auto_remove_logs);
   }
@@ -260,6 +262,7 @@ namespace cryptonote
 #if BLOCKCHAIN_DB == DB_LMDB
     std::string db_type = command_line::get_arg(vm, command_line::arg_db_type);
     std::string db_sync_mode = command_line::get_arg(vm, command_line::arg_db_sync_mode);
+    std::string db_cache_size = command_line::get_arg(vm, command_line::arg_db_cache_size);
     bool fast_sync = command_line::get_arg(vm, command_line::arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, command_line::arg_prep_blocks_threads);
 
@@ -382,6 +385,19 @@ namespace cryptonote
           blocks_per_sync = 1;
       }
 
+      // blocks:txs:outputs, in MB
+      uint64_t cache_sizes[3] = {16, 32, 16};
+      options.clear();
+      boost::trim(db_cache_size);
+      boost::split(options, db_cache_size, boost::is_any_of(" :"));
+      for (size_t n = 0; n < options.size() && n < 3; ++n)
+      {
+        if (!options[n].empty())
+          cache_sizes[n] = atoll(options[n].c_str());
+      }
+      LOG_PRINT_L1("DB cache sizes: blocks " << cache_sizes[0] << " MB, txs " << cache_sizes[1] << " MB, outputs " << cache_sizes[2] << " MB");
+      db->set_cache_limits(cache_sizes[0] << 20, cache_sizes[1] << 20, cache_sizes[2] << 20);
+
       bool auto_remove_logs = command_line::get_arg(vm, command_line::arg_db_auto_remove_logs) != 0;
       db->set_auto_remove_logs(auto_remove_logs);
       db->open(filename, db_flags);
@@ -405,6 +421,10 @@ namespace cryptonote
 
     bool show_time_stats = command_line::get_arg(vm, command_line::arg_show_time_stats) != 0;
     m_blockchain_storage.set_show_time_stats(show_time_stats);
+
+    uint64_t ring_member_cache_size = command_line::get_arg(vm, command_line::arg_ring_member_cache_size);
+    LOG_PRINT_L1("Ring member cache size: " << ring_member_cache_size << " MB");
+    m_blockchain_storage.set_ring_member_cache_limit(ring_member_cache_size << 20);
 #else
     r = m_blockchain_storage.init(m_config_folder, m_testnet);
 #endif
@@ -601,12 +621,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
   {
-    spent.clear();
-    BOOST_FOREACH(auto& ki, key_im)
-    {
-      spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
-    }
-    return true;
+    return m_blockchain_storage.are_key_images_spent(key_im, spent);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::check_tx_inputs_keyimages_diff(const transaction& tx) const
@@ -684,7 +699,7 @@ namespace cryptonote
     return m_blockchain_storage.find_blockchain_supplement(qblock_ids, resp);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
+  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<block, std::vector<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
   {
     return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, max_count);
   }
@@ -778,7 +793,7 @@ namespace cryptonote
   }
 
   //-----------------------------------------------------------------------------------------------
-  bool core::prepare_handle_incoming_blocks(const std::list<block_complete_entry> &blocks)
+  bool core::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks)
   {
 #if BLOCKCHAIN_DB == DB_LMDB
     m_blockchain_storage.prepare_handle_incoming_blocks(blocks);
@@ -866,6 +881,11 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  void core::get_pool_transactions_delta(uint64_t since_version, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, bool& full, uint64_t& version, std::vector<blobdata>* blobs) const
+  {
+    m_mempool.get_transactions_delta(since_version, added, removed, full, version, blobs);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_pool_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos) const
   {
     return m_mempool.get_transactions_and_spent_keys_info(tx_infos, key_image_infos);
@@ -720,11 +720,23 @@ namespace cryptonote
   {
     crypto::key_derivation derivation;
     generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation);
+    return is_out_to_acc(acc, out_key, derivation, output_index);
+  }
+  //---------------------------------------------------------------
+  bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::key_derivation& derivation, size_t output_index)
+  {
     crypto::public_key pk;
     derive_public_key(derivation, output_index, acc.m_account_address.m_spend_public_key, pk);
     return pk == out_key.key;
   }
   //---------------------------------------------------------------
+  bool is_out_to_acc(const crypto::public_key_precomp& spend_public_key, const txout_to_key& out_key, const crypto::key_derivation& derivation, size_t output_index)
+  {
+    crypto::public_key pk;
+    derive_public_key(derivation, output_index, spend_public_key, pk);
+    return pk == out_key.key;
+  }
+  //---------------------------------------------------------------
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
@@ -734,13 +746,27 @@ namespace cryptonote
   }
   //---------------------------------------------------------------
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered)
+  {
+    crypto::key_derivation derivation;
+    generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation);
+    return lookup_acc_outs(acc, tx, derivation, outs, money_transfered);
+  }
+  //---------------------------------------------------------------
+  bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::key_derivation& derivation, std::vector<size_t>& outs, uint64_t& money_transfered)
+  {
+    crypto::public_key_precomp spend_public_key;
+    CHECK_AND_ASSERT_MES(precompute_public_key(acc.m_account_address.m_spend_public_key, spend_public_key), false, "invalid spend public key");
+    return lookup_acc_outs(spend_public_key, tx, derivation, outs, money_transfered);
+  }
+  //---------------------------------------------------------------
+  bool lookup_acc_outs(const crypto::public_key_precomp& spend_public_key, const transaction& tx, const crypto::key_derivation& derivation, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     money_transfered = 0;
     size_t i = 0;
     BOOST_FOREACH(const tx_out& o,  tx.vout)
     {
       CHECK_AND_ASSERT_MES(o.target.type() ==  typeid(txout_to_key), false, "wrong type id in transaction out" );
-      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+      if(is_out_to_acc(spend_public_key, boost::get<txout_to_key>(o.target), derivation, i))
       {
         outs.push_back(i);
         money_transfered += o.amount;
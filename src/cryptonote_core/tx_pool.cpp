@@ -74,6 +74,47 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  pool_change_log::pool_change_log(size_t max_changes): m_max_changes(max_changes)
+  {
+    // start from a time based version so versions handed out by a previous
+    // run are never mistaken for ones from this run
+    m_version = m_floor = ((uint64_t)time(NULL)) << 20;
+  }
+  //---------------------------------------------------------------------------------
+  void pool_change_log::record(const crypto::hash& id, bool added)
+  {
+    m_changes.push_back({++m_version, id, added});
+    while (m_changes.size() > m_max_changes)
+    {
+      m_floor = m_changes.front().version;
+      m_changes.pop_front();
+    }
+  }
+  //---------------------------------------------------------------------------------
+  bool pool_change_log::get_changes(uint64_t since_version, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed) const
+  {
+    added.clear();
+    removed.clear();
+    if (since_version < m_floor || since_version > m_version)
+      return false;
+
+    // a transaction may come and go several times within the window, only
+    // its last state matters
+    std::unordered_map<crypto::hash, bool> last_change;
+    auto it = std::upper_bound(m_changes.begin(), m_changes.end(), since_version,
+        [](uint64_t v, const change& c) { return v < c.version; });
+    for (; it != m_changes.end(); ++it)
+      last_change[it->id] = it->added;
+    for (const auto& change : last_change)
+    {
+      if (change.second)
+        added.push_back(change.first);
+      else
+        removed.push_back(change.first);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
 #if BLOCKCHAIN_DB == DB_LMDB
   //---------------------------------------------------------------------------------
   tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs)
@@ -192,6 +233,7 @@ namespace cryptonote
         txd_p.first->second.receive_time = time(nullptr);
         txd_p.first->second.last_relayed_time = time(NULL);
         txd_p.first->second.relayed = relayed;
+        m_changes.record(id, true);
         tvc.m_verifivation_impossible = true;
         tvc.m_added_to_pool = true;
       }else
@@ -216,6 +258,7 @@ namespace cryptonote
       txd_p.first->second.receive_time = time(nullptr);
       txd_p.first->second.last_relayed_time = time(NULL);
       txd_p.first->second.relayed = relayed;
+      m_changes.record(id, true);
       tvc.m_added_to_pool = true;
 
       if(txd_p.first->second.fee > 0)
@@ -301,6 +344,7 @@ namespace cryptonote
     fee = it->second.fee;
     relayed = it->second.relayed;
     remove_transaction_keyimages(it->second.tx);
+    m_changes.record(id, false);
     m_transactions.erase(it);
     m_txs_by_fee.erase(sorted_it);
     return true;
@@ -343,6 +387,7 @@ namespace cryptonote
           m_txs_by_fee.erase(sorted_it);
         }
         m_timed_out_transactions.insert(it->first);
+        m_changes.record(it->first, false);
         auto pit = it++;
         m_transactions.erase(pit);
       }else
@@ -399,6 +444,41 @@ namespace cryptonote
     BOOST_FOREACH(const auto& tx_vt, m_transactions)
       txs.push_back(tx_vt.second.tx);
   }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_transactions_delta(uint64_t since_version, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, bool& full, uint64_t& version, std::vector<blobdata>* blobs) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    added.clear();
+    removed.clear();
+    if (blobs)
+      blobs->clear();
+    version = m_changes.version();
+
+    full = !m_changes.get_changes(since_version, added, removed);
+    if (full)
+    {
+      added.reserve(m_transactions.size());
+      for (const auto& tx_vt : m_transactions)
+        added.push_back(tx_vt.first);
+    }
+
+    if (blobs)
+    {
+      blobs->reserve(added.size());
+      for (const auto& id : added)
+      {
+        // an empty blob tells the caller to fetch the transaction separately
+        auto i = m_transactions.find(id);
+        if (i == m_transactions.end())
+        {
+          LOG_ERROR("Transaction " << id << " is in the pool change log but not in the pool");
+          blobs->push_back(blobdata());
+          continue;
+        }
+        blobs->push_back(tx_to_blob(i->second.tx));
+      }
+    }
+  }
   //------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::get_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos) const
@@ -664,6 +744,7 @@ namespace cryptonote
         {
           m_txs_by_fee.erase(sorted_it);
         }
+        m_changes.record(it->first, false);
         auto pit = it++;
         m_transactions.erase(pit);
         ++n_removed;
@@ -35,6 +35,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <deque>
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
 
@@ -73,6 +74,66 @@ namespace cryptonote
     }
   };
 
+  /**
+   * @brief A bounded log of the transactions added to and removed from the pool
+   *
+   * Every change bumps the version.  A client which remembers the version it
+   * last saw can be told what changed since, as long as the log still goes
+   * back that far.  Versions start from the time the log was created, so a
+   * version handed out by a previous run of the daemon is never mistaken for
+   * one from this run.  Not thread safe, the pool locks around it.
+   */
+  class pool_change_log
+  {
+  public:
+    /**
+     * @brief constructor
+     *
+     * @param max_changes how many changes to remember
+     */
+    pool_change_log(size_t max_changes = 10000);
+
+    /**
+     * @brief record a transaction entering or leaving the pool
+     *
+     * @param id the hash of the transaction
+     * @param added true if the transaction was added, false if removed
+     */
+    void record(const crypto::hash& id, bool added);
+
+    /**
+     * @brief get the transactions added and removed since a given version
+     *
+     * A transaction which came and went several times since then is only
+     * reported in its last state.
+     *
+     * @param since_version the version the caller last saw
+     * @param added return-by-reference hashes of transactions added since then
+     * @param removed return-by-reference hashes of transactions removed since then
+     *
+     * @return false if the log does not cover since_version, the caller
+     *         then needs the whole pool
+     */
+    bool get_changes(uint64_t since_version, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed) const;
+
+    //! the version after the latest change
+    uint64_t version() const { return m_version; }
+
+  private:
+    //! a single entry in the log
+    struct change
+    {
+      uint64_t version;  //!< the version this change produced
+      crypto::hash id;  //!< the transaction added or removed
+      bool added;  //!< whether the transaction was added or removed
+    };
+
+    size_t m_max_changes;  //!< how many changes to remember
+    uint64_t m_version;  //!< bumped on every change
+    uint64_t m_floor;  //!< the newest version no longer covered by m_changes
+    std::deque<change> m_changes;  //!< recent changes, oldest first
+  };
+
   //! container for sorting transactions by fee per unit size
   typedef std::set<tx_by_fee_entry, txCompare> sorted_tx_container;
 
@@ -236,6 +297,25 @@ namespace cryptonote
      */
     void get_transactions(std::list<transaction>& txs) const;
 
+    /**
+     * @brief get the transactions added to and removed from the pool since a given version
+     *
+     * Every change to the set of pooled transactions bumps the pool version
+     * and is recorded in a bounded log, so a client which remembers the
+     * version it last saw only needs to fetch what changed since.  If the
+     * version given is not covered by the log (too old, from a previous run
+     * of the daemon, or zero), the whole pool is returned instead and full
+     * is set.
+     *
+     * @param since_version the pool version the caller last saw
+     * @param added return-by-reference hashes of transactions added since then
+     * @param removed return-by-reference hashes of transactions removed since then
+     * @param full return-by-reference whether added holds the whole pool
+     * @param version return-by-reference the current pool version
+     * @param blobs if not NULL, return-by-reference the blobs of the added transactions still in the pool
+     */
+    void get_transactions_delta(uint64_t since_version, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, bool& full, uint64_t& version, std::vector<blobdata>* blobs = NULL) const;
+
     /**
      * @brief get information about all transactions and key images in the pool
      *
@@ -469,6 +549,8 @@ namespace cryptonote
     //! container for spent key images from the transactions in the pool
     key_images_container m_spent_key_images;  
 
+    pool_change_log m_changes;  //!< recent transactions added to and removed from the pool
+
     //TODO: this time should be a named constant somewhere, not hard-coded
     //! interval on which to check for stale/"stuck" transactions
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
@@ -31,6 +31,7 @@
 #pragma once
 
 #include <list>
+#include <vector>
 #include "serialization/keyvalue_serialization.h"
 #include "cryptonote_core/cryptonote_basic.h"
 #include "cryptonote_protocol/blobdatatype.h"
@@ -70,6 +71,13 @@ namespace cryptonote
 	uint64_t avg_upload;
 	uint64_t current_upload;
 
+    // blocks downloaded from this peer while syncing, kB/s and ms
+    uint64_t sync_avg_download;
+    uint64_t sync_current_download;
+    uint64_t sync_rtt;
+    uint64_t sync_request_size;
+    uint64_t sync_requests_in_flight;
+
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(incoming)
       KV_SERIALIZE(localhost)
@@ -87,6 +95,11 @@ namespace cryptonote
       KV_SERIALIZE(current_download)
       KV_SERIALIZE(avg_upload)
       KV_SERIALIZE(current_upload)
+      KV_SERIALIZE(sync_avg_download)
+      KV_SERIALIZE(sync_current_download)
+      KV_SERIALIZE(sync_rtt)
+      KV_SERIALIZE(sync_request_size)
+      KV_SERIALIZE(sync_requests_in_flight)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -96,7 +109,7 @@ namespace cryptonote
   struct block_complete_entry
   {
     blobdata block;
-    std::list<blobdata> txs;
+    std::vector<blobdata> txs;
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(block)
       KV_SERIALIZE(txs)
@@ -166,9 +179,9 @@ namespace cryptonote
 
     struct request
     {
-      std::list<blobdata>              txs;
-      std::list<block_complete_entry>  blocks;
-      std::list<crypto::hash>               missed_ids;
+      std::vector<blobdata>              txs;
+      std::vector<block_complete_entry>  blocks;
+      std::vector<crypto::hash>          missed_ids;
       uint64_t                         current_blockchain_height;
 
       BEGIN_KV_SERIALIZE_MAP()
@@ -214,7 +227,7 @@ namespace cryptonote
     {
       uint64_t start_height;
       uint64_t total_height;
-      std::list<crypto::hash> m_block_ids;
+      std::vector<crypto::hash> m_block_ids;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(start_height)
@@ -65,7 +65,6 @@ namespace cryptonote
 			cryptonote_protocol_handler_base();
 			virtual ~cryptonote_protocol_handler_base();
 			void handler_request_blocks_history(std::list<crypto::hash>& ids); // before asking for list of objects, we can change the list still
-			void handler_response_blocks_now(size_t packet_size);
 			
 			virtual double get_avg_block_size() = 0;
 			virtual double estimate_one_block_size() noexcept; // for estimating size of blocks to download
@@ -144,7 +143,6 @@ namespace cryptonote
         LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] post " << typeid(t_parametr).name() << " -->");
         std::string blob;
         epee::serialization::store_t_to_binary(arg, blob);
-        //handler_response_blocks_now(blob.size()); // XXX
         return m_p2p->invoke_notify_to_peer(t_parametr::ID, blob, context);
       }
 
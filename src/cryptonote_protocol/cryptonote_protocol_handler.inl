@@ -246,6 +246,13 @@ namespace cryptonote
       cnx.current_download = cntxt.m_current_speed_down / 1024;
       cnx.current_upload = cntxt.m_current_speed_up / 1024;
 
+      const block_download_stats& sync_stats = cntxt.m_download_stats;
+      cnx.sync_avg_download = sync_stats.get_average_speed() / 1024;
+      cnx.sync_current_download = sync_stats.speed / 1024;
+      cnx.sync_rtt = sync_stats.rtt / 1000;
+      cnx.sync_request_size = sync_stats.get_request_size();
+      cnx.sync_requests_in_flight = cntxt.m_requested_objects.size();
+
       connections.push_back(cnx);
 
       return true;
@@ -315,8 +322,7 @@ namespace cryptonote
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
     m_core.pause_mine();
-    std::list<block_complete_entry> blocks;
-    blocks.push_back(arg.b);
+    std::vector<block_complete_entry> blocks(1, arg.b);
     m_core.prepare_handle_incoming_blocks(blocks);
     for(auto tx_blob_it = arg.b.txs.begin(); tx_blob_it!=arg.b.txs.end();tx_blob_it++)
     {
@@ -404,8 +410,6 @@ namespace cryptonote
     LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()=" << rsp.blocks.size() << ", txs.size()=" << rsp.txs.size()
                             << ", rsp.m_current_blockchain_height=" << rsp.current_blockchain_height << ", missed_ids.size()=" << rsp.missed_ids.size());
     post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
-    //handler_response_blocks_now(sizeof(rsp)); // XXX
-    //handler_response_blocks_now(200);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -436,18 +440,24 @@ namespace cryptonote
   {
     LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_GET_OBJECTS");
 
+    if(context.m_abandoned_requests)
+    {
+      --context.m_abandoned_requests;
+      LOG_PRINT_CCONTEXT_L2("Ignoring response to a request made before going idle");
+      return 1;
+    }
+
     // calculate size of request - mainly for logging/debug
     size_t size = 0;
-    for (auto element : arg.txs) size += element.size();
+    for (const auto &element : arg.txs) size += element.size();
 
-    for (auto element : arg.blocks) {
+    for (const auto &element : arg.blocks) {
       size += element.block.size();
-      for (auto tx : element.txs)
+      for (const auto &tx : element.txs)
         size += tx.size();
     }
 
-    for (auto element : arg.missed_ids)
-      size += sizeof(element.data);
+    size += arg.missed_ids.size() * sizeof(crypto::hash);
 
     size += sizeof(arg.current_blockchain_height);
     {
@@ -466,8 +476,6 @@ namespace cryptonote
       auto time_from_epoh = point.time_since_epoch();
       auto sec = duration_cast< seconds >( time_from_epoh ).count();*/
 
-    //epee::net_utils::network_throttle_manager::get_global_throttle_inreq().logger_handle_net("log/dr-monero/net/req-all.data", sec, get_avg_block_size());
-
     if(context.m_last_response_height > arg.current_blockchain_height)
     {
       LOG_ERROR_CCONTEXT("sent wrong NOTIFY_HAVE_OBJECTS: arg.m_current_blockchain_height=" << arg.current_blockchain_height
@@ -478,6 +486,15 @@ namespace cryptonote
 
     context.m_remote_blockchain_height = arg.current_blockchain_height;
 
+    if(context.m_requested_objects.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent NOTIFY_RESPONSE_GET_OBJECTS without a request, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+    //requests are answered in the order they were sent
+    std::unordered_set<crypto::hash>& requested = context.m_requested_objects.front().blocks;
+
     size_t count = 0;
     BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
     {
@@ -497,14 +514,15 @@ namespace cryptonote
         {
           context.m_state = cryptonote_connection_context::state_idle;
           context.m_needed_objects.clear();
+          context.m_abandoned_requests += context.m_requested_objects.size() - 1;
           context.m_requested_objects.clear();
           LOG_PRINT_CCONTEXT_L1("Connection set to idle state.");
           return 1;
         }
       }
 
-      auto req_it = context.m_requested_objects.find(get_block_hash(b));
-      if(req_it == context.m_requested_objects.end())
+      auto req_it = requested.find(get_block_hash(b));
+      if(req_it == requested.end())
       {
         LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << epee::string_tools::pod_to_hex(get_blob_hash(block_entry.block))
           << " wasn't requested, dropping connection");
@@ -519,17 +537,20 @@ namespace cryptonote
         return 1;
       }
 
-      context.m_requested_objects.erase(req_it);
+      requested.erase(req_it);
     }
 
-    if(context.m_requested_objects.size())
+    if(requested.size())
     {
-      LOG_PRINT_CCONTEXT_RED("returned not all requested objects (context.m_requested_objects.size()="
-        << context.m_requested_objects.size() << "), dropping connection", LOG_LEVEL_0);
+      LOG_PRINT_CCONTEXT_RED("returned not all requested objects (requested.size()="
+        << requested.size() << "), dropping connection", LOG_LEVEL_0);
       m_p2p->drop_connection(context);
       return 1;
     }
 
+    context.m_download_stats.on_response(size, arg.blocks.size(), context.m_requested_objects.front().sent, block_download_stats::clock::now());
+    context.m_requested_objects.pop_front();
+
 
     {
       m_core.pause_mine();
@@ -640,31 +661,43 @@ namespace cryptonote
       auto time_from_epoh = point.time_since_epoch();
       auto sec = duration_cast< seconds >( time_from_epoh ).count();*/
 
-    if(context.m_needed_objects.size())
+    //keep enough requests in flight for the peer to always have one to answer
+    //while earlier responses are on the wire or being added to the chain
+    const size_t window = context.m_download_stats.get_window(BLOCKS_SYNCHRONIZING_MAX_REQUESTS);
+    while(context.m_needed_objects.size() && context.m_requested_objects.size() < window)
     {
       //we know objects that we need, request this objects
       NOTIFY_REQUEST_GET_OBJECTS::request req;
+      cryptonote_connection_context::objects_request pending;
       size_t count = 0;
       auto it = context.m_needed_objects.begin();
 
-      size_t count_limit = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+      const size_t count_limit = context.m_download_stats.get_request_size();
       _note_c("net/req-calc" , "Setting count_limit: " << count_limit);
-      while(it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+      while(it != context.m_needed_objects.end() && count < count_limit)
       {
         if( !(check_having_blocks && m_core.have_block(*it)))
         {
           req.blocks.push_back(*it);
           ++count;
-          context.m_requested_objects.insert(*it);
+          pending.blocks.insert(*it);
         }
         context.m_needed_objects.erase(it++);
       }
+      if(req.blocks.empty())
+        continue;
       LOG_PRINT_CCONTEXT_L1("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size()
-          << "requested blocks count=" << count << " / " << count_limit);
-      //epee::net_utils::network_throttle_manager::get_global_throttle_inreq().logger_handle_net("log/dr-monero/net/req-all.data", sec, get_avg_block_size());
-
+          << "requested blocks count=" << count << " / " << count_limit << ", in flight " << context.m_requested_objects.size() + 1 << " / " << window);
+      pending.sent = block_download_stats::clock::now();
+      context.m_requested_objects.push_back(std::move(pending));
       post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);
-    }else if(context.m_last_response_height < context.m_remote_blockchain_height-1)
+    }
+
+    //the chain is only asked for again, or the sync declared done, once all responses are in
+    if(context.m_requested_objects.size())
+      return true;
+
+    if(context.m_last_response_height < context.m_remote_blockchain_height-1)
     {//we have to fetch more objects ids, request blockchain entry
 
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
@@ -673,7 +706,6 @@ namespace cryptonote
 
       //std::string blob; // for calculate size of request
       //epee::serialization::store_t_to_binary(r, blob);
-      //epee::net_utils::network_throttle_manager::get_global_throttle_inreq().logger_handle_net("log/dr-monero/net/req-all.data", sec, get_avg_block_size());
       LOG_PRINT_CCONTEXT_L1("r = " << 200);
 
       LOG_PRINT_CCONTEXT_L1("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
@@ -400,6 +400,9 @@ bool t_rpc_command_executor::print_connections() {
       << std::setw(14) << "Down(now)"
       << std::setw(10) << "Up (kB/s)" 
       << std::setw(13) << "Up(now)"
+      << std::setw(22) << "Sync now/avg (kB/s)"
+      << std::setw(10) << "RTT(ms)"
+      << std::setw(14) << "Blocks/req"
       << std::endl;
 
   for (auto & info : res.connections)
@@ -418,6 +421,9 @@ bool t_rpc_command_executor::print_connections() {
      << std::setw(14) << info.current_download
      << std::setw(10) << info.avg_upload
      << std::setw(13) << info.current_upload
+     << std::setw(22) << std::to_string(info.sync_current_download) + "/" + std::to_string(info.sync_avg_download)
+     << std::setw(10) << info.sync_rtt
+     << std::setw(14) << std::to_string(info.sync_request_size) + " x" + std::to_string(info.sync_requests_in_flight)
      
      << std::left << (info.localhost ? "[LOCALHOST]" : "")
      << std::left << (info.local_ip ? "[LAN]" : "");
@@ -114,6 +114,8 @@ class connection_basic_pimpl {
 		connection_basic_pimpl(const std::string &name);
 
 		static int m_default_tos;
+		static network_token_bucket m_bucket_out; // global upload limit
+		static network_token_bucket m_bucket_in; // global download limit
 
 		network_throttle_bw m_throttle; // per-perr
     critical_section m_throttle_lock;
@@ -146,13 +148,21 @@ connection_basic_pimpl::connection_basic_pimpl(const std::string &name) : m_thro
 
 // static variables:
 int connection_basic_pimpl::m_default_tos;
+network_token_bucket connection_basic_pimpl::m_bucket_out;
+network_token_bucket connection_basic_pimpl::m_bucket_in;
 
 // methods:
 connection_basic::connection_basic(boost::asio::io_service& io_service, std::atomic<long> &ref_sock_count, std::atomic<long> &sock_number)
 	: 
 	mI( new connection_basic_pimpl("peer") ),
+	m_send_que_offset(0),
+	m_send_que_bytes(0),
+	m_write_started(0),
+	m_send_que_throttled(0),
 	strand_(io_service),
 	socket_(io_service),
+	m_send_timer(io_service),
+	m_recv_timer(io_service),
 	m_want_close_connection(false), 
 	m_was_shutdown(false),
 	m_ref_sock_count(ref_sock_count)
@@ -175,47 +185,21 @@ connection_basic::~connection_basic() noexcept(false) {
 }
 
 void connection_basic::set_rate_up_limit(uint64_t limit) {
-	
-	// TODO remove __SCALING_FACTOR...
-	const double SCALING_FACTOR = 2.1; // to acheve the best performance
-	limit *= SCALING_FACTOR;
-	{
-		CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().set_target_speed(limit);
-		network_throttle_manager::get_global_throttle_out().set_real_target_speed(limit / SCALING_FACTOR);
-	}
+	connection_basic_pimpl::m_bucket_out.set_rate(limit);
 	save_limit_to_file(limit);
 }
 
 void connection_basic::set_rate_down_limit(uint64_t limit) {
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
-		network_throttle_manager::get_global_throttle_in().set_target_speed(limit);
-	}
-
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_inreq );
-		network_throttle_manager::get_global_throttle_inreq().set_target_speed(limit);
-	}
-    save_limit_to_file(limit);
+	connection_basic_pimpl::m_bucket_in.set_rate(limit);
+	save_limit_to_file(limit);
 }
 
 uint64_t connection_basic::get_rate_up_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_out );
-         limit = network_throttle_manager::get_global_throttle_out().get_target_speed();
-	}
-    return limit;
+	return connection_basic_pimpl::m_bucket_out.get_rate();
 }
 
 uint64_t connection_basic::get_rate_down_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_in );
-         limit = network_throttle_manager::get_global_throttle_in().get_target_speed();
-	}
-    return limit;
+	return connection_basic_pimpl::m_bucket_in.get_rate();
 }
 
 void connection_basic::save_limit_to_file(int limit) {
@@ -223,15 +207,8 @@ void connection_basic::save_limit_to_file(int limit) {
     if (!epee::net_utils::data_logger::m_save_graph)
 		return;
 
-    {
-         CRITICAL_REGION_LOCAL(        network_throttle_manager::m_lock_get_global_throttle_out );
-               epee::net_utils::data_logger::get_instance().add_data("upload_limit", network_throttle_manager::get_global_throttle_out().get_target_speed() / 1024);
-	}
-	
-    {
-         CRITICAL_REGION_LOCAL(        network_throttle_manager::m_lock_get_global_throttle_in );
-               epee::net_utils::data_logger::get_instance().add_data("download_limit", network_throttle_manager::get_global_throttle_in().get_target_speed() / 1024);
-	}
+    epee::net_utils::data_logger::get_instance().add_data("upload_limit", get_rate_up_limit() / 1024);
+    epee::net_utils::data_logger::get_instance().add_data("download_limit", get_rate_down_limit() / 1024);
 }
  
 void connection_basic::set_tos_flag(int tos) {
@@ -242,53 +219,18 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size ); // decission from global
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			_info_c("net/sleep", "Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			_dbg1("sleep in sleep_before_packet");
-			epee::net_utils::data_logger::get_instance().add_data("sleep_up", ms);
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
-
-// XXX LATER XXX
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size * 700); // increase counter - global
-	}
-
-}
-void connection_basic::set_start_time() {
-	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-	m_start_time = network_throttle_manager::get_global_throttle_out().get_time_seconds();
-}
-
-void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
-	sleep_before_packet(cb,1,-1);
-	_info_c("net/out/size", "handler_write (direct) - before ASIO write, for packet="<<cb<<" B (after sleep)");
-	set_start_time();
+double connection_basic::reserve_send(size_t cb) {
+	double delay = connection_basic_pimpl::m_bucket_out.reserve(cb);
+	if (delay > 0)
+		epee::net_utils::data_logger::get_instance().add_data("sleep_up", (long int)(delay * 1000));
+	return delay;
 }
 
-void connection_basic::do_send_handler_write_from_queue( const boost::system::error_code& e, size_t cb, int q_len ) {
-	sleep_before_packet(cb,2,q_len);
-	_info_c("net/out/size", "handler_write (after write, from queue="<<q_len<<") - before ASIO write, for packet="<<cb<<" B (after sleep)");
-
-	set_start_time();
+double connection_basic::reserve_recv(size_t cb) {
+	double delay = connection_basic_pimpl::m_bucket_in.reserve(cb);
+	if (delay > 0)
+		epee::net_utils::data_logger::get_instance().add_data("sleep_down", (long int)(delay * 1000));
+	return delay;
 }
 
 void connection_basic::logger_handle_net_read(size_t size) { // network data read
@@ -301,12 +243,6 @@ void connection_basic::logger_handle_net_write(size_t size) {
     epee::net_utils::data_logger::get_instance().add_data("upload", size);	
 }
 
-double connection_basic::get_sleep_time(size_t cb) {
-	CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_out);
-    auto t = network_throttle_manager::get_global_throttle_out().get_sleep_time(cb);
-    return t;
-}
-
 void connection_basic::set_save_graph(bool save_graph) {
 	epee::net_utils::data_logger::m_save_graph = save_graph;
 }
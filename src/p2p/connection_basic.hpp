@@ -91,12 +91,18 @@ class connection_basic { // not-templated base class for rapid developmet of som
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
     std::list<std::string> m_send_que;
+    size_t m_send_que_offset; // bytes of m_send_que.front() already written
+    size_t m_send_que_bytes; // total size of the messages in m_send_que
+    time_t m_write_started; // when the write now on the socket was issued, 0 while none is (e.g. waiting on the rate limit)
+    size_t m_send_que_throttled; // bytes taken from the rate limit and waiting on m_send_timer
     volatile bool m_is_multithreaded;
-    double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
+    /// Timers deferring the next write/read while the rate limit is exhausted.
+    boost::asio::deadline_timer m_send_timer;
+    boost::asio::deadline_timer m_recv_timer;
 
 		std::atomic<long> &m_ref_sock_count; // reference to external counter of existing sockets that we will ++/--
 	public:
@@ -106,14 +112,9 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		virtual ~connection_basic() noexcept(false);
 
 		// various handlers to be called from connection class:
-		void do_send_handler_write(const void * ptr , size_t cb);
-		void do_send_handler_write_from_queue(const boost::system::error_code& e, size_t cb , int q_len); // from handle_write, sending next part
-
 		void logger_handle_net_write(size_t size); // network data written
 		void logger_handle_net_read(size_t size); // network data read
 
-		void set_start_time();
-
 		// config for rate limit
 		
 		static void set_rate_up_limit(uint64_t limit);
@@ -125,10 +126,10 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static void set_tos_flag(int tos); // ToS / QoS flag
 		static int get_tos_flag();
 
-		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		// rate limit: take cb bytes from the global token bucket, returns seconds to wait before moving them
+		static double reserve_send(size_t cb);
+		static double reserve_recv(size_t cb);
 		static void save_limit_to_file(int limit); ///< for dr-monero
-		static double get_sleep_time(size_t cb);
 		
 		static void set_save_graph(bool save_graph);
 };
@@ -377,6 +377,66 @@ double network_throttle::get_current_speed() const {
 	return bytes_transferred / ((m_history.size() - 1) * m_slot_size);
 }
 
+// ================================================================================================
+// network_token_bucket
+// ================================================================================================
+
+// how much unused bandwidth may be saved up, as time at the target rate
+static const network_time_seconds TOKEN_BUCKET_BURST_TIME = 0.1;
+
+network_token_bucket::network_token_bucket()
+	: m_rate(0), m_tokens(0), m_last_time(0), m_started(false)
+{
+}
+
+void network_token_bucket::set_rate(uint64_t bytes_per_second)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	m_rate = bytes_per_second;
+	m_tokens = std::min(m_tokens, m_rate * TOKEN_BUCKET_BURST_TIME);
+}
+
+uint64_t network_token_bucket::get_rate() const
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	return m_rate;
+}
+
+network_time_seconds network_token_bucket::reserve(size_t bytes)
+{
+	return reserve(bytes, get_time_seconds());
+}
+
+network_time_seconds network_token_bucket::reserve(size_t bytes, network_time_seconds now)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	if (!m_rate)
+		return 0;
+
+	const double burst = m_rate * TOKEN_BUCKET_BURST_TIME;
+	if (!m_started)
+	{
+		m_tokens = burst;
+		m_started = true;
+	}
+	else if (now > m_last_time)
+	{
+		m_tokens = std::min(burst, m_tokens + (now - m_last_time) * m_rate);
+	}
+	m_last_time = std::max(m_last_time, now);
+
+	m_tokens -= bytes;
+	if (m_tokens >= 0)
+		return 0;
+	return -m_tokens / m_rate;
+}
+
+network_time_seconds network_token_bucket::get_time_seconds()
+{
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return us / 1000000.;
+}
+
 } // namespace
 } // namespace
 
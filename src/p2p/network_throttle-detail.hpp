@@ -119,6 +119,32 @@ struct network_throttle_bw {
 		network_throttle_bw(const std::string &name1);
 };
 
+/***
+ * Token bucket shared by all connections for one direction of traffic.
+ * A caller reserves the bytes it is about to move and gets back how long to wait before moving them.
+ * The bucket may go into debt, so reservations made while it is empty line up behind each other
+ * and peers take turns instead of one of them using up the whole budget. Never sleeps.
+*/
+class network_token_bucket {
+	public:
+		network_token_bucket();
+
+		void set_rate(uint64_t bytes_per_second); ///< 0 means unlimited
+		uint64_t get_rate() const;
+
+		network_time_seconds reserve(size_t bytes); ///< take bytes from the bucket, returns the delay before they may be sent
+		network_time_seconds reserve(size_t bytes, network_time_seconds now); ///< ditto, at a given time (monotonic, in seconds)
+
+		static network_time_seconds get_time_seconds(); ///< monotonic clock used by reserve(bytes)
+
+	private:
+		mutable boost::mutex m_lock;
+		uint64_t m_rate; ///< bytes per second, 0 for unlimited
+		double m_tokens; ///< bytes that may be sent right now; negative while reservations are waiting
+		network_time_seconds m_last_time; ///< when m_tokens was last refilled
+		bool m_started;
+};
+
 
 
 } // namespace net_utils
@@ -61,48 +61,6 @@ namespace epee
 namespace net_utils
 {
 
-// ================================================================================================
-// network_throttle_manager
-// ================================================================================================
-
-// ================================================================================================
-// static:
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_in;
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_inreq;
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_out;
-
-int network_throttle_manager::xxx;
-
-
-// ================================================================================================
-// methods:
-i_network_throttle & network_throttle_manager::get_global_throttle_in() { 
-	boost::call_once(m_once_get_global_throttle_in, [] { m_obj_get_global_throttle_in.reset(new network_throttle("in/all","<<< global-IN",10)); }	);
-	return * m_obj_get_global_throttle_in;
-}
-boost::once_flag network_throttle_manager::m_once_get_global_throttle_in;
-std::unique_ptr<i_network_throttle> network_throttle_manager::m_obj_get_global_throttle_in;
-
-
-
-i_network_throttle & network_throttle_manager::get_global_throttle_inreq() { 
-	boost::call_once(m_once_get_global_throttle_inreq, [] { m_obj_get_global_throttle_inreq.reset(new network_throttle("inreq/all", "<== global-IN-REQ",10)); }	);
-	return * m_obj_get_global_throttle_inreq;
-}
-boost::once_flag network_throttle_manager::m_once_get_global_throttle_inreq;
-std::unique_ptr<i_network_throttle> network_throttle_manager::m_obj_get_global_throttle_inreq;
-
-
-i_network_throttle & network_throttle_manager::get_global_throttle_out() { 
-	boost::call_once(m_once_get_global_throttle_out, [] { m_obj_get_global_throttle_out.reset(new network_throttle("out/all", ">>> global-OUT",10)); }	);
-	return * m_obj_get_global_throttle_out;
-}
-boost::once_flag network_throttle_manager::m_once_get_global_throttle_out;
-std::unique_ptr<i_network_throttle> network_throttle_manager::m_obj_get_global_throttle_out;
-
-
-
-
 network_throttle_bw::network_throttle_bw(const std::string &name1) 
 	: m_in("in/"+name1, name1+"-DOWNLOAD"), m_inreq("inreq/"+name1, name1+"-DOWNLOAD-REQUESTS"), m_out("out/"+name1, name1+"-UPLOAD")
 { }
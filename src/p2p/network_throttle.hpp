@@ -99,45 +99,6 @@ struct calculate_times_struct {
 typedef calculate_times_struct calculate_times_struct;
 
 
-namespace cryptonote { class cryptonote_protocol_handler_base; } // a friend class // TODO friend not working
-
-/*** 
-@brief Access to simple throttles, with singlton to access global network limits
-*/
-class network_throttle_manager {
-	// provides global (singleton) in/inreq/out throttle access
-
-	// [[note1]] see also http://www.nuonsoft.com/blog/2012/10/21/implementing-a-thread-safe-singleton-with-c11/
-	// [[note2]] _inreq is the requested in traffic - we anticipate we will get in-bound traffic soon as result of what we do (e.g. that we sent network downloads requests)
-	
-	//protected:
-	public: // XXX
-		// [[note1]]
-		static boost::once_flag m_once_get_global_throttle_in;
-		static boost::once_flag m_once_get_global_throttle_inreq; // [[note2]]
-		static boost::once_flag m_once_get_global_throttle_out;
-		static std::unique_ptr<i_network_throttle> m_obj_get_global_throttle_in;
-		static std::unique_ptr<i_network_throttle> m_obj_get_global_throttle_inreq;
-		static std::unique_ptr<i_network_throttle> m_obj_get_global_throttle_out;
-
-    static boost::mutex m_lock_get_global_throttle_in;
-    static boost::mutex m_lock_get_global_throttle_inreq;
-    static boost::mutex m_lock_get_global_throttle_out;
-
-		friend class cryptonote::cryptonote_protocol_handler_base; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
-		friend class connection_basic; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
-		friend class connection_basic_pimpl; // ditto
-
-		static int xxx;
-
-	public:
-		static i_network_throttle & get_global_throttle_in(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_in
-		static i_network_throttle & get_global_throttle_inreq(); ///< ditto ; use lock ... use m_lock_get_global_throttle_inreq obviously
-		static i_network_throttle & get_global_throttle_out(); ///< ditto ; use lock ... use m_lock_get_global_throttle_out obviously
-};
-
-
-
 /***
 @brief interface for the throttle, see the derivated class
 */
@@ -54,6 +54,9 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_bind_port);
     command_line::add_arg(desc, arg_testnet_rpc_bind_port);
     command_line::add_arg(desc, arg_restricted_rpc);
+    command_line::add_arg(desc, arg_rpc_compression_level);
+    command_line::add_arg(desc, arg_rpc_compression_min_size);
+    command_line::add_arg(desc, arg_rpc_compression_cache_size);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -73,6 +76,20 @@ namespace cryptonote
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, p2p_bind_arg);
     m_restricted = command_line::get_arg(vm, arg_restricted_rpc);
+
+    const int compression_level = command_line::get_arg(vm, arg_rpc_compression_level);
+    CHECK_AND_ASSERT_MES(compression_level >= 0 && compression_level <= 9, false, "RPC compression level must be between 0 and 9");
+#ifdef HTTP_ENABLE_GZIP
+    auto& config = m_net_server.get_config_object();
+    config.m_compression_level = compression_level;
+    config.m_compression_min_size = command_line::get_arg(vm, arg_rpc_compression_min_size);
+    config.m_compression_cache.set_limit(command_line::get_arg(vm, arg_rpc_compression_cache_size) * 1024 * 1024);
+    if (compression_level)
+      LOG_PRINT_L0("RPC response compression enabled, level " << compression_level);
+#else
+    if (compression_level)
+      LOG_PRINT_L0("RPC response compression requested, but this build has no zlib support");
+#endif
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -140,6 +157,26 @@ namespace cryptonote
     res.white_peerlist_size = m_p2p.get_peerlist_manager().get_white_peers_count();
     res.grey_peerlist_size = m_p2p.get_peerlist_manager().get_gray_peers_count();
     res.testnet = m_testnet;
+#if BLOCKCHAIN_DB == DB_LMDB
+    const db_cache_stats cache_stats = m_core.get_blockchain_storage().get_db().get_cache_stats();
+    const tools::lru_cache_stats ring_member_stats = m_core.get_blockchain_storage().get_ring_member_cache_stats();
+    const std::pair<const char*, const tools::lru_cache_stats*> caches[] = {
+      {"blocks", &cache_stats.blocks}, {"txs", &cache_stats.txs}, {"outputs", &cache_stats.outputs},
+      {"ring_members", &ring_member_stats}
+    };
+    for (const auto &c: caches)
+    {
+      db_cache_info info;
+      info.name = c.first;
+      info.hits = c.second->hits;
+      info.misses = c.second->misses;
+      info.evictions = c.second->evictions;
+      info.entries = c.second->entries;
+      info.size = c.second->bytes;
+      info.limit = c.second->limit;
+      res.db_caches.push_back(info);
+    }
+#endif
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -147,7 +184,7 @@ namespace cryptonote
   bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res)
   {
     CHECK_CORE_BUSY();
-    std::list<std::pair<block, std::list<transaction> > > bs;
+    std::vector<std::pair<block, std::vector<transaction> > > bs;
 
     if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
     {
@@ -155,10 +192,12 @@ namespace cryptonote
       return false;
     }
 
+    res.blocks.reserve(bs.size());
     BOOST_FOREACH(auto& b, bs)
     {
       res.blocks.resize(res.blocks.size()+1);
       res.blocks.back().block = block_to_blob(b.first);
+      res.blocks.back().txs.reserve(b.second.size());
       BOOST_FOREACH(auto& t, b.second)
       {
         res.blocks.back().txs.push_back(tx_to_blob(t));
@@ -604,6 +643,14 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_transaction_pool_delta(const COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response& res)
+  {
+    CHECK_CORE_BUSY();
+    m_core.get_pool_transactions_delta(req.since_version, res.added, res.removed, res.full, res.version, req.include_blobs ? &res.blobs : NULL);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res)
   {
     // FIXME: replace back to original m_p2p.send_stop_signal() after
@@ -1241,4 +1288,22 @@ namespace cryptonote
     , false
     };
 
+  const command_line::arg_descriptor<int> core_rpc_server::arg_rpc_compression_level = {
+      "rpc-compression-level"
+    , "gzip level (1-9) for RPC responses to clients which accept it, 0 to disable"
+    , 0
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_compression_min_size = {
+      "rpc-compression-min-size"
+    , "Smallest RPC response, in bytes, to compress"
+    , 1024
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_compression_cache_size = {
+      "rpc-compression-cache-size"
+    , "Memory, in MB, for caching compressed RPC responses"
+    , 32
+    };
+
 }  // namespace cryptonote
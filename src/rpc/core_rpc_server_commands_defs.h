@@ -78,7 +78,7 @@ namespace cryptonote
 
     struct response
     {
-      std::list<block_complete_entry> blocks;
+      std::vector<block_complete_entry> blocks;
       uint64_t    start_height;
       uint64_t    current_height;
       std::string status;
@@ -107,7 +107,7 @@ namespace cryptonote
 
     struct response
     {
-      std::list<crypto::hash> m_block_ids;
+      std::vector<crypto::hash> m_block_ids;
       uint64_t    start_height;
       uint64_t    current_height;
       std::string status;
@@ -384,6 +384,27 @@ namespace cryptonote
     };
   };
   //-----------------------------------------------
+  struct db_cache_info
+  {
+    std::string name;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t size;
+    uint64_t limit;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(hits)
+      KV_SERIALIZE(misses)
+      KV_SERIALIZE(evictions)
+      KV_SERIALIZE(entries)
+      KV_SERIALIZE(size)
+      KV_SERIALIZE(limit)
+    END_KV_SERIALIZE_MAP()
+  };
+
   struct COMMAND_RPC_GET_INFO
   {
     struct request
@@ -409,6 +430,7 @@ namespace cryptonote
       uint64_t grey_peerlist_size;
       bool testnet;
       std::string top_block_hash;
+      std::list<db_cache_info> db_caches;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -425,6 +447,7 @@ namespace cryptonote
         KV_SERIALIZE(grey_peerlist_size)
         KV_SERIALIZE(testnet)
         KV_SERIALIZE(top_block_hash)
+        KV_SERIALIZE(db_caches)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -848,6 +871,39 @@ namespace cryptonote
     };
   };
 
+  struct COMMAND_RPC_GET_TRANSACTION_POOL_DELTA
+  {
+    struct request
+    {
+      uint64_t since_version;  // 0 for the whole pool
+      bool include_blobs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(since_version)
+        KV_SERIALIZE(include_blobs)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t version;
+      bool full;  // added holds the whole pool, forget any previously known txes
+      std::vector<crypto::hash> added;
+      std::vector<crypto::hash> removed;
+      std::vector<blobdata> blobs;  // one per added tx when requested, empty if it has to be fetched separately
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(added)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(removed)
+        KV_SERIALIZE(blobs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_CONNECTIONS
   {
     struct request
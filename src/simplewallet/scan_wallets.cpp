@@ -0,0 +1,192 @@
+// Copyright (c) 2014-2016, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+/*!
+ * \file scan_wallets.cpp
+ *
+ * \brief Refreshes several wallet files with one pass over the blockchain
+ */
+
+#include <iostream>
+#include <memory>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "wallet/wallet_scanner.h"
+#include "password_container.h"
+#include "version.h"
+
+namespace po = boost::program_options;
+using namespace epee; // log_space
+
+namespace
+{
+  const command_line::arg_descriptor<std::vector<std::string> > arg_wallet_files = {"wallet-file", "Wallet files to refresh"};
+  const command_line::arg_descriptor<std::string> arg_password = {"password", "Password used for all wallets, asked for each wallet if not given", ""};
+  const command_line::arg_descriptor<std::string> arg_daemon_address = {"daemon-address", "Use daemon instance at <host>:<port>", ""};
+  const command_line::arg_descriptor<std::string> arg_daemon_host = {"daemon-host", "Use daemon instance at host <arg> instead of localhost", ""};
+  const command_line::arg_descriptor<int> arg_daemon_port = {"daemon-port", "Use daemon instance at port <arg> instead of the default", 0};
+  const command_line::arg_descriptor<bool> arg_testnet = {"testnet", "For testnet. Daemon must also be launched with --testnet flag", false};
+  const command_line::arg_descriptor<uint32_t> arg_log_level = {"log-level", "", LOG_LEVEL_0};
+}
+
+int main(int argc, char* argv[])
+{
+  tools::sanitize_locale();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+
+  command_line::add_arg(desc_cmd_sett, arg_wallet_files);
+  command_line::add_arg(desc_cmd_sett, arg_password);
+  command_line::add_arg(desc_cmd_sett, arg_daemon_address);
+  command_line::add_arg(desc_cmd_sett, arg_daemon_host);
+  command_line::add_arg(desc_cmd_sett, arg_daemon_port);
+  command_line::add_arg(desc_cmd_sett, arg_testnet);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::positional_options_description positional_options;
+  positional_options.add(arg_wallet_files.name, -1);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::command_line_parser(argc, argv).options(desc_options).positional(positional_options).run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Monero '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << "Usage: scan_wallets [options] <wallet-file>..." << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  log_space::get_set_log_detalisation_level(true, command_line::get_arg(vm, arg_log_level));
+  log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL);
+
+  const std::vector<std::string> wallet_files = command_line::get_arg(vm, arg_wallet_files);
+  if (wallet_files.empty())
+  {
+    std::cerr << "at least one wallet file is needed" << std::endl;
+    return 1;
+  }
+
+  const bool testnet = command_line::get_arg(vm, arg_testnet);
+  std::string daemon_address = command_line::get_arg(vm, arg_daemon_address);
+  std::string daemon_host = command_line::get_arg(vm, arg_daemon_host);
+  int daemon_port = command_line::get_arg(vm, arg_daemon_port);
+  if (!daemon_address.empty() && (!daemon_host.empty() || 0 != daemon_port))
+  {
+    std::cerr << "can't specify --daemon-address together with --daemon-host or --daemon-port" << std::endl;
+    return 1;
+  }
+  if (daemon_host.empty())
+    daemon_host = "localhost";
+  if (!daemon_port)
+    daemon_port = testnet ? config::testnet::RPC_DEFAULT_PORT : config::RPC_DEFAULT_PORT;
+  if (daemon_address.empty())
+    daemon_address = std::string("http://") + daemon_host + ":" + std::to_string(daemon_port);
+
+  std::vector<std::unique_ptr<tools::wallet2>> wallets;
+  tools::wallet_scanner scanner;
+  for (const std::string &wallet_file: wallet_files)
+  {
+    tools::password_container pwd_container(false);
+    if (command_line::has_arg(vm, arg_password))
+      pwd_container.password(command_line::get_arg(vm, arg_password));
+    else if (!pwd_container.read_password((std::string("password for ") + wallet_file).c_str()))
+    {
+      std::cerr << "failed to read wallet password" << std::endl;
+      return 1;
+    }
+
+    std::unique_ptr<tools::wallet2> wallet(new tools::wallet2(testnet));
+    try
+    {
+      wallet->load(wallet_file, pwd_container.password());
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "failed to load wallet " << wallet_file << ": " << e.what() << std::endl;
+      return 1;
+    }
+    wallet->init(daemon_address);
+    scanner.add_wallet(wallet.get());
+    wallets.push_back(std::move(wallet));
+  }
+
+  tools::signal_handler::install([&scanner](int type) {
+    scanner.stop();
+  });
+
+  uint64_t blocks_fetched = 0;
+  try
+  {
+    scanner.refresh(blocks_fetched);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "refresh failed: " << e.what() << std::endl;
+  }
+
+  int ret = 0;
+  for (size_t n = 0; n < wallets.size(); ++n)
+  {
+    tools::wallet2 &wallet = *wallets[n];
+    try
+    {
+      wallet.store();
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "failed to store wallet " << wallet_files[n] << ": " << e.what() << std::endl;
+      ret = 1;
+    }
+    std::cout << wallet_files[n] << ": height " << wallet.get_blockchain_current_height()
+        << ", balance " << cryptonote::print_money(wallet.balance())
+        << ", unlocked balance " << cryptonote::print_money(wallet.unlocked_balance()) << std::endl;
+  }
+  std::cout << "blocks fetched: " << blocks_fetched << std::endl;
+  return ret;
+}
@@ -94,12 +94,11 @@ struct Wallet2CallbackImpl : public tools::i_wallet2_callback
         }
     }
 
-    virtual void on_money_spent(uint64_t height, const cryptonote::transaction& in_tx, size_t out_index,
+    virtual void on_money_spent(uint64_t height, const crypto::hash &in_txid, uint64_t amount,
                                 const cryptonote::transaction& spend_tx)
     {
         // TODO;
         std::string tx_hash = epee::string_tools::pod_to_hex(get_transaction_hash(spend_tx));
-        uint64_t amount = in_tx.vout[out_index].amount;
         LOG_PRINT_L3(__FUNCTION__ << ": money spent. height:  " << height
                      << ", tx: " << tx_hash
                      << ", amount: " << print_money(amount));
@@ -602,6 +601,26 @@ void WalletImpl::setDefaultMixin(uint32_t arg)
     m_wallet->default_mixin(arg);
 }
 
+void WalletImpl::setDaemonConnections(uint32_t count)
+{
+    m_wallet->set_daemon_connections(count);
+}
+
+DaemonConnectionStats WalletImpl::daemonConnectionStats() const
+{
+    const tools::daemon_connection_stats stats = m_wallet->get_daemon_connection_stats();
+    DaemonConnectionStats result;
+    result.requests = stats.requests;
+    result.failures = stats.failures;
+    result.connects = stats.connects;
+    result.reused = stats.reused;
+    result.waits = stats.waits;
+    result.averageLatencyUs = stats.requests ? stats.total_latency_us / stats.requests : 0;
+    result.maxLatencyUs = stats.max_latency_us;
+    result.openConnections = stats.open_connections;
+    return result;
+}
+
 
 bool WalletImpl::connectToDaemon()
 {
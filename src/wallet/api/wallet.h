@@ -86,6 +86,8 @@ public:
     virtual void setListener(WalletListener * l);
     virtual uint32_t defaultMixin() const;
     virtual void setDefaultMixin(uint32_t arg);
+    virtual void setDaemonConnections(uint32_t count);
+    virtual DaemonConnectionStats daemonConnectionStats() const;
 
 private:
     void clearStatus();
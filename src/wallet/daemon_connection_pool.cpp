@@ -0,0 +1,239 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <boost/thread/locks.hpp>
+
+#include "daemon_connection_pool.h"
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+daemon_connection_pool::daemon_connection_pool(size_t max_connections)
+  : m_max_connections(std::max<size_t>(max_connections, 1))
+  , m_generation(0)
+{
+  reset_stats();
+}
+//----------------------------------------------------------------------------------------------------
+void daemon_connection_pool::set_daemon(const std::string& host, uint16_t port)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  const std::string port_str = std::to_string(port);
+  if (host == m_host && port_str == m_port)
+    return;
+  m_host = host;
+  m_port = port_str;
+  // connections in use are closed when they come back
+  ++m_generation;
+  for (auto &c: m_connections)
+  {
+    if (!c->busy)
+    {
+      c->client.disconnect();
+      c->generation = m_generation;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void daemon_connection_pool::set_max_connections(size_t max_connections)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_max_connections = std::max<size_t>(max_connections, 1);
+  // idle connections over the limit go now, busy ones when released
+  for (auto i = m_connections.begin(); i != m_connections.end() && m_connections.size() > m_max_connections; )
+  {
+    if ((*i)->busy)
+      ++i;
+    else
+      i = m_connections.erase(i);
+  }
+  m_cond.notify_all();
+}
+//----------------------------------------------------------------------------------------------------
+size_t daemon_connection_pool::get_max_connections() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_max_connections;
+}
+//----------------------------------------------------------------------------------------------------
+bool daemon_connection_pool::connect(unsigned int timeout)
+{
+  return invoke(timeout, NULL);
+}
+//----------------------------------------------------------------------------------------------------
+bool daemon_connection_pool::is_connected() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  for (const auto &c: m_connections)
+  {
+    // a connection in use holds its client's lock for the whole request
+    if (c->busy || c->client.is_connected())
+      return true;
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void daemon_connection_pool::disconnect()
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  ++m_generation;
+  for (auto &c: m_connections)
+  {
+    if (!c->busy)
+    {
+      c->client.disconnect();
+      c->generation = m_generation;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+daemon_connection_stats daemon_connection_pool::get_stats() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  daemon_connection_stats stats = m_stats;
+  stats.open_connections = 0;
+  for (const auto &c: m_connections)
+    if (c->busy || c->client.is_connected())
+      ++stats.open_connections;
+  return stats;
+}
+//----------------------------------------------------------------------------------------------------
+void daemon_connection_pool::reset_stats()
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_stats = daemon_connection_stats();
+}
+//----------------------------------------------------------------------------------------------------
+daemon_connection_pool::connection& daemon_connection_pool::acquire()
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  bool waited = false;
+  while (true)
+  {
+    connection *idle = NULL;
+    for (auto &c: m_connections)
+    {
+      if (c->busy)
+        continue;
+      if (c->client.is_connected())
+      {
+        idle = c.get();
+        break;
+      }
+      if (!idle)
+        idle = c.get();
+    }
+    if (!idle && m_connections.size() < m_max_connections)
+    {
+      m_connections.emplace_back(new connection());
+      idle = m_connections.back().get();
+      idle->generation = m_generation;
+    }
+    if (idle)
+    {
+      idle->busy = true;
+      if (waited)
+        ++m_stats.waits;
+      return *idle;
+    }
+    waited = true;
+    m_cond.wait(lock);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void daemon_connection_pool::release(connection& c)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  c.busy = false;
+  if (c.generation != m_generation)
+  {
+    c.client.disconnect();
+    c.generation = m_generation;
+  }
+  if (m_connections.size() > m_max_connections)
+  {
+    m_connections.erase(std::find_if(m_connections.begin(), m_connections.end(),
+      [&c](const std::unique_ptr<connection> &p) { return p.get() == &c; }));
+  }
+  m_cond.notify_one();
+}
+//----------------------------------------------------------------------------------------------------
+bool daemon_connection_pool::invoke(unsigned int timeout, const std::function<bool(epee::net_utils::http::http_simple_client&)>& f)
+{
+  connection &c = acquire();
+  const auto start = std::chrono::steady_clock::now();
+  const bool reused = c.client.is_connected();
+  bool r = false;
+  try
+  {
+    if (!reused)
+    {
+      std::string host, port;
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        host = m_host;
+        port = m_port;
+      }
+      r = !host.empty() && c.client.connect(host, port, timeout);
+    }
+    if (reused || r)
+      r = f ? f(c.client) : true;
+  }
+  catch (...)
+  {
+    c.client.disconnect();
+    release(c);
+    throw;
+  }
+  // a failed request may leave a half read response behind
+  if (!r)
+    c.client.disconnect();
+  const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (!reused && r)
+      ++m_stats.connects;
+    if (f)
+    {
+      ++m_stats.requests;
+      if (!r)
+        ++m_stats.failures;
+      if (reused)
+        ++m_stats.reused;
+      m_stats.total_latency_us += latency;
+      m_stats.max_latency_us = std::max(m_stats.max_latency_us, latency);
+    }
+  }
+  release(c);
+  return r;
+}
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "include_base_utils.h"
+#include "net/http_client.h"
+#include "storages/http_abstract_invoke.h"
+
+namespace tools
+{
+  struct daemon_connection_stats
+  {
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t connects;          //!< new connections opened to the daemon
+    uint64_t reused;            //!< requests sent over an already open connection
+    uint64_t waits;             //!< requests which had to wait for a free connection
+    uint64_t total_latency_us;
+    uint64_t max_latency_us;
+    uint64_t open_connections;
+  };
+
+  /*!
+   * \brief A small pool of persistent HTTP connections to one daemon
+   *
+   * Each request borrows an idle connection, preferring one which is already
+   * open, opens a new one while the pool is below its limit, and otherwise
+   * waits for one to be returned.  Requests from different threads (refresh,
+   * transfer creation) thus run concurrently instead of queueing behind a
+   * single client.  A connection whose request failed is closed, so the next
+   * request on it reconnects.
+   */
+  class daemon_connection_pool
+  {
+  public:
+    static const size_t DEFAULT_MAX_CONNECTIONS = 4;
+
+    daemon_connection_pool(size_t max_connections = DEFAULT_MAX_CONNECTIONS);
+
+    //! Sets the daemon to talk to, closing connections to any previous one
+    void set_daemon(const std::string& host, uint16_t port);
+    void set_max_connections(size_t max_connections);
+    size_t get_max_connections() const;
+
+    //! Makes sure at least one connection to the daemon is open
+    bool connect(unsigned int timeout);
+    bool is_connected() const;
+    void disconnect();
+
+    template<class t_request, class t_response>
+    bool invoke_json(const std::string& url, t_request& req, t_response& res, unsigned int timeout = 5000)
+    {
+      return invoke(timeout, [&](epee::net_utils::http::http_simple_client& client) {
+        return epee::net_utils::invoke_http_json_remote_command2(url, req, res, client, timeout);
+      });
+    }
+
+    template<class t_request, class t_response>
+    bool invoke_bin(const std::string& url, t_request& req, t_response& res, unsigned int timeout = 5000)
+    {
+      return invoke(timeout, [&](epee::net_utils::http::http_simple_client& client) {
+        return epee::net_utils::invoke_http_bin_remote_command2(url, req, res, client, timeout);
+      });
+    }
+
+    //! As invoke_bin, also giving the HTTP status the daemon answered with, 0 if none came
+    template<class t_request, class t_response>
+    bool invoke_bin(const std::string& url, t_request& req, t_response& res, unsigned int timeout, int& response_code)
+    {
+      response_code = 0;
+      return invoke(timeout, [&](epee::net_utils::http::http_simple_client& client) {
+        std::string body;
+        if (!epee::serialization::store_t_to_binary(req, body))
+          return false;
+        const epee::net_utils::http::http_response_info* pri = NULL;
+        if (!epee::net_utils::http::invoke_request(url, client, timeout, &pri, "GET", body) || !pri)
+          return false;
+        response_code = pri->m_response_code;
+        if (response_code != 200)
+        {
+          LOG_PRINT_L1("Failed to invoke http request to  " << url << ", wrong response code: " << response_code);
+          return false;
+        }
+        return epee::serialization::load_t_from_binary(res, pri->m_body);
+      });
+    }
+
+    daemon_connection_stats get_stats() const;
+    void reset_stats();
+
+  private:
+    struct connection
+    {
+      connection(): busy(false), generation(0) {}
+      epee::net_utils::http::http_simple_client client;
+      bool busy;
+      uint64_t generation;
+    };
+
+    bool invoke(unsigned int timeout, const std::function<bool(epee::net_utils::http::http_simple_client&)>& f);
+    connection& acquire();
+    void release(connection& c);
+
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    std::vector<std::unique_ptr<connection>> m_connections;
+    size_t m_max_connections;
+    std::string m_host;
+    std::string m_port;
+    uint64_t m_generation;
+    daemon_connection_stats m_stats;
+  };
+}
@@ -0,0 +1,414 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "common/int-util.h"
+#include "common/util.h"
+#include "string_tools.h"
+#include "crypto/crypto.h"
+#include "transfer_tx_store.h"
+
+namespace
+{
+  // the file starts with the magic, the format version, and an iv and the
+  // zero block encrypted with it, which tell a file for another key
+  const char FILE_MAGIC[] = "Monero transfer txs\x1a";
+  const uint32_t FILE_VERSION = 1;
+  const size_t KEY_CHECK_SIZE = 32;
+  const size_t FILE_HEADER_SIZE = sizeof(FILE_MAGIC) - 1 + sizeof(uint32_t) + sizeof(crypto::chacha8_iv) + KEY_CHECK_SIZE;
+
+  // each record is the txid, the iv, the blob size and the encrypted blob
+  const size_t RECORD_HEADER_SIZE = sizeof(crypto::hash) + sizeof(crypto::chacha8_iv) + sizeof(uint32_t);
+
+  std::string make_key_check(const crypto::chacha8_key &key, const crypto::chacha8_iv &iv)
+  {
+    const std::string zero(KEY_CHECK_SIZE, '\0');
+    std::string check(KEY_CHECK_SIZE, '\0');
+    crypto::chacha8(zero.data(), zero.size(), key, iv, &check[0]);
+    return check;
+  }
+
+  bool same_key(const crypto::chacha8_key &a, const crypto::chacha8_key &b)
+  {
+    return !memcmp(&a, &b, sizeof(crypto::chacha8_key));
+  }
+}
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+transfer_tx_store::transfer_tx_store()
+  : m_unwritten(0)
+  , m_file_size(0)
+  , m_garbage(0)
+{
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::open(const std::string &path, const crypto::chacha8_key &key, bool truncate)
+{
+  m_append.close();
+  m_index.clear();
+  m_unwritten = 0;
+  m_file_size = 0;
+  m_garbage = 0;
+  m_path = path;
+  m_key = key;
+
+  if (!truncate && !read_index())
+  {
+    m_path.clear();
+    m_index.clear();
+    m_file_size = 0;
+    m_garbage = 0;
+    return false;
+  }
+
+  m_append.open(m_path, std::ios_base::binary | std::ios_base::out | (truncate || m_file_size == 0 ? std::ios_base::trunc : std::ios_base::app));
+  if (m_append.is_open() && m_file_size == 0)
+  {
+    if (write_file_header(m_append, m_key) && m_append.flush())
+      m_file_size = FILE_HEADER_SIZE;
+    else
+      m_append.close();
+  }
+  if (!m_append.is_open())
+  {
+    LOG_ERROR("Failed to open " << m_path);
+    m_path.clear();
+    m_index.clear();
+    m_file_size = 0;
+    m_garbage = 0;
+    return false;
+  }
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::read_index()
+{
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(m_path, ec))
+    return true;
+  const uint64_t file_size = boost::filesystem::file_size(m_path, ec);
+  if (ec)
+  {
+    LOG_ERROR("Failed to get the size of " << m_path << ": " << ec.message());
+    return false;
+  }
+  if (file_size < FILE_HEADER_SIZE)
+  {
+    // cut short while it was created, there is no tx in it yet
+    LOG_PRINT_L0("Starting " << m_path << " over, it is too short to hold a header");
+    return true;
+  }
+
+  std::ifstream in(m_path, std::ios_base::binary);
+  if (!check_file_header(in, m_key))
+    return false;
+  m_file_size = FILE_HEADER_SIZE;
+
+  char header[RECORD_HEADER_SIZE];
+  while (in.read(header, RECORD_HEADER_SIZE))
+  {
+    crypto::hash txid;
+    uint32_t size;
+    memcpy(&txid, header, sizeof(txid));
+    memcpy(&size, header + sizeof(txid) + sizeof(crypto::chacha8_iv), sizeof(size));
+    size = SWAP32LE(size);
+    const uint64_t offset = m_file_size + RECORD_HEADER_SIZE;
+    if (offset + size > file_size)
+      break;
+
+    // a tx added again after being erased replaces the earlier record
+    entry &e = m_index[txid];
+    if (e.written)
+      m_garbage += RECORD_HEADER_SIZE + e.size;
+    e.offset = offset;
+    e.size = size;
+    memcpy(&e.iv, header + sizeof(txid), sizeof(e.iv));
+    e.refs = 0;
+    e.written = true;
+    m_file_size = offset + size;
+    in.seekg(m_file_size);
+  }
+  in.close();
+
+  // a record cut short by a crash would throw off the ones appended after it
+  if (m_file_size < file_size)
+  {
+    LOG_PRINT_L0("Dropping " << file_size - m_file_size << " bytes of incomplete record from " << m_path);
+    boost::filesystem::resize_file(m_path, m_file_size, ec);
+  }
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::add(const crypto::hash &txid, const cryptonote::blobdata &blob)
+{
+  if (add_ref(txid))
+    return true;
+
+  entry &e = m_index[txid];
+  e.size = blob.size();
+  e.refs = 1;
+  e.written = false;
+  if (m_append.is_open())
+  {
+    e.offset = m_file_size + RECORD_HEADER_SIZE;
+    e.iv = crypto::rand<crypto::chacha8_iv>();
+    std::string cipher(blob.size(), '\0');
+    crypto::chacha8(blob.data(), blob.size(), m_key, e.iv, &cipher[0]);
+    e.written = write_record(m_append, txid, e.iv, cipher) && m_append.flush();
+    if (e.written)
+    {
+      m_file_size = e.offset + e.size;
+      return true;
+    }
+    // the file's end is now unknown, so keep the rest in memory until
+    // store() rewrites it
+    LOG_ERROR("Failed to write tx " << epee::string_tools::pod_to_hex(txid) << " to " << m_path);
+    m_append.close();
+  }
+  e.blob = blob;
+  ++m_unwritten;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::add_ref(const crypto::hash &txid)
+{
+  auto it = m_index.find(txid);
+  if (it == m_index.end())
+    return false;
+  ++it->second.refs;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_tx_store::release(const crypto::hash &txid)
+{
+  auto it = m_index.find(txid);
+  if (it != m_index.end() && (it->second.refs <= 1))
+    erase(it);
+  else if (it != m_index.end())
+    --it->second.refs;
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_tx_store::set_refs(const std::unordered_map<crypto::hash, size_t> &refs)
+{
+  for (auto it = m_index.begin(); it != m_index.end(); )
+  {
+    auto rit = refs.find(it->first);
+    if (rit == refs.end() || rit->second == 0)
+    {
+      auto next = std::next(it);
+      erase(it);
+      it = next;
+      continue;
+    }
+    it->second.refs = rit->second;
+    ++it;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_tx_store::erase(std::unordered_map<crypto::hash, entry>::iterator it)
+{
+  if (it->second.written)
+    m_garbage += RECORD_HEADER_SIZE + it->second.size;
+  else
+    --m_unwritten;
+  m_index.erase(it);
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_tx_store::clear()
+{
+  m_index.clear();
+  m_unwritten = 0;
+  m_garbage = m_file_size > FILE_HEADER_SIZE ? m_file_size - FILE_HEADER_SIZE : 0;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::get(const crypto::hash &txid, cryptonote::blobdata &blob) const
+{
+  auto it = m_index.find(txid);
+  if (it == m_index.end())
+    return false;
+  const entry &e = it->second;
+  if (!e.written)
+  {
+    blob = e.blob;
+    return true;
+  }
+
+  std::ifstream in(m_path, std::ios_base::binary);
+  std::string cipher;
+  if (!read_blob(in, e, cipher))
+  {
+    LOG_ERROR("Failed to read tx " << epee::string_tools::pod_to_hex(txid) << " from " << m_path);
+    return false;
+  }
+  blob.resize(cipher.size());
+  crypto::chacha8(cipher.data(), cipher.size(), m_key, e.iv, &blob[0]);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+size_t transfer_tx_store::get_blob_size(const crypto::hash &txid) const
+{
+  auto it = m_index.find(txid);
+  return it == m_index.end() ? 0 : it->second.size;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::store(const std::string &path, const crypto::chacha8_key &key)
+{
+  const bool reencrypt = !is_open() || !same_key(key, m_key);
+  if (path == m_path && m_append.is_open() && m_unwritten == 0 && !reencrypt && m_garbage * 2 <= m_file_size)
+    return true;
+
+  const std::string new_path = path + ".new";
+  std::ofstream out(new_path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+  std::ifstream in;
+  if (is_open())
+    in.open(m_path, std::ios_base::binary);
+  std::unordered_map<crypto::hash, entry> index;
+  uint64_t offset = FILE_HEADER_SIZE;
+  bool success = out.is_open() && write_file_header(out, key);
+  for (auto it = m_index.begin(); success && it != m_index.end(); ++it)
+  {
+    entry e = it->second;
+    std::string cipher;
+    if (e.written)
+    {
+      success = read_blob(in, e, cipher);
+      if (success && reencrypt)
+      {
+        cryptonote::blobdata blob(cipher.size(), '\0');
+        crypto::chacha8(cipher.data(), cipher.size(), m_key, e.iv, &blob[0]);
+        e.iv = crypto::rand<crypto::chacha8_iv>();
+        crypto::chacha8(blob.data(), blob.size(), key, e.iv, &cipher[0]);
+      }
+    }
+    else
+    {
+      e.iv = crypto::rand<crypto::chacha8_iv>();
+      cipher.resize(e.blob.size());
+      crypto::chacha8(e.blob.data(), e.blob.size(), key, e.iv, &cipher[0]);
+      e.blob.clear();
+      e.written = true;
+    }
+    success = success && write_record(out, it->first, e.iv, cipher);
+    e.offset = offset + RECORD_HEADER_SIZE;
+    offset = e.offset + e.size;
+    index.emplace(it->first, std::move(e));
+  }
+  in.close();
+  out.close();
+  if (!success || !out.good())
+  {
+    LOG_ERROR("Failed to write " << new_path);
+    return false;
+  }
+
+  m_append.close();
+  std::error_code ec = tools::replace_file(new_path, path);
+  if (ec)
+  {
+    LOG_ERROR("Failed to replace " << path << ": " << ec.message());
+    // keep using the old file, if any
+    if (is_open() && m_unwritten == 0)
+      m_append.open(m_path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    return false;
+  }
+
+  m_path = path;
+  m_key = key;
+  m_index = std::move(index);
+  m_unwritten = 0;
+  m_file_size = offset;
+  m_garbage = 0;
+  m_append.open(m_path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+  return m_append.is_open();
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::write_file_header(std::ofstream &out, const crypto::chacha8_key &key)
+{
+  const uint32_t version = SWAP32LE(FILE_VERSION);
+  const crypto::chacha8_iv iv = crypto::rand<crypto::chacha8_iv>();
+  out.write(FILE_MAGIC, sizeof(FILE_MAGIC) - 1);
+  out.write((const char*)&version, sizeof(version));
+  out.write((const char*)&iv, sizeof(iv));
+  out << make_key_check(key, iv);
+  return out.good();
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::check_file_header(std::ifstream &in, const crypto::chacha8_key &key) const
+{
+  std::string header(FILE_HEADER_SIZE, '\0');
+  if (!in.read(&header[0], header.size()) || header.compare(0, sizeof(FILE_MAGIC) - 1, FILE_MAGIC))
+  {
+    LOG_ERROR(m_path << " is not a transfer txs file");
+    return false;
+  }
+  size_t pos = sizeof(FILE_MAGIC) - 1;
+  uint32_t version;
+  memcpy(&version, &header[pos], sizeof(version));
+  version = SWAP32LE(version);
+  pos += sizeof(version);
+  if (version != FILE_VERSION)
+  {
+    LOG_ERROR(m_path << " has format version " << version << ", only version " << FILE_VERSION << " can be read");
+    return false;
+  }
+  crypto::chacha8_iv iv;
+  memcpy(&iv, &header[pos], sizeof(iv));
+  pos += sizeof(iv);
+  if (header.compare(pos, KEY_CHECK_SIZE, make_key_check(key, iv)))
+  {
+    LOG_ERROR(m_path << " was written with another key");
+    return false;
+  }
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::read_blob(std::ifstream &in, const entry &e, std::string &cipher) const
+{
+  cipher.resize(e.size);
+  if (e.size == 0)
+    return true;
+  in.clear();
+  in.seekg(e.offset);
+  return (bool)in.read(&cipher[0], e.size);
+}
+//----------------------------------------------------------------------------------------------------
+bool transfer_tx_store::write_record(std::ofstream &out, const crypto::hash &txid, const crypto::chacha8_iv &iv, const std::string &cipher)
+{
+  const uint32_t size = SWAP32LE((uint32_t)cipher.size());
+  out.write((const char*)&txid, sizeof(txid));
+  out.write((const char*)&iv, sizeof(iv));
+  out.write((const char*)&size, sizeof(size));
+  out.write(cipher.data(), cipher.size());
+  return out.good();
+}
+//----------------------------------------------------------------------------------------------------
+}
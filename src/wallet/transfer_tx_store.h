@@ -0,0 +1,125 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "cryptonote_protocol/blobdatatype.h"
+#include "crypto/chacha8.h"
+#include "crypto/hash.h"
+
+namespace tools
+{
+  /*!
+   * \brief The txs a wallet received outputs in, kept in a file next to the
+   *        wallet cache and read only when one is needed
+   *
+   * Each tx is appended to the file, encrypted with the wallet cache key, as
+   * soon as it is added. The file starts with a header naming its format
+   * version and checking the key, so a file written by a later version or
+   * for another wallet is refused rather than read as garbage. Only an index of the file is kept in memory. A tx
+   * is counted once for each transfer received in it, and erased when the
+   * last of them goes. Erased txs stay in the file until store() rewrites
+   * it. Until the store has a file, txs are kept in memory.
+   */
+  class transfer_tx_store
+  {
+  public:
+    transfer_tx_store();
+
+    /*!
+     * \brief Uses the given file, reading the index of the txs already in it
+     *
+     * The txs read have no references until set_refs() is called.
+     * \param truncate  Start with an empty file instead
+     * \return          false if the file cannot be written to, or is not a
+     *                  transfer txs file of a known version for this key
+     */
+    bool open(const std::string &path, const crypto::chacha8_key &key, bool truncate = false);
+    bool is_open() const { return !m_path.empty(); }
+    const std::string &path() const { return m_path; }
+
+    //! Adds a reference to a tx, storing it if it is new
+    bool add(const crypto::hash &txid, const cryptonote::blobdata &blob);
+    //! Adds a reference to a tx if it is known
+    bool add_ref(const crypto::hash &txid);
+    //! Drops a reference to a tx, erasing it after the last one
+    void release(const crypto::hash &txid);
+    //! Sets the references to every tx, erasing those with none
+    void set_refs(const std::unordered_map<crypto::hash, size_t> &refs);
+    //! Erases all txs, the file keeps them until the next store()
+    void clear();
+
+    bool get(const crypto::hash &txid, cryptonote::blobdata &blob) const;
+    bool has(const crypto::hash &txid) const { return m_index.find(txid) != m_index.end(); }
+    size_t get_blob_size(const crypto::hash &txid) const;
+    size_t size() const { return m_index.size(); }
+    //! Bytes of erased txs still in the file
+    uint64_t get_garbage_size() const { return m_garbage; }
+
+    /*!
+     * \brief Writes the txs to the given file, and uses it from then on
+     *
+     * The file is only rewritten if it is a different one, if some txs are
+     * not in it yet, or if it holds more erased txs than live ones.
+     */
+    bool store(const std::string &path, const crypto::chacha8_key &key);
+
+  private:
+    struct entry
+    {
+      entry(): offset(0), size(0), refs(0), written(false) {}
+
+      uint64_t offset; // of the encrypted blob in the file
+      uint32_t size;
+      crypto::chacha8_iv iv;
+      size_t refs;
+      bool written;
+      cryptonote::blobdata blob; // until written
+    };
+
+    bool read_index();
+    void erase(std::unordered_map<crypto::hash, entry>::iterator it);
+    bool read_blob(std::ifstream &in, const entry &e, std::string &cipher) const;
+    bool write_file_header(std::ofstream &out, const crypto::chacha8_key &key);
+    bool check_file_header(std::ifstream &in, const crypto::chacha8_key &key) const;
+    bool write_record(std::ofstream &out, const crypto::hash &txid, const crypto::chacha8_iv &iv, const std::string &cipher);
+
+    std::string m_path;
+    crypto::chacha8_key m_key;
+    std::unordered_map<crypto::hash, entry> m_index;
+    size_t m_unwritten;
+    std::ofstream m_append;
+    uint64_t m_file_size;
+    uint64_t m_garbage;
+  };
+}
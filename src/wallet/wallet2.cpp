@@ -111,11 +111,95 @@ namespace tools
 // for now, limit to 30 attempts.  TODO: discuss a good number to limit to.
 const size_t MAX_SPLIT_ATTEMPTS = 30;
 
+//----------------------------------------------------------------------------------------------------
+const crypto::hash &hashchain::operator[](size_t height) const
+{
+  if (height >= m_offset)
+  {
+    THROW_WALLET_EXCEPTION_IF(height >= size(), error::wallet_internal_error, "block hash height out of range: " + std::to_string(height));
+    return m_recent[height - m_offset];
+  }
+  auto it = m_sparse.find(height);
+  THROW_WALLET_EXCEPTION_IF(it == m_sparse.end(), error::wallet_internal_error, "block hash not kept for height " + std::to_string(height));
+  return it->second;
+}
+//----------------------------------------------------------------------------------------------------
+void hashchain::push_back(const crypto::hash &hash)
+{
+  m_recent.push_back(hash);
+  trim();
+}
+//----------------------------------------------------------------------------------------------------
+void hashchain::trim()
+{
+  while (m_recent.size() > WALLET_BLOCKCHAIN_RECENT_HASHES)
+  {
+    if (m_offset % WALLET_BLOCKCHAIN_SPARSE_HASHES_STEP == 0)
+      m_sparse[m_offset] = m_recent.front();
+    m_recent.pop_front();
+    ++m_offset;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void hashchain::crop(size_t height)
+{
+  if (height >= size())
+    return;
+  if (height >= m_offset)
+  {
+    m_recent.resize(height - m_offset);
+    return;
+  }
+  // the recent window is gone, it will be refilled from height onwards
+  m_recent.clear();
+  m_sparse.erase(m_sparse.lower_bound(height), m_sparse.end());
+  m_offset = height;
+}
+//----------------------------------------------------------------------------------------------------
+void hashchain::clear()
+{
+  m_offset = 0;
+  m_sparse.clear();
+  m_recent.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void hashchain::assign(const std::vector<crypto::hash> &hashes)
+{
+  clear();
+  for (const auto &hash: hashes)
+    push_back(hash);
+}
+//----------------------------------------------------------------------------------------------------
+size_t hashchain::get_nearest(size_t height, crypto::hash &hash) const
+{
+  THROW_WALLET_EXCEPTION_IF(height >= size(), error::wallet_internal_error, "block hash height out of range: " + std::to_string(height));
+  if (height >= m_offset)
+  {
+    hash = m_recent[height - m_offset];
+    return height;
+  }
+  auto it = m_sparse.upper_bound(height);
+  THROW_WALLET_EXCEPTION_IF(it == m_sparse.begin(), error::wallet_internal_error, "no block hash kept at or below height " + std::to_string(height));
+  --it;
+  hash = it->second;
+  return it->first;
+}
+
 //----------------------------------------------------------------------------------------------------
 void wallet2::init(const std::string& daemon_address, uint64_t upper_transaction_size_limit)
 {
   m_upper_transaction_size_limit = upper_transaction_size_limit;
   m_daemon_address = daemon_address;
+  m_pool_version = 0;
+  m_pool_delta_unsupported = false;
+
+  net_utils::http::url_content u;
+  net_utils::parse_url(m_daemon_address, u);
+  if(!u.port)
+  {
+    u.port = m_testnet ? config::testnet::RPC_DEFAULT_PORT : config::RPC_DEFAULT_PORT;
+  }
+  m_daemon_connections.set_daemon(u.host, u.port);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_deterministic() const
@@ -168,7 +252,7 @@ bool wallet2::is_deprecated() const
   return is_old_file_format;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::check_acc_out(const account_keys &acc, const tx_out &o, const crypto::public_key &tx_pub_key, size_t i, uint64_t &money_transfered, bool &error) const
+void wallet2::check_acc_out(const crypto::public_key_precomp &spend_public_key, const tx_out &o, const crypto::key_derivation &derivation, size_t i, uint64_t &money_transfered, bool &error) const
 {
   if (o.target.type() !=  typeid(txout_to_key))
   {
@@ -176,7 +260,7 @@ void wallet2::check_acc_out(const account_keys &acc, const tx_out &o, const cryp
      LOG_ERROR("wrong type id in transaction out");
      return;
   }
-  if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+  if(is_out_to_acc(spend_public_key, boost::get<txout_to_key>(o.target), derivation, i))
   {
     money_transfered = o.amount;
   }
@@ -215,9 +299,17 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     }
 
     tx_pub_key = pub_key_field.pub_key;
+    // one derivation per tx, shared by all the output checks below
+    crypto::key_derivation derivation;
     bool r = true;
     int threads = tools::get_max_concurrency();
-    if (miner_tx && m_refresh_type == RefreshNoCoinbase)
+    const crypto::public_key_precomp &spend_public_key = get_spend_public_key_precomp();
+    if (!generate_key_derivation(tx_pub_key, m_account.get_keys().m_view_secret_key, derivation))
+    {
+      // no output can be ours with an invalid tx public key
+      LOG_PRINT_L1("Failed to generate key derivation for tx " << get_transaction_hash(tx));
+    }
+    else if (miner_tx && m_refresh_type == RefreshNoCoinbase)
     {
       // assume coinbase isn't for us
     }
@@ -225,7 +317,7 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     {
       uint64_t money_transfered = 0;
       bool error = false;
-      check_acc_out(m_account.get_keys(), tx.vout[0], tx_pub_key, 0, money_transfered, error);
+      check_acc_out(spend_public_key, tx.vout[0], derivation, 0, money_transfered, error);
       if (error)
       {
         r = false;
@@ -247,13 +339,12 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
             threadpool.create_thread(boost::bind(&boost::asio::io_service::run, &ioservice));
           }
 
-          const account_keys &keys = m_account.get_keys();
           std::vector<uint64_t> money_transfered(tx.vout.size());
           std::deque<bool> error(tx.vout.size());
           // the first one was already checked
           for (size_t i = 1; i < tx.vout.size(); ++i)
           {
-            ioservice.dispatch(boost::bind(&wallet2::check_acc_out, this, std::cref(keys), std::cref(tx.vout[i]), std::cref(tx_pub_key), i,
+            ioservice.dispatch(boost::bind(&wallet2::check_acc_out, this, std::cref(spend_public_key), std::cref(tx.vout[i]), std::cref(derivation), i,
               std::ref(money_transfered[i]), std::ref(error[i])));
           }
           KILL_IOSERVICE();
@@ -283,12 +374,11 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
         threadpool.create_thread(boost::bind(&boost::asio::io_service::run, &ioservice));
       }
 
-      const account_keys &keys = m_account.get_keys();
       std::vector<uint64_t> money_transfered(tx.vout.size());
       std::deque<bool> error(tx.vout.size());
       for (size_t i = 0; i < tx.vout.size(); ++i)
       {
-        ioservice.dispatch(boost::bind(&wallet2::check_acc_out, this, std::cref(keys), std::cref(tx.vout[i]), std::cref(tx_pub_key), i,
+        ioservice.dispatch(boost::bind(&wallet2::check_acc_out, this, std::cref(spend_public_key), std::cref(tx.vout[i]), std::cref(derivation), i,
           std::ref(money_transfered[i]), std::ref(error[i])));
       }
       KILL_IOSERVICE();
@@ -309,7 +399,7 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     }
     else
     {
-      r = lookup_acc_outs(m_account.get_keys(), tx, tx_pub_key, outs, tx_money_got_in_outs);
+      r = lookup_acc_outs(spend_public_key, tx, derivation, outs, tx_money_got_in_outs);
     }
     THROW_WALLET_EXCEPTION_IF(!r, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
 
@@ -319,12 +409,11 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
       //usually we have only one transfer for user in transaction
       cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
       cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response res = AUTO_VAL_INIT(res);
+      const crypto::hash txid = get_transaction_hash(tx);
       if (!pool)
       {
-        req.txid = get_transaction_hash(tx);
-        m_daemon_rpc_mutex.lock();
-        bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_o_indexes.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
-        m_daemon_rpc_mutex.unlock();
+        req.txid = txid;
+        bool r = m_daemon_connections.invoke_bin(m_daemon_address + "/get_o_indexes.bin", req, res, WALLET_RCP_CONNECTION_TIMEOUT);
         THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
         THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
         THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
@@ -358,13 +447,14 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
 	    td.m_block_height = height;
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = res.o_indexes[o];
-	    td.m_tx = tx;
+	    add_transfer(td, tx, txid, tx_pub_key);
             td.m_key_image = ki;
 	    td.m_spent = false;
 	    m_key_images[td.m_key_image] = m_transfers.size()-1;
-	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << get_transaction_hash(tx));
+	    add_unspent(m_transfers.size()-1);
+	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << txid);
 	    if (0 != m_callback)
-	      m_callback->on_money_received(height, td.m_tx, td.m_internal_output_index);
+	      m_callback->on_money_received(height, tx, td.m_internal_output_index);
           }
         }
 	else if (m_transfers[kit->second].m_spent || m_transfers[kit->second].amount() >= tx.vout[o].amount)
@@ -384,17 +474,21 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
 
           if (!pool)
           {
+            remove_unspent(kit->second);
             transfer_details &td = m_transfers[kit->second];
+            const crypto::hash replaced_txid = td.m_txid;
 	    td.m_block_height = height;
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = res.o_indexes[o];
-	    td.m_tx = tx;
+	    add_transfer(td, tx, txid, tx_pub_key);
+            m_transfer_txs.release(replaced_txid);
             THROW_WALLET_EXCEPTION_IF(td.m_key_image != ki, error::wallet_internal_error, "Inconsistent key images");
 	    THROW_WALLET_EXCEPTION_IF(td.m_spent, error::wallet_internal_error, "Inconsistent spent status");
+            add_unspent(kit->second);
 
-	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << get_transaction_hash(tx));
+	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << txid);
 	    if (0 != m_callback)
-	      m_callback->on_money_received(height, td.m_tx, td.m_internal_output_index);
+	      m_callback->on_money_received(height, tx, td.m_internal_output_index);
           }
         }
       }
@@ -412,10 +506,11 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     {
       LOG_PRINT_L0("Spent money: " << print_money(boost::get<cryptonote::txin_to_key>(in).amount) << ", with tx: " << get_transaction_hash(tx));
       tx_money_spent_in_ins += boost::get<cryptonote::txin_to_key>(in).amount;
-      transfer_details& td = m_transfers[it->second];
-      td.m_spent = true;
+      const transfer_details& td = m_transfers[it->second];
+      set_spent(it->second, true);
+      // the transfer has all the callback needs, the tx it came in stays on disk
       if (0 != m_callback)
-        m_callback->on_money_spent(height, td.m_tx, td.m_internal_output_index, tx);
+        m_callback->on_money_spent(height, td.m_txid, td.amount(), tx);
     }
   }
 
@@ -475,7 +570,7 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
     if (pool)
       m_unconfirmed_payments.emplace(payment_id, payment);
     else
-      m_payments.emplace(payment_id, payment);
+      add_payment(payment_id, payment);
     LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
   }
 }
@@ -511,37 +606,34 @@ void wallet2::process_outgoing(const cryptonote::transaction &tx, uint64_t heigh
   ctd.m_timestamp = ts;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const crypto::hash& bl_id, uint64_t height)
+void wallet2::process_new_blockchain_entry(const parsed_block& pb, uint64_t height)
 {
   //handle transactions from new block
     
   //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
-  if(b.timestamp + 60*60*24 > m_account.get_createtime() && height >= m_refresh_from_block_height)
+  if(pb.block.timestamp + 60*60*24 > m_account.get_createtime() && height >= m_refresh_from_block_height)
   {
     TIME_MEASURE_START(miner_tx_handle_time);
-    process_new_transaction(b.miner_tx, height, b.timestamp, true, false);
+    process_new_transaction(pb.block.miner_tx, height, pb.block.timestamp, true, false);
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
-    BOOST_FOREACH(auto& txblob, bche.txs)
+    BOOST_FOREACH(auto& tx, pb.txes)
     {
-      cryptonote::transaction tx;
-      bool r = parse_and_validate_tx_from_blob(txblob, tx);
-      THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, txblob);
-      process_new_transaction(tx, height, b.timestamp, false, false);
+      process_new_transaction(tx, height, pb.block.timestamp, false, false);
     }
     TIME_MEASURE_FINISH(txs_handle_time);
-    LOG_PRINT_L2("Processed block: " << bl_id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
+    LOG_PRINT_L2("Processed block: " << pb.hash << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
   }else
   {
     if (!(height % 100))
-      LOG_PRINT_L2( "Skipped block by timestamp, height: " << height << ", block time " << b.timestamp << ", account time " << m_account.get_createtime());
+      LOG_PRINT_L2( "Skipped block by timestamp, height: " << height << ", block time " << pb.block.timestamp << ", account time " << m_account.get_createtime());
   }
-  m_blockchain.push_back(bl_id);
+  m_blockchain.push_back(pb.hash);
   ++m_local_bc_height;
 
   if (0 != m_callback)
-    m_callback->on_new_block(height, b);
+    m_callback->on_new_block(height, pb.block);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_short_chain_history(std::list<crypto::hash>& ids) const
@@ -552,12 +644,17 @@ void wallet2::get_short_chain_history(std::list<crypto::hash>& ids) const
   if(!sz)
     return;
   size_t current_back_offset = 1;
-  bool genesis_included = false;
+  size_t last_height = sz;
   while(current_back_offset < sz)
   {
-    ids.push_back(m_blockchain[sz-current_back_offset]);
-    if(sz-current_back_offset == 0)
-      genesis_included = true;
+    // older heights only have a sparse hash, use the nearest one below
+    crypto::hash id;
+    size_t height = m_blockchain.get_nearest(sz-current_back_offset, id);
+    if(height != last_height)
+    {
+      ids.push_back(id);
+      last_height = height;
+    }
     if(i < 10)
     {
       ++current_back_offset;
@@ -567,155 +664,177 @@ void wallet2::get_short_chain_history(std::list<crypto::hash>& ids) const
     }
     ++i;
   }
-  if(!genesis_included)
-    ids.push_back(m_blockchain[0]);
+  if(last_height != 0)
+    ids.push_back(m_blockchain.genesis());
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::block &bl, crypto::hash &bl_id, bool &error) const
+void wallet2::parse_block_round(const cryptonote::block_complete_entry &bche, parsed_block &pb, bool &error)
 {
-  error = !cryptonote::parse_and_validate_block_from_blob(blob, bl);
-  if (!error)
-    bl_id = get_block_hash(bl);
+  error = !cryptonote::parse_and_validate_block_from_blob(bche.block, pb.block);
+  if (error)
+    return;
+  pb.hash = get_block_hash(pb.block);
+  pb.txes.resize(bche.txs.size());
+  size_t i = 0;
+  BOOST_FOREACH(auto& txblob, bche.txs)
+  {
+    if (!parse_and_validate_tx_from_blob(txblob, pb.txes[i++]))
+    {
+      error = true;
+      return;
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::parse_blocks(const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks)
+{
+  parsed_blocks.clear();
+  parsed_blocks.resize(blocks.size());
+  std::deque<bool> error(blocks.size());
+
+  size_t threads = tools::get_max_concurrency();
+  if (threads > 1 && blocks.size() > 1)
+  {
+    boost::asio::io_service ioservice;
+    boost::thread_group threadpool;
+    std::unique_ptr < boost::asio::io_service::work > work(new boost::asio::io_service::work(ioservice));
+    for (size_t i = 0; i < std::min(threads, blocks.size()); i++)
+    {
+      threadpool.create_thread(boost::bind(&boost::asio::io_service::run, &ioservice));
+    }
+
+    size_t i = 0;
+    BOOST_FOREACH(auto& bche, blocks)
+    {
+      ioservice.dispatch(boost::bind(&wallet2::parse_block_round, std::cref(bche), std::ref(parsed_blocks[i]), std::ref(error[i])));
+      ++i;
+    }
+    KILL_IOSERVICE();
+  }
+  else
+  {
+    size_t i = 0;
+    BOOST_FOREACH(auto& bche, blocks)
+    {
+      bool e = false;
+      parse_block_round(bche, parsed_blocks[i], e);
+      error[i++] = e;
+    }
+  }
+
+  size_t i = 0;
+  BOOST_FOREACH(auto& bche, blocks)
+  {
+    THROW_WALLET_EXCEPTION_IF(error[i++], error::block_parse_error, bche.block);
+  }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<cryptonote::block_complete_entry> &blocks)
+void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks)
 {
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
   req.block_ids = short_chain_history;
 
   req.start_height = start_height;
-  m_daemon_rpc_mutex.lock();
-  bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/getblocks.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_bin(m_daemon_address + "/getblocks.bin", req, res, WALLET_RCP_CONNECTION_TIMEOUT);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
 
   blocks_start_height = res.start_height;
-  blocks = res.blocks;
+  blocks = std::move(res.blocks);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<crypto::hash> &hashes)
+void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
 {
   cryptonote::COMMAND_RPC_GET_HASHES_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_HASHES_FAST::response res = AUTO_VAL_INIT(res);
   req.block_ids = short_chain_history;
 
   req.start_height = start_height;
-  m_daemon_rpc_mutex.lock();
-  bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/gethashes.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_bin(m_daemon_address + "/gethashes.bin", req, res, WALLET_RCP_CONNECTION_TIMEOUT);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "gethashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "gethashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_hashes_error, res.status);
 
   blocks_start_height = res.start_height;
-  hashes = res.m_block_ids;
+  hashes = std::move(res.m_block_ids);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, uint64_t& blocks_added)
+{
+  std::vector<parsed_block> parsed_blocks;
+  parse_blocks(blocks, parsed_blocks);
+  process_parsed_blocks(start_height, parsed_blocks, blocks_added);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::block_complete_entry> &blocks, uint64_t& blocks_added)
+void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &blocks, uint64_t& blocks_added)
 {
+  CRITICAL_REGION_LOCAL(m_refresh_lock);
   size_t current_index = start_height;
   blocks_added = 0;
-
-  int threads = tools::get_max_concurrency();
-  if (threads > 1)
+  if (start_height > m_blockchain.size())
   {
-    std::vector<crypto::hash> round_block_hashes(threads);
-    std::vector<cryptonote::block> round_blocks(threads);
-    std::deque<bool> error(threads);
-    size_t blocks_size = blocks.size();
-    std::list<block_complete_entry>::const_iterator blocki = blocks.begin();
-    for (size_t b = 0; b < blocks_size; b += threads)
-    {
-      size_t round_size = std::min((size_t)threads, blocks_size - b);
-
-      boost::asio::io_service ioservice;
-      boost::thread_group threadpool;
-      std::unique_ptr < boost::asio::io_service::work > work(new boost::asio::io_service::work(ioservice));
-      for (size_t i = 0; i < round_size; i++)
-      {
-        threadpool.create_thread(boost::bind(&boost::asio::io_service::run, &ioservice));
-      }
-
-      std::list<block_complete_entry>::const_iterator tmpblocki = blocki;
-      for (size_t i = 0; i < round_size; ++i)
-      {
-        ioservice.dispatch(boost::bind(&wallet2::parse_block_round, this, std::cref(tmpblocki->block),
-          std::ref(round_blocks[i]), std::ref(round_block_hashes[i]), std::ref(error[i])));
-        ++tmpblocki;
-      }
-      KILL_IOSERVICE();
-      tmpblocki = blocki;
-      for (size_t i = 0; i < round_size; ++i)
-      {
-        THROW_WALLET_EXCEPTION_IF(error[i], error::block_parse_error, tmpblocki->block);
-        ++tmpblocki;
-      }
-      for (size_t i = 0; i < round_size; ++i)
-      {
-        const crypto::hash &bl_id = round_block_hashes[i];
-        cryptonote::block &bl = round_blocks[i];
-
-        if(current_index >= m_blockchain.size())
-        {
-          process_new_blockchain_entry(bl, *blocki, bl_id, current_index);
-          ++blocks_added;
-        }
-        else if(bl_id != m_blockchain[current_index])
-        {
-          //split detected here !!!
-          THROW_WALLET_EXCEPTION_IF(current_index == start_height, error::wallet_internal_error,
-            "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) +
-            " (height " + std::to_string(start_height) + "), local block id at this height: " +
-            string_tools::pod_to_hex(m_blockchain[current_index]));
-
-          detach_blockchain(current_index);
-          process_new_blockchain_entry(bl, *blocki, bl_id, current_index);
-        }
-        else
-        {
-          LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(bl_id));
-        }
-        ++current_index;
-        ++blocki;
-      }
-    }
+    // pulled for a wallet further along, we can't link them to our chain yet
+    LOG_PRINT_L2("Blocks start at " << start_height << ", above our chain height " << m_blockchain.size());
+    return;
   }
-  else
-  {
-  BOOST_FOREACH(auto& bl_entry, blocks)
-  {
-    cryptonote::block bl;
-    bool r = cryptonote::parse_and_validate_block_from_blob(bl_entry.block, bl);
-    THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl_entry.block);
 
-    crypto::hash bl_id = get_block_hash(bl);
+  for (size_t i = 0; i < blocks.size(); ++i, ++current_index)
+  {
+    const parsed_block &pb = blocks[i];
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(pb, current_index);
       ++blocks_added;
     }
-    else if(bl_id != m_blockchain[current_index])
+    else if(m_blockchain.is_known(current_index) && pb.hash != m_blockchain[current_index])
     {
       //split detected here !!!
       THROW_WALLET_EXCEPTION_IF(current_index == start_height, error::wallet_internal_error,
-        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) +
+        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(pb.hash) +
         " (height " + std::to_string(start_height) + "), local block id at this height: " +
         string_tools::pod_to_hex(m_blockchain[current_index]));
 
+      if(!m_blockchain.is_known(current_index - 1))
+      {
+        // the split is somewhere below the recent hashes, where we only know
+        // the sparse ones: go back to the block the daemon resumed from, which
+        // we both have, and rescan everything after it
+        LOG_PRINT_L0("Split below the recent block hashes, rescanning from height " << start_height + 1);
+        detach_blockchain(start_height + 1);
+        i = 0;
+        current_index = start_height;
+        continue;
+      }
+
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(pb, current_index);
     }
     else
     {
-      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(bl_id));
+      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(pb.hash));
     }
-
-    ++current_index;
   }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_parsed_blocks(uint64_t &blocks_start_height, std::vector<parsed_block> &blocks)
+{
+  CRITICAL_REGION_LOCAL(m_refresh_lock);
+  std::list<crypto::hash> short_chain_history;
+  get_short_chain_history(short_chain_history);
+  m_run.store(true, std::memory_order_relaxed);
+  if (m_refresh_from_block_height > m_blockchain.size())
+  {
+    // only the hashes are needed up to the restore height
+    fast_refresh(m_refresh_from_block_height, blocks_start_height, short_chain_history);
+    short_chain_history.clear();
+    get_short_chain_history(short_chain_history);
   }
+
+  std::vector<cryptonote::block_complete_entry> block_entries;
+  pull_blocks(0, blocks_start_height, short_chain_history, block_entries);
+  parse_blocks(block_entries, blocks);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh()
@@ -730,7 +849,7 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched)
   refresh(start_height, blocks_fetched, received_money);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::list<cryptonote::block_complete_entry> &prev_blocks, std::list<cryptonote::block_complete_entry> &blocks, bool &error)
+void wallet2::pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, std::vector<cryptonote::block_complete_entry> &blocks, bool &error)
 {
   error = false;
 
@@ -738,7 +857,7 @@ void wallet2::pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_hei
   {
     // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
     cryptonote::block bl;
-    std::list<cryptonote::block_complete_entry>::const_reverse_iterator i = prev_blocks.rbegin();
+    std::vector<cryptonote::block_complete_entry>::const_reverse_iterator i = prev_blocks.rbegin();
     for (size_t n = 0; n < std::min((size_t)3, prev_blocks.size()); ++n)
     {
       bool ok = cryptonote::parse_and_validate_block_from_blob(i->block, bl);
@@ -756,171 +875,216 @@ void wallet2::pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_hei
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_pool_state()
+void wallet2::get_pool_delta(cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res)
+{
+  if (!m_pool_delta_unsupported)
+  {
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request req;
+    req.since_version = m_pool_version;
+    req.include_blobs = true;
+    int response_code = 0;
+    bool r = m_daemon_connections.invoke_bin(m_daemon_address + "/get_transaction_pool_delta.bin", req, res, 200000, response_code);
+    THROW_WALLET_EXCEPTION_IF(r && res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_transaction_pool_delta.bin");
+    if (r && res.status == CORE_RPC_STATUS_OK)
+    {
+      THROW_WALLET_EXCEPTION_IF(!res.blobs.empty() && res.blobs.size() != res.added.size(), error::wallet_internal_error,
+          "daemon returned " + std::to_string(res.blobs.size()) + " blobs for " + std::to_string(res.added.size()) + " pool txes");
+      return;
+    }
+    if (response_code == 404)
+    {
+      // the daemon does not know the delta call, don't try it again
+      LOG_PRINT_L0("Daemon does not support get_transaction_pool_delta.bin, getting the whole pool from now on");
+      m_pool_delta_unsupported = true;
+    }
+    else
+    {
+      // a timeout or a dropped connection, the delta call is tried again next time
+      LOG_PRINT_L1("get_transaction_pool_delta.bin failed, trying get_transaction_pool");
+    }
+  }
+
+  get_full_pool(res);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_full_pool(cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res)
 {
-  // get the pool state
   cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::request req;
-  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response res;
-  m_daemon_rpc_mutex.lock();
-  bool r = epee::net_utils::invoke_http_json_remote_command2(m_daemon_address + "/get_transaction_pool", req, res, m_http_client, 200000);
-  m_daemon_rpc_mutex.unlock();
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response pool;
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/get_transaction_pool", req, pool, 200000);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_transaction_pool");
-  THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_transaction_pool");
-  THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_tx_pool_error);
+  THROW_WALLET_EXCEPTION_IF(pool.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_transaction_pool");
+  THROW_WALLET_EXCEPTION_IF(pool.status != CORE_RPC_STATUS_OK, error::get_tx_pool_error);
+
+  // the same as a delta with the whole pool, without blobs
+  res.status = pool.status;
+  res.version = 0;
+  res.full = true;
+  res.added.clear();
+  res.removed.clear();
+  res.blobs.clear();
+  for (const auto &tx: pool.transactions)
+  {
+    crypto::hash txid;
+    if (!epee::string_tools::hex_to_pod(tx.id_hash, txid))
+    {
+      LOG_PRINT_L0("Failed to parse pool txid " << tx.id_hash);
+      continue;
+    }
+    res.added.push_back(txid);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::apply_pool_delta(const cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res, std::vector<size_t> &new_txes)
+{
+  new_txes.clear();
+  if (res.full)
+  {
+    // only the txes we did not know about already are new
+    std::unordered_set<crypto::hash> pool_txids;
+    for (size_t n = 0; n < res.added.size(); ++n)
+    {
+      if (pool_txids.insert(res.added[n]).second && m_pool_txids.find(res.added[n]) == m_pool_txids.end())
+        new_txes.push_back(n);
+    }
+    m_pool_txids.swap(pool_txids);
+  }
+  else
+  {
+    for (const auto &txid: res.removed)
+      m_pool_txids.erase(txid);
+    for (size_t n = 0; n < res.added.size(); ++n)
+    {
+      if (m_pool_txids.insert(res.added[n]).second)
+        new_txes.push_back(n);
+    }
+  }
+  m_pool_version = res.version;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_pool_state()
+{
+  CRITICAL_REGION_LOCAL(m_refresh_lock);
+  // get what changed in the pool since we last asked
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response res;
+  get_pool_delta(res);
+  std::vector<size_t> new_txes;
+  apply_pool_delta(res, new_txes);
 
   // remove any pending tx that's not in the pool
-  std::unordered_map<crypto::hash, wallet2::unconfirmed_transfer_details>::iterator it = m_unconfirmed_txs.begin();
-  while (it != m_unconfirmed_txs.end())
+  for (auto &utx: m_unconfirmed_txs)
   {
-    const std::string txid = epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(it->second.m_tx));
-    bool found = false;
-    for (auto it2: res.transactions)
+    if (m_pool_txids.find(utx.first) != m_pool_txids.end())
+      continue;
+    // we want to avoid a false positive when we ask for the pool just after
+    // a tx is removed from the pool due to being found in a new block, but
+    // just before the block is visible by refresh. So we keep a boolean, so
+    // that the first time we don't see the tx, we set that boolean, and only
+    // delete it the second time it is checked
+    if (utx.second.m_state == wallet2::unconfirmed_transfer_details::pending)
     {
-      if (it2.id_hash == txid)
-      {
-        found = true;
-        break;
-      }
+      LOG_PRINT_L1("Pending txid " << utx.first << " not in pool, marking as not in pool");
+      utx.second.m_state = wallet2::unconfirmed_transfer_details::pending_not_in_pool;
     }
-    auto pit = it++;
-    if (!found)
+    else if (utx.second.m_state == wallet2::unconfirmed_transfer_details::pending_not_in_pool)
     {
-      // we want to avoid a false positive when we ask for the pool just after
-      // a tx is removed from the pool due to being found in a new block, but
-      // just before the block is visible by refresh. So we keep a boolean, so
-      // that the first time we don't see the tx, we set that boolean, and only
-      // delete it the second time it is checked
-      if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending)
-      {
-        LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as not in pool");
-        pit->second.m_state = wallet2::unconfirmed_transfer_details::pending_not_in_pool;
-      }
-      else if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending_not_in_pool)
-      {
-        LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as failed");
-        pit->second.m_state = wallet2::unconfirmed_transfer_details::failed;
-      }
+      LOG_PRINT_L1("Pending txid " << utx.first << " not in pool, marking as failed");
+      utx.second.m_state = wallet2::unconfirmed_transfer_details::failed;
     }
   }
 
   // remove pool txes to us that aren't in the pool anymore
-  std::unordered_map<crypto::hash, wallet2::payment_details>::iterator uit = m_unconfirmed_payments.begin();
-  while (uit != m_unconfirmed_payments.end())
+  for (auto uit = m_unconfirmed_payments.begin(); uit != m_unconfirmed_payments.end(); )
+  {
+    if (m_pool_txids.find(uit->first) == m_pool_txids.end())
+      uit = m_unconfirmed_payments.erase(uit);
+    else
+      ++uit;
+  }
+
+  // add new pool txes to us
+  std::vector<crypto::hash> missing;
+  for (size_t n: new_txes)
   {
-    const std::string txid = string_tools::pod_to_hex(uit->first);
-    bool found = false;
-    for (auto it2: res.transactions)
+    const crypto::hash &txid = res.added[n];
+    if (m_unconfirmed_payments.find(txid) != m_unconfirmed_payments.end())
     {
-      if (it2.id_hash == txid)
-      {
-        found = true;
-        break;
-      }
+      LOG_PRINT_L1("Already saw that one");
+      continue;
     }
-    auto pit = uit++;
-    if (!found)
+    if (m_unconfirmed_txs.find(txid) != m_unconfirmed_txs.end())
     {
-      m_unconfirmed_payments.erase(pit);
+      LOG_PRINT_L1("We sent that one");
+      continue;
     }
+    LOG_PRINT_L1("Found new pool tx: " << txid);
+    if (res.blobs.empty() || res.blobs[n].empty())
+      missing.push_back(txid);
+    else
+      process_pool_transaction(txid, res.blobs[n]);
   }
 
-  // add new pool txes to us
-  for (auto it: res.transactions)
+  // not one of those we sent ourselves, and the daemon did not send it along
+  if (!missing.empty())
   {
-    cryptonote::blobdata txid_data;
-    if(epee::string_tools::parse_hexstr_to_binbuff(it.id_hash, txid_data))
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req;
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response res;
+    for (const auto &txid: missing)
+      req.txs_hashes.push_back(epee::string_tools::pod_to_hex(txid));
+    req.decode_as_json = false;
+    bool r = m_daemon_connections.invoke_json(m_daemon_address + "/gettransactions", req, res, 200000);
+    if (r && res.status == CORE_RPC_STATUS_OK)
     {
-      const crypto::hash txid = *reinterpret_cast<const crypto::hash*>(txid_data.data());
-      if (m_unconfirmed_payments.find(txid) == m_unconfirmed_payments.end())
+      for (const auto &e: res.txs)
       {
-        LOG_PRINT_L1("Found new pool tx: " << txid);
-        bool found = false;
-        for (const auto &i: m_unconfirmed_txs)
+        cryptonote::blobdata txid_data, bd;
+        if (!epee::string_tools::parse_hexstr_to_binbuff(e.tx_hash, txid_data) || txid_data.size() != sizeof(crypto::hash))
         {
-          if (i.first == txid)
-          {
-            found = true;
-            break;
-          }
+          LOG_PRINT_L0("Failed to parse txid");
+          continue;
         }
-        if (!found)
+        const crypto::hash txid = *reinterpret_cast<const crypto::hash*>(txid_data.data());
+        // might have just been put in a block
+        if (!e.in_pool)
         {
-          // not one of those we sent ourselves
-          cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req;
-          cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response res;
-          req.txs_hashes.push_back(it.id_hash);
-          req.decode_as_json = false;
-          m_daemon_rpc_mutex.lock();
-          bool r = epee::net_utils::invoke_http_json_remote_command2(m_daemon_address + "/gettransactions", req, res, m_http_client, 200000);
-          m_daemon_rpc_mutex.unlock();
-          if (r && res.status == CORE_RPC_STATUS_OK)
-          {
-            if (res.txs.size() == 1)
-            {
-              // might have just been put in a block
-              if (res.txs[0].in_pool)
-              {
-                cryptonote::transaction tx;
-                cryptonote::blobdata bd;
-                crypto::hash tx_hash, tx_prefix_hash;
-                if (epee::string_tools::parse_hexstr_to_binbuff(res.txs[0].as_hex, bd))
-                {
-                  if (cryptonote::parse_and_validate_tx_from_blob(bd, tx, tx_hash, tx_prefix_hash))
-                  {
-                    if (tx_hash == txid)
-                    {
-                      process_new_transaction(tx, 0, time(NULL), false, true);
-                    }
-                    else
-                    {
-                      LOG_PRINT_L0("Mismatched txids when processing unconfimed txes from pool");
-                    }
-                  }
-                  else
-                  {
-                    LOG_PRINT_L0("failed to validate transaction from daemon");
-                  }
-                }
-                else
-                {
-                  LOG_PRINT_L0("Failed to parse tx " << txid);
-                }
-              }
-              else
-              {
-                LOG_PRINT_L1("Tx " << txid << " was in pool, but is no more");
-              }
-            }
-            else
-            {
-              LOG_PRINT_L0("Expected 1 tx, got " << res.txs.size());
-            }
-          }
-          else
-          {
-            LOG_PRINT_L0("Error calling gettransactions daemon RPC: r " << r << ", status " << res.status);
-          }
+          LOG_PRINT_L1("Tx " << txid << " was in pool, but is no more");
+          continue;
         }
-        else
+        if (!epee::string_tools::parse_hexstr_to_binbuff(e.as_hex, bd))
         {
-          LOG_PRINT_L1("We sent that one");
+          LOG_PRINT_L0("Failed to parse tx " << txid);
+          continue;
         }
-      }
-      else
-      {
-        LOG_PRINT_L1("Already saw that one");
+        process_pool_transaction(txid, bd);
       }
     }
     else
     {
-      LOG_PRINT_L0("Failed to parse txid");
+      LOG_PRINT_L0("Error calling gettransactions daemon RPC: r " << r << ", status " << res.status);
     }
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::process_pool_transaction(const crypto::hash &txid, const cryptonote::blobdata &blob)
+{
+  cryptonote::transaction tx;
+  crypto::hash tx_hash, tx_prefix_hash;
+  if (!cryptonote::parse_and_validate_tx_from_blob(blob, tx, tx_hash, tx_prefix_hash))
+  {
+    LOG_PRINT_L0("failed to validate transaction from daemon");
+    return;
+  }
+  if (tx_hash != txid)
+  {
+    LOG_PRINT_L0("Mismatched txids when processing unconfimed txes from pool");
+    return;
+  }
+  process_new_transaction(tx, 0, time(NULL), false, true);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history)
 {
-  std::list<crypto::hash> hashes;
+  std::vector<crypto::hash> hashes;
   size_t current_index = m_blockchain.size();
 
   while(m_run.load(std::memory_order_relaxed) && current_index < stop_height)
@@ -938,12 +1102,9 @@ void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height,
         std::advance(left, -3);
         short_chain_history.erase(left, right);
       }
-      right = hashes.end();
       // prepend 3 more
-      for (int i = 0; i<3; i++) {
-        right--;
-        short_chain_history.push_front(*right);
-      }
+      for (size_t i = 1; i <= 3; i++)
+        short_chain_history.push_front(hashes[hashes.size() - i]);
     }
     current_index = blocks_start_height;
     BOOST_FOREACH(auto& bl_id, hashes)
@@ -961,9 +1122,13 @@ void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height,
           m_callback->on_new_block(current_index, dummy);
         }
       }
-      else if(bl_id != m_blockchain[current_index])
+      else if(m_blockchain.is_known(current_index) && bl_id != m_blockchain[current_index])
       {
         //split detected here !!!
+        // drop the hashes of the old chain, from the last block we know we
+        // share, and let the full refresh pick up from there
+        if(current_index > blocks_start_height)
+          detach_blockchain(m_blockchain.is_known(current_index - 1) ? current_index : blocks_start_height + 1);
         return;
       }
       ++current_index;
@@ -976,15 +1141,16 @@ void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height,
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& received_money)
 {
+  CRITICAL_REGION_LOCAL(m_refresh_lock);
   received_money = false;
   blocks_fetched = 0;
   uint64_t added_blocks = 0;
   size_t try_count = 0;
-  crypto::hash last_tx_hash_id = m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash;
+  crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
   std::list<crypto::hash> short_chain_history;
   boost::thread pull_thread;
   uint64_t blocks_start_height;
-  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<cryptonote::block_complete_entry> blocks;
 
   // pull the first set of blocks
   get_short_chain_history(short_chain_history);
@@ -1012,7 +1178,7 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& re
     {
       // pull the next set of blocks while we're processing the current one
       uint64_t next_blocks_start_height;
-      std::list<cryptonote::block_complete_entry> next_blocks;
+      std::vector<cryptonote::block_complete_entry> next_blocks;
       bool error = false;
       pull_thread = boost::thread([&]{pull_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, next_blocks, error);});
 
@@ -1049,16 +1215,16 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& re
       }
     }
   }
-  if(last_tx_hash_id != (m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash))
+  if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_txid : null_hash))
     received_money = true;
 
   try
   {
     update_pool_state();
   }
-  catch (...)
+  catch (const std::exception &e)
   {
-    LOG_PRINT_L1("Failed to check pending transactions");
+    LOG_PRINT_L0("Failed to check pending transactions: " << e.what());
   }
 
   LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance: " << print_money(balance()) << ", unlocked: " << print_money(unlocked_balance()));
@@ -1091,21 +1257,38 @@ void wallet2::detach_blockchain(uint64_t height)
     auto it_ki = m_key_images.find(m_transfers[i].m_key_image);
     THROW_WALLET_EXCEPTION_IF(it_ki == m_key_images.end(), error::wallet_internal_error, "key image not found");
     m_key_images.erase(it_ki);
+    if (!m_transfers[i].m_spent)
+      remove_unspent(i);
+    m_transfer_txs.release(m_transfers[i].m_txid);
     ++transfers_detached;
   }
   m_transfers.erase(it, m_transfers.end());
 
-  size_t blocks_detached = m_blockchain.end() - (m_blockchain.begin()+height);
-  m_blockchain.erase(m_blockchain.begin()+height, m_blockchain.end());
+  size_t blocks_detached = m_blockchain.size() - height;
+  m_blockchain.crop(height);
   m_local_bc_height -= blocks_detached;
 
-  for (auto it = m_payments.begin(); it != m_payments.end(); )
+  for (auto it = m_payments_by_height.lower_bound(height); it != m_payments_by_height.end(); ++it)
   {
-    if(height <= it->second.m_block_height)
-      it = m_payments.erase(it);
-    else
-      ++it;
+    const crypto::hash payment_id = it->second->first;
+    auto id_it = m_payments_by_id.find(payment_id);
+    if (id_it != m_payments_by_id.end())
+    {
+      id_it->second.erase(id_it->second.lower_bound(height), id_it->second.end());
+      if (id_it->second.empty())
+        m_payments_by_id.erase(id_it);
+    }
+    auto range = m_payments.equal_range(payment_id);
+    for (auto i = range.first; i != range.second; ++i)
+    {
+      if (&*i == it->second)
+      {
+        m_payments.erase(i);
+        break;
+      }
+    }
   }
+  m_payments_by_height.erase(m_payments_by_height.lower_bound(height), m_payments_by_height.end());
 
   for (auto it = m_confirmed_txs.begin(); it != m_confirmed_txs.end(); )
   {
@@ -1127,11 +1310,20 @@ bool wallet2::clear()
 {
   m_blockchain.clear();
   m_transfers.clear();
+  m_transfer_txs.clear();
+  m_unspent_balance = 0;
+  m_unspent_by_amount.clear();
+  m_unspent_by_unlock_height.clear();
+  m_unspent_time_locked.clear();
   m_key_images.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
+  m_payments_by_height.clear();
+  m_payments_by_id.clear();
   m_tx_keys.clear();
   m_confirmed_txs.clear();
+  m_pool_version = 0;
+  m_pool_txids.clear();
   m_local_bc_height = 1;
   return true;
 }
@@ -1561,21 +1753,8 @@ bool wallet2::prepare_file_names(const std::string& file_path)
 //----------------------------------------------------------------------------------------------------
 bool wallet2::check_connection(bool *same_version)
 {
-  boost::lock_guard<boost::mutex> lock(m_daemon_rpc_mutex);
-
-  if(!m_http_client.is_connected())
-  {
-    net_utils::http::url_content u;
-    net_utils::parse_url(m_daemon_address, u);
-
-    if(!u.port)
-    {
-      u.port = m_testnet ? config::testnet::RPC_DEFAULT_PORT : config::RPC_DEFAULT_PORT;
-    }
-
-    if (!m_http_client.connect(u.host, std::to_string(u.port), WALLET_RCP_CONNECTION_TIMEOUT))
-      return false;
-  }
+  if (!m_daemon_connections.connect(WALLET_RCP_CONNECTION_TIMEOUT))
+    return false;
 
   if (same_version)
   {
@@ -1584,7 +1763,7 @@ bool wallet2::check_connection(bool *same_version)
     req_t.jsonrpc = "2.0";
     req_t.id = epee::serialization::storage_entry(0);
     req_t.method = "get_version";
-    bool r = net_utils::invoke_http_json_remote_command2(m_daemon_address + "/json_rpc", req_t, resp_t, m_http_client);
+    bool r = m_daemon_connections.invoke_json(m_daemon_address + "/json_rpc", req_t, resp_t);
     if (!r || resp_t.result.status != CORE_RPC_STATUS_OK)
       *same_version = false;
     else
@@ -1623,6 +1802,11 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
   }
   LOG_PRINT_L0("Loaded wallet keys file, with public address: " << m_account.get_public_address_str(m_testnet));
 
+  crypto::chacha8_key key;
+  generate_chacha8_key_from_secret_keys(key);
+  const std::string txs_file = m_wallet_file + ".txs";
+  THROW_WALLET_EXCEPTION_IF(!m_transfer_txs.open(txs_file, key), error::file_read_error, txs_file);
+
   //keys loaded ok!
   //try to load wallet file. but even if we failed, it is not big problem
   if(!boost::filesystem::exists(m_wallet_file, e) || e)
@@ -1644,8 +1828,6 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
 
       r = ::serialization::parse_binary(buf, cache_file_data);
       THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + m_wallet_file + '\"');
-      crypto::chacha8_key key;
-      generate_chacha8_key_from_secret_keys(key);
       std::string cache_data;
       cache_data.resize(cache_file_data.cache_data.size());
       crypto::chacha8(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
@@ -1668,6 +1850,9 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
   }
+  rebuild_payment_indices();
+  rebuild_unspent_indices();
+  rebuild_transfer_tx_refs();
 
   cryptonote::block genesis;
   generate_genesis(genesis);
@@ -1688,7 +1873,7 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
 void wallet2::check_genesis(const crypto::hash& genesis_hash) const {
   std::string what("Genesis block missmatch. You probably use wallet without testnet flag with blockchain from test network or vice versa");
 
-  THROW_WALLET_EXCEPTION_IF(genesis_hash != m_blockchain[0], error::wallet_internal_error, what);
+  THROW_WALLET_EXCEPTION_IF(genesis_hash != m_blockchain.genesis(), error::wallet_internal_error, what);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::store()
@@ -1747,6 +1932,7 @@ void wallet2::store_to(const std::string &path, const std::string &password)
   const std::string old_file = m_wallet_file;
   const std::string old_keys_file = m_keys_file;
   const std::string old_address_file = m_wallet_file + ".address.txt";
+  const std::string old_txs_file = m_wallet_file + ".txs";
 
   // save to new file
   std::ofstream ostr;
@@ -1765,6 +1951,10 @@ void wallet2::store_to(const std::string &path, const std::string &password)
     const std::string address_file = m_wallet_file + ".address.txt";
     bool r = file_io_utils::save_string_to_file(address_file, m_account.get_public_address_str(m_testnet));
     THROW_WALLET_EXCEPTION_IF(!r, error::file_save_error, m_wallet_file);
+    // save the txs to the new file
+    const std::string txs_file = m_wallet_file + ".txs";
+    r = m_transfer_txs.store(txs_file, key);
+    THROW_WALLET_EXCEPTION_IF(!r, error::file_save_error, txs_file);
     // remove old wallet file
     r = boost::filesystem::remove(old_file);
     if (!r) {
@@ -1780,29 +1970,45 @@ void wallet2::store_to(const std::string &path, const std::string &password)
     if (!r) {
       LOG_ERROR("error removing file: " << old_address_file);
     }
+    // remove old txs file
+    boost::system::error_code ignored_ec;
+    if (boost::filesystem::exists(old_txs_file, ignored_ec)) {
+      r = boost::filesystem::remove(old_txs_file);
+      if (!r) {
+        LOG_ERROR("error removing file: " << old_txs_file);
+      }
+    }
   } else {
     // here we have "*.new" file, we need to rename it to be without ".new"
     std::error_code e = tools::replace_file(new_file, m_wallet_file);
     THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+    // the cache is saved first, so the txs file always has every tx it refers to
+    const std::string txs_file = m_wallet_file + ".txs";
+    bool r = m_transfer_txs.store(txs_file, key);
+    THROW_WALLET_EXCEPTION_IF(!r, error::file_save_error, txs_file);
   }
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::unlocked_balance() const
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(const transfer_details& td, m_transfers)
-    if(!td.m_spent && is_transfer_unlocked(td))
-      amount += td.amount();
+  // only the transfers which are still locked need looking at
+  uint64_t amount = m_unspent_balance;
+  const uint64_t height = m_blockchain.size();
+  for (auto i = m_unspent_by_unlock_height.upper_bound(height); i != m_unspent_by_unlock_height.end(); ++i)
+    amount -= m_transfers[i->second].amount();
+  for (size_t idx: m_unspent_time_locked)
+  {
+    const transfer_details& td = m_transfers[idx];
+    if (get_transfer_unlock_height(td) <= height && !is_transfer_unlocked(td))
+      amount -= td.amount();
+  }
 
   return amount;
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance() const
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(auto& td, m_transfers)
-    if(!td.m_spent)
-      amount += td.amount();
+  uint64_t amount = m_unspent_balance;
 
 
   BOOST_FOREACH(auto& utx, m_unconfirmed_txs)
@@ -1817,26 +2023,140 @@ void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) con
   incoming_transfers = m_transfers;
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::get_transfer_tx(const crypto::hash &txid, cryptonote::transaction &tx) const
+{
+  cryptonote::blobdata blob;
+  if (!m_transfer_txs.get(txid, blob))
+    return false;
+  return cryptonote::parse_and_validate_tx_from_blob(blob, tx);
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet2::get_transfer_tx_size(const crypto::hash &txid) const
+{
+  return m_transfer_txs.get_blob_size(txid);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_transfer(transfer_details &td, const cryptonote::transaction &tx, const crypto::hash &txid, const crypto::public_key &tx_pub_key)
+{
+  const cryptonote::tx_out &out = tx.vout[td.m_internal_output_index];
+  THROW_WALLET_EXCEPTION_IF(out.target.type() != typeid(cryptonote::txout_to_key), error::wallet_internal_error,
+      "Output is not txout_to_key");
+  td.m_txid = txid;
+  td.m_tx_pub_key = tx_pub_key;
+  td.m_unlock_time = tx.unlock_time;
+  td.m_amount = out.amount;
+  td.m_output_key = boost::get<cryptonote::txout_to_key>(out.target).key;
+  if (!m_transfer_txs.add_ref(txid))
+    m_transfer_txs.add(txid, cryptonote::tx_to_blob(tx));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_tx_refs()
+{
+  // this also drops txs left over from transfers which were detached or
+  // replaced after the cache was last stored
+  std::unordered_map<crypto::hash, size_t> refs;
+  for (const transfer_details &td: m_transfers)
+    ++refs[td.m_txid];
+  m_transfer_txs.set_refs(refs);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::import_legacy_transfers(const std::vector<legacy_transfer_details> &transfers)
+{
+  m_transfers.clear();
+  m_transfer_txs.clear();
+  m_transfers.reserve(transfers.size());
+  for (const legacy_transfer_details &ltd: transfers)
+  {
+    THROW_WALLET_EXCEPTION_IF(ltd.m_tx.vout.size() <= ltd.m_internal_output_index, error::wallet_internal_error,
+        "m_internal_output_index = " + std::to_string(ltd.m_internal_output_index) +
+        " is greater or equal to outputs count = " + std::to_string(ltd.m_tx.vout.size()));
+    m_transfers.push_back(boost::value_initialized<transfer_details>());
+    transfer_details &td = m_transfers.back();
+    td.m_block_height = ltd.m_block_height;
+    td.m_internal_output_index = ltd.m_internal_output_index;
+    td.m_global_output_index = ltd.m_global_output_index;
+    td.m_spent = ltd.m_spent;
+    td.m_key_image = ltd.m_key_image;
+    add_transfer(td, ltd.m_tx, get_transaction_hash(ltd.m_tx), get_tx_pub_key_from_extra(ltd.m_tx));
+  }
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height) const
 {
-  auto range = m_payments.equal_range(payment_id);
-  std::for_each(range.first, range.second, [&payments, &min_height](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height)
-    {
-      payments.push_back(x.second);
-    }
-  });
+  auto it = m_payments_by_id.find(payment_id);
+  if (it == m_payments_by_id.end())
+    return;
+  for (auto i = it->second.upper_bound(min_height); i != it->second.end(); ++i)
+    payments.push_back(i->second->second);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height) const
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height)
+  if (min_height >= max_height)
+    return;
+  auto end = m_payments_by_height.upper_bound(max_height);
+  for (auto i = m_payments_by_height.upper_bound(min_height); i != end; ++i)
+    payments.push_back(*i->second);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_payments(const std::vector<crypto::hash>& payment_ids, std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, size_t max_count) const
+{
+  typedef std::pair<payment_height_index::const_iterator, payment_height_index::const_iterator> range_t;
+  std::vector<range_t> ranges;
+  if (payment_ids.empty())
+  {
+    ranges.push_back(std::make_pair(m_payments_by_height.upper_bound(min_height), m_payments_by_height.end()));
+  }
+  else
+  {
+    for (const auto &payment_id: payment_ids)
     {
-      payments.push_back(x);
+      auto it = m_payments_by_id.find(payment_id);
+      if (it != m_payments_by_id.end())
+        ranges.push_back(std::make_pair(it->second.upper_bound(min_height), it->second.end()));
     }
-  });
+  }
+  ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const range_t &r) { return r.first == r.second; }), ranges.end());
+
+  // merge the per payment id ranges by height, lowest first
+  auto higher = [](const range_t &a, const range_t &b) { return a.first->first > b.first->first; };
+  std::make_heap(ranges.begin(), ranges.end(), higher);
+  size_t count = 0;
+  uint64_t last_height = 0;
+  while (!ranges.empty())
+  {
+    std::pop_heap(ranges.begin(), ranges.end(), higher);
+    range_t &r = ranges.back();
+    const uint64_t height = r.first->first;
+    if (max_count && count >= max_count && height != last_height)
+      return true;
+    payments.push_back(*r.first->second);
+    ++count;
+    last_height = height;
+    if (++r.first == r.second)
+      ranges.pop_back();
+    else
+      std::push_heap(ranges.begin(), ranges.end(), higher);
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_payment(const crypto::hash &payment_id, const payment_details &payment)
+{
+  const payment_container::value_type *p = &*m_payments.emplace(payment_id, payment);
+  m_payments_by_height.emplace(payment.m_block_height, p);
+  m_payments_by_id[payment_id].emplace(payment.m_block_height, p);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_payment_indices()
+{
+  m_payments_by_height.clear();
+  m_payments_by_id.clear();
+  for (const auto &p: m_payments)
+  {
+    m_payments_by_height.emplace(p.second.m_block_height, &p);
+    m_payments_by_id[p.first].emplace(p.second.m_block_height, &p);
+  }
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
@@ -1877,9 +2197,7 @@ void wallet2::rescan_spent()
   COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
   COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
   req.key_images = key_images;
-  m_daemon_rpc_mutex.lock();
-  bool r = epee::net_utils::invoke_http_json_remote_command2(m_daemon_address + "/is_key_image_spent", req, daemon_resp, m_http_client, 200000);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/is_key_image_spent", req, daemon_resp, 200000);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
   THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
   THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::is_key_image_spent_error, daemon_resp.status);
@@ -1901,7 +2219,7 @@ void wallet2::rescan_spent()
       {
         LOG_PRINT_L0("Marking output " << i << "(" << td.m_key_image << ") as spent, it was marked as unspent");
       }
-      td.m_spent = daemon_resp.spent_status[i] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
+      set_spent(i, daemon_resp.spent_status[i] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
     }
   }
 }
@@ -1920,9 +2238,72 @@ void wallet2::rescan_blockchain(bool refresh)
     this->refresh();
 }
 //----------------------------------------------------------------------------------------------------
+uint64_t wallet2::get_transfer_unlock_height(const transfer_details& td) const
+{
+  uint64_t height = td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+  const uint64_t unlock_time = td.m_unlock_time;
+  if (unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && unlock_time + 1 > CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+    height = std::max<uint64_t>(height, unlock_time + 1 - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  return height;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_unspent(size_t idx)
+{
+  const transfer_details& td = m_transfers[idx];
+  m_unspent_balance += td.amount();
+  m_unspent_by_amount.emplace(td.amount(), idx);
+  m_unspent_by_unlock_height.emplace(get_transfer_unlock_height(td), idx);
+  if (td.m_unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER)
+    m_unspent_time_locked.insert(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_unspent(size_t idx)
+{
+  const transfer_details& td = m_transfers[idx];
+  auto erase = [idx](transfer_index &index, uint64_t key) {
+    auto range = index.equal_range(key);
+    for (auto i = range.first; i != range.second; ++i)
+    {
+      if (i->second == idx)
+      {
+        index.erase(i);
+        return true;
+      }
+    }
+    return false;
+  };
+  THROW_WALLET_EXCEPTION_IF(!erase(m_unspent_by_amount, td.amount()), error::wallet_internal_error, "unspent transfer not found in index");
+  erase(m_unspent_by_unlock_height, get_transfer_unlock_height(td));
+  m_unspent_time_locked.erase(idx);
+  m_unspent_balance -= td.amount();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::set_spent(size_t idx, bool spent)
+{
+  transfer_details& td = m_transfers[idx];
+  if (td.m_spent == spent)
+    return;
+  if (spent)
+    remove_unspent(idx);
+  td.m_spent = spent;
+  if (!spent)
+    add_unspent(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_unspent_indices()
+{
+  m_unspent_balance = 0;
+  m_unspent_by_amount.clear();
+  m_unspent_by_unlock_height.clear();
+  m_unspent_time_locked.clear();
+  for (size_t idx = 0; idx < m_transfers.size(); ++idx)
+    if (!m_transfers[idx].m_spent)
+      add_unspent(idx);
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(const transfer_details& td) const
 {
-  if(!is_tx_spendtime_unlocked(td.m_tx.unlock_time, td.m_block_height))
+  if(!is_tx_spendtime_unlocked(td.m_unlock_time, td.m_block_height))
     return false;
 
   if(td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > m_blockchain.size())
@@ -2180,9 +2561,7 @@ void wallet2::commit_tx(pending_tx& ptx)
   req.tx_as_hex = epee::string_tools::buff_to_hex_nodelimer(tx_to_blob(ptx.tx));
   req.do_not_relay = false;
   COMMAND_RPC_SEND_RAW_TX::response daemon_send_resp;
-  m_daemon_rpc_mutex.lock();
-  bool r = epee::net_utils::invoke_http_json_remote_command2(m_daemon_address + "/sendrawtransaction", req, daemon_send_resp, m_http_client, 200000);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/sendrawtransaction", req, daemon_send_resp, 200000);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "sendrawtransaction");
   THROW_WALLET_EXCEPTION_IF(daemon_send_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "sendrawtransaction");
   THROW_WALLET_EXCEPTION_IF(daemon_send_resp.status != CORE_RPC_STATUS_OK, error::tx_rejected, ptx.tx, daemon_send_resp.status, daemon_send_resp.reason);
@@ -2202,7 +2581,7 @@ void wallet2::commit_tx(pending_tx& ptx)
   LOG_PRINT_L2("transaction " << txid << " generated ok and sent to daemon, key_images: [" << ptx.key_images << "]");
 
   BOOST_FOREACH(transfer_container::iterator it, ptx.selected_transfers)
-    it->m_spent = true;
+    set_spent(it - m_transfers.begin(), true);
 
   //fee includes dust if dust policy specified it.
   LOG_PRINT_L0("Transaction successfully sent. <" << txid << ">" << ENDL
@@ -2232,6 +2611,18 @@ uint64_t wallet2::sanitize_fee_multiplier(uint64_t fee_multiplier) const
   return 1;
 }
 
+//----------------------------------------------------------------------------------------------------
+const crypto::public_key_precomp &wallet2::get_spend_public_key_precomp()
+{
+  const crypto::public_key &spend_public_key = m_account.get_keys().m_account_address.m_spend_public_key;
+  if (m_precomp_spend_public_key != spend_public_key)
+  {
+    THROW_WALLET_EXCEPTION_IF(!crypto::precompute_public_key(spend_public_key, m_spend_public_key_precomp),
+      error::wallet_internal_error, "Invalid spend public key");
+    m_precomp_spend_public_key = spend_public_key;
+  }
+  return m_spend_public_key_precomp;
+}
 //----------------------------------------------------------------------------------------------------
 // separated the call(s) to wallet2::transfer into their own function
 //
@@ -2280,7 +2671,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<crypto
 
         // mark transfers to be used as "spent"
         BOOST_FOREACH(transfer_container::iterator it, ptx.selected_transfers)
-          it->m_spent = true;
+          set_spent(it - m_transfers.begin(), true);
       }
 
       // if we made it this far, we've selected our transactions.  committing them will mark them spent,
@@ -2290,7 +2681,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<crypto
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -2307,7 +2698,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<crypto
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -2325,7 +2716,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions(std::vector<crypto
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -2372,15 +2763,13 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
     // get histogram for the amounts we need
     epee::json_rpc::request<cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request> req_t = AUTO_VAL_INIT(req_t);
     epee::json_rpc::response<cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response, std::string> resp_t = AUTO_VAL_INIT(resp_t);
-    m_daemon_rpc_mutex.lock();
     req_t.jsonrpc = "2.0";
     req_t.id = epee::serialization::storage_entry(0);
     req_t.method = "get_output_histogram";
     for(auto it: selected_transfers)
       req_t.params.amounts.push_back(it->amount());
     req_t.params.unlocked = true;
-    bool r = net_utils::invoke_http_json_remote_command2(m_daemon_address + "/json_rpc", req_t, resp_t, m_http_client);
-    m_daemon_rpc_mutex.unlock();
+    bool r = m_daemon_connections.invoke_json(m_daemon_address + "/json_rpc", req_t, resp_t);
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
     THROW_WALLET_EXCEPTION_IF(resp_t.result.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_histogram");
     THROW_WALLET_EXCEPTION_IF(resp_t.result.status != CORE_RPC_STATUS_OK, error::get_histogram_error, resp_t.result.status);
@@ -2458,9 +2847,7 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
     }
 
     // get the keys for those
-    m_daemon_rpc_mutex.lock();
-    r = epee::net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_outs.bin", req, daemon_resp, m_http_client, 200000);
-    m_daemon_rpc_mutex.unlock();
+    r = m_daemon_connections.invoke_bin(m_daemon_address + "/get_outs.bin", req, daemon_resp, 200000);
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::get_random_outs_error, daemon_resp.status);
@@ -2477,7 +2864,7 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
       outs.back().reserve(fake_outputs_count + 1);
 
       // pick real out first (it will be sorted when done)
-      outs.back().push_back({it->m_global_output_index, boost::get<txout_to_key>(it->m_tx.vout[it->m_internal_output_index].target).key});
+      outs.back().push_back({it->m_global_output_index, it->m_output_key});
 
       // then pick others in random order till we reach the required number
       // since we use an equiprobable pick here, we don't upset the triangular distribution
@@ -2525,7 +2912,7 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
     for (transfer_container::iterator it: selected_transfers)
     {
       std::vector<entry> v;
-      v.push_back({it->m_global_output_index, boost::get<txout_to_key>(it->m_tx.vout[it->m_internal_output_index].target).key});
+      v.push_back({it->m_global_output_index, it->m_output_key});
       outs.push_back(v);
     }
   }
@@ -2561,9 +2948,9 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
 
     tx_output_entry real_oe;
     real_oe.first = td.m_global_output_index;
-    real_oe.second = boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key;
+    real_oe.second = td.m_output_key;
     *it_to_replace = real_oe;
-    src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx);
+    src.real_out_tx_key = td.m_tx_pub_key;
     src.real_output = it_to_replace - src.outputs.begin();
     src.real_output_in_tx_index = td.m_internal_output_index;
     detail::print_source_entry(src);
@@ -2683,16 +3070,12 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   THROW_WALLET_EXCEPTION_IF(needed_money == 0, error::zero_destination);
 
   // gather all our dust and non dust outputs
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i: select_available_outputs([](const transfer_details&) { return true; }))
   {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && is_transfer_unlocked(td))
-    {
-      if (is_valid_decomposed_amount(td.amount()))
-        unused_transfers_indices.push_back(i);
-      else
-        unused_dust_indices.push_back(i);
-    }
+    if (is_valid_decomposed_amount(m_transfers[i].amount()))
+      unused_transfers_indices.push_back(i);
+    else
+      unused_dust_indices.push_back(i);
   }
   LOG_PRINT_L2("Starting with " << unused_transfers_indices.size() << " non-dust outputs and " << unused_dust_indices.size() << " dust outputs");
 
@@ -2881,16 +3264,12 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(const cryptono
   fee_multiplier = sanitize_fee_multiplier(fee_multiplier);
 
   // gather all our dust and non dust outputs
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i: select_available_outputs([](const transfer_details&) { return true; }))
   {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && is_transfer_unlocked(td))
-    {
-      if (is_valid_decomposed_amount(td.amount()))
-        unused_transfers_indices.push_back(i);
-      else
-        unused_dust_indices.push_back(i);
-    }
+    if (is_valid_decomposed_amount(m_transfers[i].amount()))
+      unused_transfers_indices.push_back(i);
+    else
+      unused_dust_indices.push_back(i);
   }
   LOG_PRINT_L2("Starting with " << unused_transfers_indices.size() << " non-dust outputs and " << unused_dust_indices.size() << " dust outputs");
 
@@ -2994,11 +3373,11 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(const cryptono
 uint64_t wallet2::unlocked_dust_balance(const tx_dust_policy &dust_policy) const
 {
   uint64_t money = 0;
-  std::list<transfer_container::iterator> selected_transfers;
-  for (transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i)
+  const auto end = m_unspent_by_amount.lower_bound(dust_policy.dust_threshold);
+  for (auto i = m_unspent_by_amount.begin(); i != end; ++i)
   {
-    const transfer_details& td = *i;
-    if (!td.m_spent && td.amount() < dust_policy.dust_threshold && is_transfer_unlocked(td))
+    const transfer_details& td = m_transfers[i->second];
+    if (is_transfer_unlocked(td))
     {
       money += td.amount();
     }
@@ -3065,9 +3444,9 @@ void wallet2::transfer_from(const std::vector<size_t> &outs, size_t num_outputs,
     });
     tx_output_entry real_oe;
     real_oe.first = td.m_global_output_index;
-    real_oe.second = boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key;
+    real_oe.second = td.m_output_key;
     auto interted_it = src.outputs.insert(it_to_insert, real_oe);
-    src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx);
+    src.real_out_tx_key = td.m_tx_pub_key;
     src.real_output = interted_it - src.outputs.begin();
     src.real_output_in_tx_index = td.m_internal_output_index;
     detail::print_source_entry(src);
@@ -3120,20 +3499,16 @@ bool wallet2::use_fork_rules(uint8_t version)
   epee::json_rpc::request<cryptonote::COMMAND_RPC_HARD_FORK_INFO::request> req_t = AUTO_VAL_INIT(req_t);
   epee::json_rpc::response<cryptonote::COMMAND_RPC_HARD_FORK_INFO::response, std::string> resp_t = AUTO_VAL_INIT(resp_t);
 
-  m_daemon_rpc_mutex.lock();
-  bool r = net_utils::invoke_http_json_remote_command2(m_daemon_address + "/getheight", req, res, m_http_client);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/getheight", req, res);
   CHECK_AND_ASSERT_MES(r, false, "Failed to connect to daemon");
   CHECK_AND_ASSERT_MES(res.status != CORE_RPC_STATUS_BUSY, false, "Failed to connect to daemon");
   CHECK_AND_ASSERT_MES(res.status == CORE_RPC_STATUS_OK, false, "Failed to get current blockchain height");
 
-  m_daemon_rpc_mutex.lock();
   req_t.jsonrpc = "2.0";
   req_t.id = epee::serialization::storage_entry(0);
   req_t.method = "hard_fork_info";
   req_t.params.version = version;
-  r = net_utils::invoke_http_json_remote_command2(m_daemon_address + "/json_rpc", req_t, resp_t, m_http_client);
-  m_daemon_rpc_mutex.unlock();
+  r = m_daemon_connections.invoke_json(m_daemon_address + "/json_rpc", req_t, resp_t);
   CHECK_AND_ASSERT_MES(r, false, "Failed to connect to daemon");
   CHECK_AND_ASSERT_MES(resp_t.result.status != CORE_RPC_STATUS_BUSY, false, "Failed to connect to daemon");
   CHECK_AND_ASSERT_MES(resp_t.result.status == CORE_RPC_STATUS_OK, false, "Failed to get hard fork status");
@@ -3157,32 +3532,25 @@ uint64_t wallet2::get_upper_tranaction_size_limit()
 std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(const transfer_details &td)> &f)
 {
   std::vector<size_t> outputs;
-  size_t n = 0;
-  for (transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i, ++n)
+  const auto end = m_unspent_by_unlock_height.upper_bound(m_blockchain.size());
+  for (auto i = m_unspent_by_unlock_height.begin(); i != end; ++i)
   {
-    if (i->m_spent)
+    const transfer_details &td = m_transfers[i->second];
+    if (!is_transfer_unlocked(td))
       continue;
-    if (!is_transfer_unlocked(*i))
-      continue;
-    if (f(*i))
-      outputs.push_back(n);
+    if (f(td))
+      outputs.push_back(i->second);
   }
+  std::sort(outputs.begin(), outputs.end());
   return outputs;
 }
 //----------------------------------------------------------------------------------------------------
 std::vector<uint64_t> wallet2::get_unspent_amounts_vector()
 {
-  std::set<uint64_t> set;
-  for (const auto &td: m_transfers)
-  {
-    if (!td.m_spent)
-      set.insert(td.amount());
-  }
   std::vector<uint64_t> vector;
-  vector.reserve(set.size());
-  for (const auto &i: set)
+  for (auto i = m_unspent_by_amount.begin(); i != m_unspent_by_amount.end(); i = m_unspent_by_amount.upper_bound(i->first))
   {
-    vector.push_back(i);
+    vector.push_back(i->first);
   }
   return vector;
 }
@@ -3191,7 +3559,6 @@ std::vector<size_t> wallet2::select_available_outputs_from_histogram(uint64_t co
 {
   epee::json_rpc::request<cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request> req_t = AUTO_VAL_INIT(req_t);
   epee::json_rpc::response<cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response, std::string> resp_t = AUTO_VAL_INIT(resp_t);
-  m_daemon_rpc_mutex.lock();
   req_t.jsonrpc = "2.0";
   req_t.id = epee::serialization::storage_entry(0);
   req_t.method = "get_output_histogram";
@@ -3200,8 +3567,7 @@ std::vector<size_t> wallet2::select_available_outputs_from_histogram(uint64_t co
   req_t.params.min_count = count;
   req_t.params.max_count = 0;
   req_t.params.unlocked = unlocked;
-  bool r = net_utils::invoke_http_json_remote_command2(m_daemon_address + "/json_rpc", req_t, resp_t, m_http_client);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/json_rpc", req_t, resp_t);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "select_available_unmixable_outputs");
   THROW_WALLET_EXCEPTION_IF(resp_t.result.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_histogram");
   THROW_WALLET_EXCEPTION_IF(resp_t.result.status != CORE_RPC_STATUS_OK, error::get_histogram_error, resp_t.result.status);
@@ -3290,7 +3656,7 @@ std::vector<wallet2::pending_tx> wallet2::create_unmixable_sweep_transactions(bo
 
         // mark transfers to be used as "spent"
         BOOST_FOREACH(transfer_container::iterator it, ptx.selected_transfers)
-          it->m_spent = true;
+          set_spent(it - m_transfers.begin(), true);
       }
 
       // if we made it this far, we've selected our transactions.  committing them will mark them spent,
@@ -3300,7 +3666,7 @@ std::vector<wallet2::pending_tx> wallet2::create_unmixable_sweep_transactions(bo
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -3317,7 +3683,7 @@ std::vector<wallet2::pending_tx> wallet2::create_unmixable_sweep_transactions(bo
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -3335,7 +3701,7 @@ std::vector<wallet2::pending_tx> wallet2::create_unmixable_sweep_transactions(bo
       {
         // mark transfers to be used as not spent
         BOOST_FOREACH(transfer_container::iterator it2, ptx.selected_transfers)
-          it2->m_spent = false;
+          set_spent(it2 - m_transfers.begin(), false);
 
       }
 
@@ -3427,22 +3793,10 @@ std::vector<std::pair<crypto::key_image, crypto::signature>> wallet2::export_key
     crypto::cn_fast_hash(&td.m_key_image, sizeof(td.m_key_image), hash);
 
     // get ephemeral public key
-    const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
-    THROW_WALLET_EXCEPTION_IF(out.target.type() != typeid(txout_to_key), error::wallet_internal_error,
-        "Output is not txout_to_key");
-    const cryptonote::txout_to_key &o = boost::get<const cryptonote::txout_to_key>(out.target);
-    const crypto::public_key pkey = o.key;
+    const crypto::public_key &pkey = td.m_output_key;
 
     // get tx pub key
-    std::vector<tx_extra_field> tx_extra_fields;
-    if(!parse_tx_extra(td.m_tx.extra, tx_extra_fields))
-    {
-      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-    }
-    tx_extra_pub_key pub_key_field;
-    THROW_WALLET_EXCEPTION_IF(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field), error::wallet_internal_error,
-        "Public key wasn't found in the transaction extra");
-    crypto::public_key tx_pub_key = pub_key_field.pub_key;
+    const crypto::public_key &tx_pub_key = td.m_tx_pub_key;
 
     // generate ephemeral secret key
     crypto::key_image ki;
@@ -3487,11 +3841,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     const crypto::signature &signature = signed_key_images[n].second;
 
     // get ephemeral public key
-    const cryptonote::tx_out &out = td.m_tx.vout[td.m_internal_output_index];
-    THROW_WALLET_EXCEPTION_IF(out.target.type() != typeid(txout_to_key), error::wallet_internal_error,
-      "Non txout_to_key output found");
-    const cryptonote::txout_to_key &o = boost::get<cryptonote::txout_to_key>(out.target);
-    const crypto::public_key pkey = o.key;
+    const crypto::public_key &pkey = td.m_output_key;
 
     std::vector<const crypto::public_key*> pkeys;
     pkeys.push_back(&pkey);
@@ -3506,9 +3856,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
   for (size_t n = 0; n < signed_key_images.size(); ++n)
     m_transfers[n].m_key_image = signed_key_images[n].first;
 
-  m_daemon_rpc_mutex.lock();
-  bool r = epee::net_utils::invoke_http_json_remote_command2(m_daemon_address + "/is_key_image_spent", req, daemon_resp, m_http_client, 200000);
-  m_daemon_rpc_mutex.unlock();
+  bool r = m_daemon_connections.invoke_json(m_daemon_address + "/is_key_image_spent", req, daemon_resp, 200000);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
   THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
   THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::is_key_image_spent_error, daemon_resp.status);
@@ -3521,8 +3869,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
   for (size_t n = 0; n < daemon_resp.spent_status.size(); ++n)
   {
     transfer_details &td = m_transfers[n];
-    uint64_t amount = td.m_tx.vout[td.m_internal_output_index].amount;
-    td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
+    uint64_t amount = td.amount();
+    set_spent(n, daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
     if (td.m_spent)
       spent += amount;
     else
@@ -30,12 +30,18 @@
 
 #pragma once
 
+#include <deque>
+#include <map>
+#include <set>
 #include <memory>
+#include <boost/serialization/deque.hpp>
 #include <boost/serialization/list.hpp>
+#include <boost/serialization/map.hpp>
 #include <boost/serialization/vector.hpp>
 #include <atomic>
 
 #include "include_base_utils.h"
+#include "syncobj.h"
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/account_boost_serialization.h"
 #include "cryptonote_core/cryptonote_basic_impl.h"
@@ -48,9 +54,13 @@
 #include "crypto/hash.h"
 
 #include "wallet_errors.h"
+#include "daemon_connection_pool.h"
+#include "transfer_tx_store.h"
 
 #include <iostream>
 #define WALLET_RCP_CONNECTION_TIMEOUT                          200000
+#define WALLET_BLOCKCHAIN_RECENT_HASHES                        1000 // reorgs are detected within this many blocks
+#define WALLET_BLOCKCHAIN_SPARSE_HASHES_STEP                   1000 // one older hash kept per this many blocks
 
 namespace tools
 {
@@ -59,7 +69,7 @@ namespace tools
   public:
     virtual void on_new_block(uint64_t height, const cryptonote::block& block) {}
     virtual void on_money_received(uint64_t height, const cryptonote::transaction& tx, size_t out_index) {}
-    virtual void on_money_spent(uint64_t height, const cryptonote::transaction& in_tx, size_t out_index, const cryptonote::transaction& spend_tx) {}
+    virtual void on_money_spent(uint64_t height, const crypto::hash &in_txid, uint64_t amount, const cryptonote::transaction& spend_tx) {}
     virtual void on_skip_transaction(uint64_t height, const cryptonote::transaction& tx) {}
     virtual ~i_wallet2_callback() {}
   };
@@ -78,6 +88,47 @@ namespace tools
     }
   };
 
+  /*!
+   * \brief Block hashes the wallet has seen, indexed by height
+   *
+   * Only the most recent hashes are all kept, which is enough to detect
+   * reorgs. Older ones are kept one every WALLET_BLOCKCHAIN_SPARSE_HASHES_STEP
+   * blocks, starting with the genesis block, and serve as checkpoints for the
+   * short chain history sent to the daemon.
+   */
+  class hashchain
+  {
+  public:
+    hashchain(): m_offset(0) {}
+
+    size_t size() const { return m_offset + m_recent.size(); }
+    bool empty() const { return size() == 0; }
+    size_t offset() const { return m_offset; }
+    bool is_known(size_t height) const { return height < size() && (height >= m_offset || m_sparse.find(height) != m_sparse.end()); }
+    const crypto::hash &genesis() const { return (*this)[0]; }
+    const crypto::hash &operator[](size_t height) const;
+    void push_back(const crypto::hash &hash);
+    void crop(size_t height);
+    void clear();
+    void assign(const std::vector<crypto::hash> &hashes);
+    size_t get_nearest(size_t height, crypto::hash &hash) const;
+
+    template <class t_archive>
+    inline void serialize(t_archive &a, const unsigned int ver)
+    {
+      a & m_offset;
+      a & m_sparse;
+      a & m_recent;
+    }
+
+  private:
+    void trim();
+
+    uint64_t m_offset; // height of m_recent.front()
+    std::map<uint64_t, crypto::hash> m_sparse; // heights below m_offset
+    std::deque<crypto::hash> m_recent;
+  };
+
   class wallet2
   {
   public:
@@ -89,20 +140,36 @@ namespace tools
     };
 
   private:
-    wallet2(const wallet2&) : m_run(true), m_callback(0), m_testnet(false), m_always_confirm_transfers (false), m_store_tx_info(true), m_default_mixin(0), m_default_fee_multiplier(0), m_refresh_type(RefreshOptimizeCoinbase), m_auto_refresh(true), m_refresh_from_block_height(0) {}
+    wallet2(const wallet2&) : m_run(true), m_callback(0), m_testnet(false), m_always_confirm_transfers (false), m_store_tx_info(true), m_default_mixin(0), m_default_fee_multiplier(0), m_refresh_type(RefreshOptimizeCoinbase), m_auto_refresh(true), m_refresh_from_block_height(0), m_precomp_spend_public_key(cryptonote::null_pkey), m_pool_version(0), m_pool_delta_unsupported(false) {}
 
   public:
-    wallet2(bool testnet = false, bool restricted = false) : m_run(true), m_callback(0), m_testnet(testnet), m_restricted(restricted), is_old_file_format(false), m_store_tx_info(true), m_default_mixin(0), m_default_fee_multiplier(0), m_refresh_type(RefreshOptimizeCoinbase), m_auto_refresh(true), m_refresh_from_block_height(0) {}
+    wallet2(bool testnet = false, bool restricted = false) : m_local_bc_height(0), m_unspent_balance(0), m_run(true), m_callback(0), m_testnet(testnet), m_restricted(restricted), is_old_file_format(false), m_store_tx_info(true), m_default_mixin(0), m_default_fee_multiplier(0), m_refresh_type(RefreshOptimizeCoinbase), m_auto_refresh(true), m_refresh_from_block_height(0), m_precomp_spend_public_key(cryptonote::null_pkey), m_pool_version(0), m_pool_delta_unsupported(false) {}
+    // only what is needed to spend the output, the full tx is kept in m_transfer_txs
     struct transfer_details
     {
       uint64_t m_block_height;
-      cryptonote::transaction m_tx;
+      crypto::hash m_txid;
+      crypto::public_key m_tx_pub_key;
+      uint64_t m_unlock_time;
       size_t m_internal_output_index;
       uint64_t m_global_output_index;
+      uint64_t m_amount;
+      crypto::public_key m_output_key;
       bool m_spent;
-      crypto::key_image m_key_image; //TODO: key_image stored twice :(
+      crypto::key_image m_key_image;
 
-      uint64_t amount() const { return m_tx.vout[m_internal_output_index].amount; }
+      uint64_t amount() const { return m_amount; }
+    };
+
+    // cache format up to version 13, which stored the whole tx in each transfer
+    struct legacy_transfer_details
+    {
+      uint64_t m_block_height;
+      cryptonote::transaction m_tx;
+      size_t m_internal_output_index;
+      uint64_t m_global_output_index;
+      bool m_spent;
+      crypto::key_image m_key_image;
     };
 
     struct payment_details
@@ -141,7 +208,12 @@ namespace tools
     };
 
     typedef std::vector<transfer_details> transfer_container;
+    typedef std::multimap<uint64_t, size_t> transfer_index; // key -> index in m_transfers
     typedef std::unordered_multimap<crypto::hash, payment_details> payment_container;
+    // secondary indices into m_payments, not serialized: elements of an
+    // unordered container keep their address until erased
+    typedef std::multimap<uint64_t, const payment_container::value_type*> payment_height_index;
+    typedef std::unordered_map<crypto::hash, payment_height_index> payment_id_index;
 
     struct pending_tx
     {
@@ -297,9 +369,36 @@ namespace tools
     std::vector<wallet2::pending_tx> create_transactions_all(const cryptonote::account_public_address &address, const size_t fake_outs_count, const uint64_t unlock_time, uint64_t fee_multiplier, const std::vector<uint8_t> extra, bool trusted_daemon);
     std::vector<pending_tx> create_unmixable_sweep_transactions(bool trusted_daemon);
     bool check_connection(bool *same_version = NULL);
+    /*!
+     * \brief Number of persistent connections kept to the daemon, so that
+     *        refresh and transfer creation do not queue behind each other
+     */
+    void set_daemon_connections(size_t max_connections) { m_daemon_connections.set_max_connections(max_connections); }
+    size_t get_daemon_connections() const { return m_daemon_connections.get_max_connections(); }
+    //! Connection reuse and latency counters for daemon RPC
+    daemon_connection_stats get_daemon_connection_stats() const { return m_daemon_connections.get_stats(); }
+    void reset_daemon_connection_stats() { m_daemon_connections.reset_stats(); }
     void get_transfers(wallet2::transfer_container& incoming_transfers) const;
+    /*!
+     * \brief Gets the full transaction a transfer was received in, parsing it on demand
+     * \param txid  Hash of the transaction, as in transfer_details::m_txid
+     * \param tx    Output transaction
+     * \return      false if the transaction is not known to the wallet
+     */
+    bool get_transfer_tx(const crypto::hash &txid, cryptonote::transaction &tx) const;
+    size_t get_transfer_tx_size(const crypto::hash &txid) const;
     void get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height = 0) const;
     void get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height = (uint64_t)-1) const;
+    /*!
+     * \brief Gets a page of incoming payments, in block height order
+     * \param payment_ids   Payment ids to get payments for, or all payments if empty
+     * \param payments      Output list of payment id and payment pairs
+     * \param min_height    Only payments above this height are returned
+     * \param max_count     Stop after this many payments, 0 for no limit. All payments
+     *                      at the last height are returned, so the next page can start above it
+     * \return              True if there are more payments after the last returned height
+     */
+    bool get_payments(const std::vector<crypto::hash>& payment_ids, std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, size_t max_count) const;
     void get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
       uint64_t min_height, uint64_t max_height = (uint64_t)-1) const;
     void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments) const;
@@ -314,8 +413,26 @@ namespace tools
       uint64_t dummy_refresh_height = 0; // moved to keys file
       if(ver < 5)
         return;
-      a & m_blockchain;
-      a & m_transfers;
+      if(ver < 15)
+      {
+        std::vector<crypto::hash> blockchain;
+        a & blockchain;
+        m_blockchain.assign(blockchain);
+      }
+      else
+      {
+        a & m_blockchain;
+      }
+      if(ver < 14)
+      {
+        std::vector<legacy_transfer_details> transfers;
+        a & transfers;
+        import_legacy_transfers(transfers);
+      }
+      else
+      {
+        a & m_transfers;
+      }
       a & m_account_public_address;
       a & m_key_images;
       if(ver < 6)
@@ -339,6 +456,16 @@ namespace tools
       if(ver < 13)
         return;
       a & m_unconfirmed_payments;
+      if(ver < 14)
+        return;
+      if(ver < 16)
+      {
+        // the txs are kept in their own file since version 16
+        std::unordered_map<crypto::hash, cryptonote::blobdata> transfer_txs;
+        a & transfer_txs;
+        for (const auto &i: transfer_txs)
+          m_transfer_txs.add(i.first, i.second);
+      }
     }
 
     /*!
@@ -398,6 +525,31 @@ namespace tools
     uint64_t import_key_images(const std::vector<std::pair<crypto::key_image, crypto::signature>> &signed_key_images, uint64_t &spent, uint64_t &unspent);
 
     void update_pool_state();
+
+    /*!
+     * \brief A block and its transactions, parsed once so several wallets can process it
+     */
+    struct parsed_block
+    {
+      crypto::hash hash;
+      cryptonote::block block;
+      std::vector<cryptonote::transaction> txes;
+    };
+    static void parse_blocks(const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks);
+    /*!
+     * \brief Pulls the blocks following this wallet's chain from the daemon, and parses them
+     *
+     * A wallet restored at a height first fetches the block hashes up to it.
+     * \param blocks_start_height height of the first block pulled
+     * \param blocks              the blocks pulled
+     */
+    void pull_parsed_blocks(uint64_t &blocks_start_height, std::vector<parsed_block> &blocks);
+    /*!
+     * \brief Processes blocks starting at start_height, rolling back on a reorg
+     *
+     * Blocks starting above this wallet's chain are left alone.
+     */
+    void process_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &blocks, uint64_t& blocks_added);
   private:
     /*!
      * \brief  Stores wallet information to wallet file.
@@ -414,17 +566,21 @@ namespace tools
      */
     bool load_keys(const std::string& keys_file_name, const std::string& password);
     void process_new_transaction(const cryptonote::transaction& tx, uint64_t height, uint64_t ts, bool miner_tx, bool pool);
-    void process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const crypto::hash& bl_id, uint64_t height);
+    void get_pool_delta(cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res);
+    void get_full_pool(cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res);
+    void apply_pool_delta(const cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response &res, std::vector<size_t> &new_txes);
+    void process_pool_transaction(const crypto::hash &txid, const cryptonote::blobdata &blob);
+    void process_new_blockchain_entry(const parsed_block& pb, uint64_t height);
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids) const;
     bool is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t block_height) const;
     bool is_transfer_unlocked(const transfer_details& td) const;
     bool clear();
-    void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<cryptonote::block_complete_entry> &blocks);
-    void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<crypto::hash> &hashes);
+    void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks);
+    void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history);
-    void pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::list<cryptonote::block_complete_entry> &prev_blocks, std::list<cryptonote::block_complete_entry> &blocks, bool &error);
-    void process_blocks(uint64_t start_height, const std::list<cryptonote::block_complete_entry> &blocks, uint64_t& blocks_added);
+    void pull_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, std::vector<cryptonote::block_complete_entry> &blocks, bool &error);
+    void process_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, uint64_t& blocks_added);
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::list<transfer_container::iterator>& selected_transfers, bool trusted_daemon);
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const cryptonote::transaction& tx, uint64_t height);
@@ -434,18 +590,29 @@ namespace tools
     void check_genesis(const crypto::hash& genesis_hash) const; //throws
     bool generate_chacha8_key_from_secret_keys(crypto::chacha8_key &key) const;
     crypto::hash get_payment_id(const pending_tx &ptx) const;
-    void check_acc_out(const cryptonote::account_keys &acc, const cryptonote::tx_out &o, const crypto::public_key &tx_pub_key, size_t i, uint64_t &money_transfered, bool &error) const;
-    void parse_block_round(const cryptonote::blobdata &blob, cryptonote::block &bl, crypto::hash &bl_id, bool &error) const;
+    void check_acc_out(const crypto::public_key_precomp &spend_public_key, const cryptonote::tx_out &o, const crypto::key_derivation &derivation, size_t i, uint64_t &money_transfered, bool &error) const;
+    static void parse_block_round(const cryptonote::block_complete_entry &bche, parsed_block &pb, bool &error);
     uint64_t get_upper_tranaction_size_limit();
     std::vector<uint64_t> get_unspent_amounts_vector();
+    void add_payment(const crypto::hash &payment_id, const payment_details &payment);
+    uint64_t get_transfer_unlock_height(const transfer_details& td) const;
+    void add_unspent(size_t idx);
+    void remove_unspent(size_t idx);
+    void set_spent(size_t idx, bool spent);
+    void rebuild_unspent_indices();
+    void rebuild_payment_indices();
+    void add_transfer(transfer_details &td, const cryptonote::transaction &tx, const crypto::hash &txid, const crypto::public_key &tx_pub_key);
+    void rebuild_transfer_tx_refs();
+    void import_legacy_transfers(const std::vector<legacy_transfer_details> &transfers);
     uint64_t sanitize_fee_multiplier(uint64_t fee_multiplier) const;
+    const crypto::public_key_precomp &get_spend_public_key_precomp();
 
     cryptonote::account_base m_account;
     std::string m_daemon_address;
     std::string m_wallet_file;
     std::string m_keys_file;
-    epee::net_utils::http::http_simple_client m_http_client;
-    std::vector<crypto::hash> m_blockchain;
+    daemon_connection_pool m_daemon_connections;
+    hashchain m_blockchain;
     std::atomic<uint64_t> m_local_bc_height; //temporary workaround
     std::unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
     std::unordered_map<crypto::hash, confirmed_transfer_details> m_confirmed_txs;
@@ -453,7 +620,15 @@ namespace tools
     std::unordered_map<crypto::hash, crypto::secret_key> m_tx_keys;
 
     transfer_container m_transfers;
+    transfer_tx_store m_transfer_txs; // txs we received outputs in, read and parsed on demand
+    // unspent transfers, not serialized
+    uint64_t m_unspent_balance;
+    transfer_index m_unspent_by_amount;
+    transfer_index m_unspent_by_unlock_height; // chain height from which the transfer can be spent
+    std::set<size_t> m_unspent_time_locked; // also locked until some time
     payment_container m_payments;
+    payment_height_index m_payments_by_height;
+    payment_id_index m_payments_by_id;
     std::unordered_map<crypto::key_image, size_t> m_key_images;
     cryptonote::account_public_address m_account_public_address;
     std::unordered_map<crypto::hash, std::string> m_tx_notes;
@@ -461,8 +636,6 @@ namespace tools
 
     std::atomic<bool> m_run;
 
-    boost::mutex m_daemon_rpc_mutex;
-
     i_wallet2_callback* m_callback;
     bool m_testnet;
     bool m_restricted;
@@ -476,9 +649,22 @@ namespace tools
     RefreshType m_refresh_type;
     bool m_auto_refresh;
     uint64_t m_refresh_from_block_height;
+
+    // decompressed spend public key for scanning, recomputed when the account changes
+    crypto::public_key m_precomp_spend_public_key;
+    crypto::public_key_precomp m_spend_public_key_precomp;
+
+    // daemon pool version we last synced with, and the txes in the pool as of then, not serialized
+    uint64_t m_pool_version;
+    std::unordered_set<crypto::hash> m_pool_txids;
+    bool m_pool_delta_unsupported; // the daemon answered 404 to get_transaction_pool_delta.bin, not serialized
+
+    // held while blocks or the pool are processed, so a wallet_scanner and
+    // refresh() never work on the same wallet at once
+    epee::critical_section m_refresh_lock;
   };
 }
-BOOST_CLASS_VERSION(tools::wallet2, 13)
+BOOST_CLASS_VERSION(tools::wallet2, 16)
 BOOST_CLASS_VERSION(tools::wallet2::payment_details, 1)
 BOOST_CLASS_VERSION(tools::wallet2::unconfirmed_transfer_details, 3)
 BOOST_CLASS_VERSION(tools::wallet2::confirmed_transfer_details, 2)
@@ -489,6 +675,21 @@ namespace boost
   {
     template <class Archive>
     inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    {
+      a & x.m_block_height;
+      a & x.m_global_output_index;
+      a & x.m_internal_output_index;
+      a & x.m_txid;
+      a & x.m_tx_pub_key;
+      a & x.m_unlock_time;
+      a & x.m_amount;
+      a & x.m_output_key;
+      a & x.m_spent;
+      a & x.m_key_image;
+    }
+
+    template <class Archive>
+    inline void serialize(Archive &a, tools::wallet2::legacy_transfer_details &x, const boost::serialization::version_type ver)
     {
       a & x.m_block_height;
       a & x.m_global_output_index;
@@ -651,16 +852,9 @@ namespace tools
       COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req = AUTO_VAL_INIT(req);
       req.outs_count = fake_outputs_count + 1;// add one to make possible (if need) to skip real output key
       BOOST_FOREACH(transfer_container::iterator it, selected_transfers)
-      {
-        THROW_WALLET_EXCEPTION_IF(it->m_tx.vout.size() <= it->m_internal_output_index, error::wallet_internal_error,
-          "m_internal_output_index = " + std::to_string(it->m_internal_output_index) +
-          " is greater or equal to outputs count = " + std::to_string(it->m_tx.vout.size()));
         req.amounts.push_back(it->amount());
-      }
 
-      m_daemon_rpc_mutex.lock();
-      bool r = epee::net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/getrandom_outs.bin", req, daemon_resp, m_http_client, 200000);
-      m_daemon_rpc_mutex.unlock();
+      bool r = m_daemon_connections.invoke_bin(m_daemon_address + "/getrandom_outs.bin", req, daemon_resp, 200000);
       THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getrandom_outs.bin");
       THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getrandom_outs.bin");
       THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::get_random_outs_error, daemon_resp.status);
@@ -713,9 +907,9 @@ namespace tools
       //size_t real_index = src.outputs.size() ? (rand() % src.outputs.size() ):0;
       tx_output_entry real_oe;
       real_oe.first = td.m_global_output_index;
-      real_oe.second = boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key;
+      real_oe.second = td.m_output_key;
       auto interted_it = src.outputs.insert(it_to_insert, real_oe);
-      src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx);
+      src.real_out_tx_key = td.m_tx_pub_key;
       src.real_output = interted_it - src.outputs.begin();
       src.real_output_in_tx_index = td.m_internal_output_index;
       detail::print_source_entry(src);
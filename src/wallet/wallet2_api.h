@@ -123,6 +123,22 @@ struct WalletListener
 };
 
 
+/**
+ * @brief Counters for the wallet's requests to the daemon
+ */
+struct DaemonConnectionStats
+{
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t connects;          // new connections opened
+    uint64_t reused;            // requests sent over an already open connection
+    uint64_t waits;             // requests which waited for a free connection
+    uint64_t averageLatencyUs;
+    uint64_t maxLatencyUs;
+    uint64_t openConnections;
+};
+
+
 /**
  * @brief Interface for wallet operations.
  *        TODO: check if /include/IWallet.h is still actual
@@ -259,6 +275,17 @@ struct Wallet
      * \param arg
      */
     virtual void setDefaultMixin(uint32_t arg) = 0;
+    /*!
+     * \brief setDaemonConnections - sets how many persistent connections to the daemon
+     *                               may be used at once by refresh and transfers
+     * \param count
+     */
+    virtual void setDaemonConnections(uint32_t count) = 0;
+    /*!
+     * \brief daemonConnectionStats - connection reuse and latency counters for daemon requests
+     * \return
+     */
+    virtual DaemonConnectionStats daemonConnectionStats() const = 0;
 };
 
 /**
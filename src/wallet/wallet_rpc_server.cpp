@@ -585,25 +585,8 @@ namespace tools
     res.payments.clear();
 
     /* If the payment ID list is empty, we get payments to any payment ID (or lack thereof) */
-    if (req.payment_ids.empty())
-    {
-      std::list<std::pair<crypto::hash,wallet2::payment_details>> payment_list;
-      m_wallet.get_payments(payment_list, req.min_block_height);
-
-      for (auto & payment : payment_list)
-      {
-        wallet_rpc::payment_details rpc_payment;
-        rpc_payment.payment_id   = epee::string_tools::pod_to_hex(payment.first);
-        rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.second.m_tx_hash);
-        rpc_payment.amount       = payment.second.m_amount;
-        rpc_payment.block_height = payment.second.m_block_height;
-        rpc_payment.unlock_time  = payment.second.m_unlock_time;
-        res.payments.push_back(std::move(rpc_payment));
-      }
-
-      return true;
-    }
-
+    std::vector<crypto::hash> payment_ids;
+    std::unordered_map<crypto::hash, std::string> payment_id_strs;
     for (auto & payment_id_str : req.payment_ids)
     {
       crypto::hash payment_id;
@@ -636,19 +619,24 @@ namespace tools
         return false;
       }
 
-      std::list<wallet2::payment_details> payment_list;
-      m_wallet.get_payments(payment_id, payment_list, req.min_block_height);
+      if (payment_id_strs.emplace(payment_id, payment_id_str).second)
+        payment_ids.push_back(payment_id);
+    }
 
-      for (auto & payment : payment_list)
-      {
-        wallet_rpc::payment_details rpc_payment;
-        rpc_payment.payment_id   = payment_id_str;
-        rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.m_tx_hash);
-        rpc_payment.amount       = payment.m_amount;
-        rpc_payment.block_height = payment.m_block_height;
-        rpc_payment.unlock_time  = payment.m_unlock_time;
-        res.payments.push_back(std::move(rpc_payment));
-      }
+    std::list<std::pair<crypto::hash,wallet2::payment_details>> payment_list;
+    res.more = m_wallet.get_payments(payment_ids, payment_list, req.min_block_height, req.max_count);
+    res.next_min_block_height = payment_list.empty() ? req.min_block_height : payment_list.back().second.m_block_height;
+
+    for (auto & payment : payment_list)
+    {
+      wallet_rpc::payment_details rpc_payment;
+      auto i = payment_id_strs.find(payment.first);
+      rpc_payment.payment_id   = i == payment_id_strs.end() ? epee::string_tools::pod_to_hex(payment.first) : i->second;
+      rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.second.m_tx_hash);
+      rpc_payment.amount       = payment.second.m_amount;
+      rpc_payment.block_height = payment.second.m_block_height;
+      rpc_payment.unlock_time  = payment.second.m_unlock_time;
+      res.payments.push_back(std::move(rpc_payment));
     }
 
     return true;
@@ -688,13 +676,12 @@ namespace tools
         {
           transfers_found = true;
         }
-        auto txBlob = t_serializable_object_to_blob(td.m_tx);
         wallet_rpc::transfer_details rpc_transfers;
         rpc_transfers.amount       = td.amount();
         rpc_transfers.spent        = td.m_spent;
         rpc_transfers.global_index = td.m_global_output_index;
-        rpc_transfers.tx_hash      = epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(td.m_tx));
-        rpc_transfers.tx_size      = txBlob.size();
+        rpc_transfers.tx_hash      = epee::string_tools::pod_to_hex(td.m_txid);
+        rpc_transfers.tx_size      = m_wallet.get_transfer_tx_size(td.m_txid);
         res.transfers.push_back(rpc_transfers);
       }
     }
@@ -296,19 +296,25 @@ namespace wallet_rpc
     {
       std::vector<std::string> payment_ids;
       uint64_t min_block_height;
+      uint64_t max_count; // 0 for all payments
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(payment_ids)
         KV_SERIALIZE(min_block_height)
+        KV_SERIALIZE(max_count)
       END_KV_SERIALIZE_MAP()
     };
 
     struct response
     {
       std::list<payment_details> payments;
+      bool more; // if set, pass next_min_block_height as min_block_height to get the next page
+      uint64_t next_min_block_height;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(payments)
+        KV_SERIALIZE(more)
+        KV_SERIALIZE(next_min_block_height)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -0,0 +1,137 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <boost/thread/lock_guard.hpp>
+
+#include "wallet_scanner.h"
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+void wallet_scanner::add_wallet(wallet2 *wallet)
+{
+  boost::lock_guard<boost::mutex> lock(m_wallets_lock);
+  THROW_WALLET_EXCEPTION_IF(!m_wallets.empty() && m_wallets.front()->get_daemon_address() != wallet->get_daemon_address(),
+    error::wallet_internal_error, "All scanned wallets must use the same daemon");
+  if (std::find(m_wallets.begin(), m_wallets.end(), wallet) == m_wallets.end())
+    m_wallets.push_back(wallet);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_scanner::remove_wallet(wallet2 *wallet)
+{
+  boost::lock_guard<boost::mutex> lock(m_wallets_lock);
+  m_wallets.erase(std::remove(m_wallets.begin(), m_wallets.end(), wallet), m_wallets.end());
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet_scanner::wallet_count() const
+{
+  boost::lock_guard<boost::mutex> lock(m_wallets_lock);
+  return m_wallets.size();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet_scanner::refresh_step(const std::vector<wallet2*> &wallets, uint64_t &blocks_added)
+{
+  blocks_added = 0;
+  wallet2 *lowest = *std::min_element(wallets.begin(), wallets.end(),
+    [](const wallet2 *a, const wallet2 *b) { return a->get_blockchain_current_height() < b->get_blockchain_current_height(); });
+
+  const uint64_t lowest_height = lowest->get_blockchain_current_height();
+  uint64_t blocks_start_height;
+  std::vector<wallet2::parsed_block> parsed_blocks;
+  lowest->pull_parsed_blocks(blocks_start_height, parsed_blocks);
+
+  // a wallet restored at a height may have skipped ahead of the others
+  // while pulling, they catch up on the next step
+  bool added = lowest->get_blockchain_current_height() != lowest_height;
+  for (wallet2 *wallet: wallets)
+  {
+    uint64_t wallet_blocks_added = 0;
+    wallet->process_parsed_blocks(blocks_start_height, parsed_blocks, wallet_blocks_added);
+    if (wallet == lowest)
+      blocks_added = wallet_blocks_added;
+    added |= wallet_blocks_added > 0;
+  }
+  return added;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_scanner::refresh(uint64_t &blocks_fetched)
+{
+  blocks_fetched = 0;
+  std::vector<wallet2*> wallets;
+  {
+    boost::lock_guard<boost::mutex> lock(m_wallets_lock);
+    wallets = m_wallets;
+  }
+  if (wallets.empty())
+    return;
+
+  m_run.store(true, std::memory_order_relaxed);
+  size_t try_count = 0;
+  while (m_run.load(std::memory_order_relaxed))
+  {
+    try
+    {
+      uint64_t blocks_added = 0;
+      bool added = refresh_step(wallets, blocks_added);
+      blocks_fetched += blocks_added;
+      if (!added)
+        break;
+    }
+    catch (const std::exception&)
+    {
+      if (try_count < 3)
+      {
+        LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
+        ++try_count;
+      }
+      else
+      {
+        LOG_ERROR("pull_blocks failed, try_count=" << try_count);
+        throw;
+      }
+    }
+  }
+
+  for (wallet2 *wallet: wallets)
+  {
+    try
+    {
+      wallet->update_pool_state();
+    }
+    catch (...)
+    {
+      LOG_PRINT_L1("Failed to check pending transactions");
+    }
+  }
+
+  LOG_PRINT_L1("Scan done for " << wallets.size() << " wallets, blocks received: " << blocks_fetched);
+}
+//----------------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "wallet2.h"
+
+namespace tools
+{
+  /*!
+   * \brief Refreshes many wallets with a single pass over the blockchain
+   *
+   * Each batch of blocks is downloaded from the daemon and parsed once, then
+   * handed to every wallet, which only does its own account work on it: one
+   * key derivation per tx public key, then output and key image matching.
+   * The least synced wallet drives the download; wallets ahead of it see
+   * blocks they already have until it catches up.
+   *
+   * The wallets are only driven through their own locked calls, so they may
+   * be refreshed on their own at the same time. All of them must use the
+   * same daemon.
+   */
+  class wallet_scanner
+  {
+  public:
+    wallet_scanner(): m_run(true) {}
+
+    void add_wallet(wallet2 *wallet);
+    void remove_wallet(wallet2 *wallet);
+    size_t wallet_count() const;
+
+    /*!
+     * \brief Refreshes all wallets up to the daemon's top block
+     * \param blocks_fetched number of new blocks for the least synced wallet
+     */
+    void refresh(uint64_t &blocks_fetched);
+    void stop() { m_run.store(false, std::memory_order_relaxed); }
+
+  private:
+    bool refresh_step(const std::vector<wallet2*> &wallets, uint64_t &blocks_added);
+
+    mutable boost::mutex m_wallets_lock;
+    std::vector<wallet2*> m_wallets;
+    std::atomic<bool> m_run;
+  };
+}
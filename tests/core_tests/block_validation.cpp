@@ -142,6 +142,57 @@ bool gen_block_ts_in_future::generate(std::vector<test_event_entry>& events) con
   return true;
 }
 
+bool gen_block_ts_alt_chain_median::generate(std::vector<test_event_entry>& events) const
+{
+  BLOCK_VALIDATION_INIT_GENERATE();
+  GENERATE_ACCOUNT(alt_miner_account);
+  REWIND_BLOCKS_N(events, blk_0r, blk_0, miner_account, 2 * BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW);
+
+  // an alternate chain longer than the timestamp window, whose first
+  // blocks are much older than the rest
+  const size_t old_count = BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW / 6;
+  std::vector<uint64_t> timestamps;
+  block blk_prev = blk_0;
+  for (size_t i = 0; i < old_count + BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW; ++i)
+  {
+    uint64_t timestamp = blk_prev.timestamp + DIFFICULTY_BLOCKS_ESTIMATE_TIMESPAN;
+    if (i == old_count)
+      timestamp += 100000;
+    block blk;
+    if (!generator.construct_block_manually(blk, blk_prev, alt_miner_account, test_generator::bf_timestamp, 0, 0, timestamp))
+      return false;
+    events.push_back(blk);
+    timestamps.push_back(timestamp);
+    blk_prev = blk;
+  }
+
+  // below the median of the last BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW blocks,
+  // but not below the median of the whole alternate chain, which is what
+  // an alternate block is checked against
+  std::vector<uint64_t> recent(timestamps.end() - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW, timestamps.end());
+  uint64_t timestamp = misc_utils::median(recent) - 1;
+  if (timestamp < misc_utils::median(timestamps))
+    return false;
+
+  block blk_1;
+  generator.construct_block_manually(blk_1, blk_prev, alt_miner_account, test_generator::bf_timestamp, 0, 0, timestamp);
+  events.push_back(blk_1);
+
+  DO_CALLBACK(events, "check_block_accepted_as_alternative");
+
+  return true;
+}
+
+bool gen_block_ts_alt_chain_median::check_block_accepted_as_alternative(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_block_ts_alt_chain_median::check_block_accepted_as_alternative");
+
+  CHECK_EQ(2 * BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW + 1, c.get_current_blockchain_height());
+  CHECK_EQ(BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW / 6 + BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW + 1, c.get_alternative_blocks_count());
+
+  return true;
+}
+
 bool gen_block_invalid_prev_id::generate(std::vector<test_event_entry>& events) const
 {
   BLOCK_VALIDATION_INIT_GENERATE();
@@ -104,6 +104,17 @@ struct gen_block_ts_in_future : public gen_block_verification_base<1>
   bool generate(std::vector<test_event_entry>& events) const;
 };
 
+struct gen_block_ts_alt_chain_median : public test_chain_unit_base
+{
+  gen_block_ts_alt_chain_median()
+  {
+    REGISTER_CALLBACK_METHOD(gen_block_ts_alt_chain_median, check_block_accepted_as_alternative);
+  }
+
+  bool generate(std::vector<test_event_entry>& events) const;
+  bool check_block_accepted_as_alternative(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
+
 struct gen_block_invalid_prev_id : public gen_block_verification_base<1>
 {
   bool generate(std::vector<test_event_entry>& events) const;
@@ -0,0 +1,63 @@
+// Copyright (c) 2014-2016, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+
+// counts the calls to the global operator new made while allocation_counting
+// is set on the calling thread, see allocation_count.cpp
+extern std::atomic<size_t> allocation_count;
+extern thread_local bool allocation_counting;
+
+template <typename T>
+void run_allocation_test(const char* test_name)
+{
+  T test;
+  if (!test.init())
+  {
+    std::cout << test_name << " - FAILED" << std::endl;
+    return;
+  }
+
+  const size_t start = allocation_count.load();
+  allocation_counting = true;
+  const bool ok = test.test();
+  allocation_counting = false;
+  if (!ok)
+  {
+    std::cout << test_name << " - FAILED" << std::endl;
+    return;
+  }
+  std::cout << test_name << " - OK:\n";
+  std::cout << "  allocations per call: " << allocation_count.load() - start << '\n' << std::endl;
+}
+
+#define TEST_ALLOCATIONS0(test_class)         run_allocation_test< test_class >(QUOTEME(test_class))
+#define TEST_ALLOCATIONS1(test_class, a0)     run_allocation_test< test_class<a0> >(QUOTEME(test_class<a0>))
@@ -39,7 +39,8 @@
 
 #include "multi_tx_test_base.h"
 
-template<size_t a_ring_size>
+// with a_precomp, ring members are precomputed once, as if cached
+template<size_t a_ring_size, bool a_precomp = false>
 class test_check_ring_signature : private multi_tx_test_base<a_ring_size>
 {
   static_assert(0 < a_ring_size, "ring_size must be greater than 0");
@@ -67,12 +68,21 @@ public:
 
     get_transaction_prefix_hash(m_tx, m_tx_prefix_hash);
 
+    for (size_t i = 0; i < ring_size; ++i)
+    {
+      if (!crypto::precompute_ring_member(this->m_public_keys[i], m_members[i]))
+        return false;
+      m_member_ptrs[i] = &m_members[i];
+    }
+
     return true;
   }
 
   bool test()
   {
     const cryptonote::txin_to_key& txin = boost::get<cryptonote::txin_to_key>(m_tx.vin[0]);
+    if (a_precomp)
+      return crypto::check_ring_signature(m_tx_prefix_hash, txin.k_image, m_member_ptrs, ring_size, m_tx.signatures[0].data());
     return crypto::check_ring_signature(m_tx_prefix_hash, txin.k_image, this->m_public_key_ptrs, ring_size, m_tx.signatures[0].data());
   }
 
@@ -80,4 +90,6 @@ private:
   cryptonote::account_base m_alice;
   cryptonote::transaction m_tx;
   crypto::hash m_tx_prefix_hash;
+  crypto::ring_member_precomp m_members[ring_size];
+  const crypto::ring_member_precomp* m_member_ptrs[ring_size];
 };
@@ -47,3 +47,29 @@ public:
     return cryptonote::is_out_to_acc(m_bob.get_keys(), tx_out, m_tx_pub_key, 0);
   }
 };
+
+// scanning an output once the tx derivation and the spend key are precomputed
+class test_is_out_to_acc_precomp : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    crypto::generate_key_derivation(m_tx_pub_key, m_bob.get_keys().m_view_secret_key, m_key_derivation);
+    return crypto::precompute_public_key(m_bob.get_keys().m_account_address.m_spend_public_key, m_spend_public_key);
+  }
+
+  bool test()
+  {
+    const cryptonote::txout_to_key& tx_out = boost::get<cryptonote::txout_to_key>(m_tx.vout[0].target);
+    return cryptonote::is_out_to_acc(m_spend_public_key, tx_out, m_key_derivation, 0);
+  }
+
+private:
+  crypto::key_derivation m_key_derivation;
+  crypto::public_key_precomp m_spend_public_key;
+};
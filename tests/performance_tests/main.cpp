@@ -30,6 +30,7 @@
 
 #include "performance_tests.h"
 #include "performance_utils.h"
+#include "allocation_count.h"
 
 // tests
 #include "construct_tx.h"
@@ -41,6 +42,7 @@
 #include "generate_key_image.h"
 #include "generate_key_image_helper.h"
 #include "is_out_to_acc.h"
+#include "portable_storage.h"
 
 int main(int argc, char** argv)
 {
@@ -73,18 +75,37 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE1(test_check_ring_signature, 1);
   TEST_PERFORMANCE1(test_check_ring_signature, 2);
+  TEST_PERFORMANCE1(test_check_ring_signature, 3);
+  TEST_PERFORMANCE1(test_check_ring_signature, 5);
   TEST_PERFORMANCE1(test_check_ring_signature, 10);
+  TEST_PERFORMANCE1(test_check_ring_signature, 50);
   TEST_PERFORMANCE1(test_check_ring_signature, 100);
 
+  TEST_PERFORMANCE2(test_check_ring_signature, 3, true);
+  TEST_PERFORMANCE2(test_check_ring_signature, 10, true);
+  TEST_PERFORMANCE2(test_check_ring_signature, 100, true);
+
   TEST_PERFORMANCE0(test_is_out_to_acc);
+  TEST_PERFORMANCE0(test_is_out_to_acc_precomp);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
   TEST_PERFORMANCE0(test_generate_key_derivation);
   TEST_PERFORMANCE0(test_generate_key_image);
   TEST_PERFORMANCE0(test_derive_public_key);
+  TEST_PERFORMANCE0(test_derive_public_key_precomp);
   TEST_PERFORMANCE0(test_derive_secret_key);
 
   TEST_PERFORMANCE0(test_cn_slow_hash);
 
+  TEST_PERFORMANCE1(test_portable_storage_store, false);
+  TEST_PERFORMANCE1(test_portable_storage_store, true);
+  TEST_PERFORMANCE1(test_portable_storage_load, false);
+  TEST_PERFORMANCE1(test_portable_storage_load, true);
+  TEST_PERFORMANCE1(test_portable_storage_store_json, false);
+  TEST_PERFORMANCE1(test_portable_storage_store_json, true);
+
+  TEST_ALLOCATIONS1(test_portable_storage_load, false);
+  TEST_ALLOCATIONS1(test_portable_storage_load, true);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
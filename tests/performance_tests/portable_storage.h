@@ -0,0 +1,184 @@
+// Copyright (c) 2014-2016, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+
+#pragma once
+
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage.h"
+#include "storages/portable_storage_reader.h"
+#include "storages/portable_storage_writer.h"
+#include "storages/portable_storage_json_writer.h"
+
+// a NOTIFY_RESPONSE_GET_OBJECTS sized like a batch of blocks during sync
+inline void make_test_get_objects_request(cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& req)
+{
+  req.current_blockchain_height = 1000000;
+  for (size_t b = 0; b < 200; ++b)
+  {
+    cryptonote::block_complete_entry bce;
+    bce.block.assign(400, static_cast<char>(b));
+    for (size_t t = 0; t < 10; ++t)
+      bce.txs.push_back(std::string(1500, static_cast<char>(t)));
+    req.blocks.push_back(bce);
+    req.missed_ids.push_back(crypto::hash());
+  }
+}
+
+template<bool a_streaming>
+class test_portable_storage_store
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    make_test_get_objects_request(m_req);
+    return true;
+  }
+
+  bool test()
+  {
+    std::string buff;
+    if (a_streaming)
+    {
+      epee::serialization::portable_storage_writer stg;
+      m_req.store(stg);
+      stg.store_to_binary(buff);
+    }
+    else
+    {
+      epee::serialization::portable_storage stg;
+      m_req.store(stg);
+      stg.store_to_binary(buff);
+    }
+    return !buff.empty();
+  }
+
+private:
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request m_req;
+};
+
+template<bool a_streaming>
+class test_portable_storage_load
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request req;
+    make_test_get_objects_request(req);
+    epee::serialization::portable_storage stg;
+    req.store(stg);
+    return stg.store_to_binary(m_buff);
+  }
+
+  bool test()
+  {
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request req;
+    if (a_streaming)
+    {
+      epee::serialization::portable_storage_reader stg;
+      if (!stg.load_from_binary(m_buff) || !req.load(stg))
+        return false;
+    }
+    else
+    {
+      epee::serialization::portable_storage stg;
+      if (!stg.load_from_binary(m_buff) || !req.load(stg))
+        return false;
+    }
+    return req.blocks.size() == 200;
+  }
+
+private:
+  std::string m_buff;
+};
+
+// a get_transaction_pool response for a 20k transaction pool
+inline void make_test_tx_pool_response(cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response& res)
+{
+  res.status = CORE_RPC_STATUS_OK;
+  std::string tx_json = "{\n  \"version\": 1, \n  \"unlock_time\": 0, \n  \"vin\": [ {\n      \"key\": {\n        \"amount\": 0, \n        \"key_offsets\": [ ";
+  for (size_t k = 0; k < 120; ++k)
+    tx_json += std::to_string(k * 7919) + ", ";
+  tx_json += "0]}}], \n  \"extra\": [ 1, 2, 3, 4, 5, 6, 7, 8]\n}";
+  for (size_t t = 0; t < 20000; ++t)
+  {
+    cryptonote::tx_info ti;
+    ti.id_hash = std::string(64, 'a' + t % 6);
+    ti.tx_json = tx_json;
+    ti.blob_size = 13000 + t;
+    ti.fee = 10000000000ull + t;
+    ti.max_used_block_id_hash = std::string(64, 'f');
+    ti.max_used_block_height = 1000000 + t;
+    ti.kept_by_block = t % 2;
+    ti.last_failed_height = 0;
+    ti.last_failed_id_hash = std::string(64, '0');
+    ti.receive_time = 1460000000 + t;
+    res.transactions.push_back(ti);
+  }
+}
+
+template<bool a_streaming>
+class test_portable_storage_store_json
+{
+public:
+  static const size_t loop_count = 5;
+
+  bool init()
+  {
+    make_test_tx_pool_response(m_res);
+    return true;
+  }
+
+  bool test()
+  {
+    std::string buff;
+    if (a_streaming)
+    {
+      epee::serialization::portable_storage_json_writer stg;
+      m_res.store(stg);
+      stg.store_to_json(buff);
+    }
+    else
+    {
+      epee::serialization::portable_storage stg;
+      m_res.store(stg);
+      stg.dump_as_json(buff);
+    }
+    return !buff.empty();
+  }
+
+private:
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response m_res;
+};
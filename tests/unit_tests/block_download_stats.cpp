@@ -0,0 +1,133 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/connection_context.h"
+
+using cryptonote::block_download_stats;
+
+namespace
+{
+  const block_download_stats::clock::time_point t0 = block_download_stats::clock::now();
+
+  block_download_stats::clock::time_point at_ms(uint64_t ms)
+  {
+    return t0 + std::chrono::milliseconds(ms);
+  }
+}
+
+TEST(block_download_stats, starts_with_one_default_request)
+{
+  block_download_stats stats;
+  ASSERT_EQ(1, stats.get_window(4));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, stats.get_request_size());
+}
+
+TEST(block_download_stats, window_covers_round_trip)
+{
+  block_download_stats stats;
+
+  // 1 MB answered 200 ms after it was asked for
+  stats.on_response(1000000, 100, at_ms(0), at_ms(200));
+  ASSERT_EQ(200000, stats.rtt);
+  ASSERT_EQ(5000000, stats.speed);
+  ASSERT_EQ(2, stats.get_window(4));
+
+  // with two in flight the second arrives 100 ms after the first, the link
+  // carries 10 MB/s and a round trip is worth two responses
+  for (uint64_t t = 300; t <= 2000; t += 100)
+    stats.on_response(1000000, 100, at_ms(t - 250), at_ms(t));
+  ASSERT_EQ(200000, stats.rtt);
+  ASSERT_NEAR(10000000, stats.speed, 100000);
+  ASSERT_EQ(3, stats.get_window(4));
+  ASSERT_EQ(2, stats.get_window(2));
+  ASSERT_EQ(19000000, stats.bytes);
+  ASSERT_EQ(19, stats.responses);
+}
+
+TEST(block_download_stats, one_at_a_time_asks_for_one_more)
+{
+  // a response that had the link to itself takes a round trip plus its own
+  // transfer, so a second request is always worth trying
+  block_download_stats stats;
+  for (uint64_t t = 0; t < 10; ++t)
+    stats.on_response(1000, 10, at_ms(t * 1000), at_ms(t * 1000 + 500));
+  ASSERT_EQ(2, stats.get_window(4));
+}
+
+TEST(block_download_stats, window_is_capped)
+{
+  block_download_stats stats;
+  // two seconds away, with responses streaming in every 50 ms
+  stats.on_response(500000, 50, at_ms(0), at_ms(2000));
+  for (uint64_t t = 2050; t <= 5000; t += 50)
+    stats.on_response(500000, 50, at_ms(t - 1000), at_ms(t));
+  ASSERT_EQ(4, stats.get_window(4));
+}
+
+TEST(block_download_stats, request_size_follows_speed)
+{
+  // 100 byte blocks at 50 kB/s: a second's worth is 500 blocks, but only
+  // twice the last response at most
+  block_download_stats stats;
+  stats.on_response(20000, 200, at_ms(0), at_ms(400));
+  ASSERT_EQ(400, stats.get_request_size());
+  stats.on_response(40000, 400, at_ms(400), at_ms(1200));
+  ASSERT_EQ(500, stats.get_request_size());
+
+  // 100 kB blocks at the same speed: one block a request
+  stats.on_response(200000, 2, at_ms(1200), at_ms(5200));
+  stats.on_response(200000, 2, at_ms(5200), at_ms(9200));
+  stats.on_response(200000, 2, at_ms(9200), at_ms(13200));
+  ASSERT_EQ(1, stats.get_request_size());
+}
+
+TEST(block_download_stats, request_size_is_capped)
+{
+  block_download_stats stats;
+  // tiny blocks on a fast link stop at the block count limit
+  for (uint64_t t = 0; t < 20; ++t)
+    stats.on_response(2000 * 100, 2000, at_ms(t * 10), at_ms(t * 10 + 10));
+  ASSERT_EQ(BLOCKS_SYNCHRONIZING_MAX_COUNT, stats.get_request_size());
+
+  // large blocks on a fast link stop at the byte limit
+  for (uint64_t t = 20; t < 40; ++t)
+    stats.on_response(1000 * 100000, 1000, at_ms(t * 10), at_ms(t * 10 + 10));
+  ASSERT_NEAR(BLOCKS_SYNCHRONIZING_MAX_BYTES / 100000, stats.get_request_size(), 2);
+}
+
+TEST(block_download_stats, average_speed)
+{
+  block_download_stats stats;
+  stats.on_response(100000, 10, at_ms(0), at_ms(1000));
+  stats.on_response(300000, 10, at_ms(1000), at_ms(2000));
+  ASSERT_EQ(200000, stats.get_average_speed());
+  ASSERT_EQ(150000, stats.speed);
+}
@@ -41,6 +41,7 @@
 #include "blockchain_db/berkeleydb/db_bdb.h"
 #endif
 #include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/chain_stats.h"
 
 using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
@@ -337,4 +338,184 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, HasKeyImages)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+
+  // interleave unknown key images with the spent ones, unsorted
+  std::vector<crypto::key_image> imgs;
+  std::vector<bool> expected;
+  for (const auto &in: this->m_txs[0][0].vin)
+  {
+    crypto::key_image unknown = boost::get<txin_to_key>(in).k_image;
+    unknown.data[0] ^= 0xff;
+    imgs.push_back(unknown);
+    expected.push_back(false);
+    imgs.push_back(boost::get<txin_to_key>(in).k_image);
+    expected.push_back(true);
+  }
+  imgs.push_back(imgs[1]);
+  expected.push_back(true);
+
+  std::vector<bool> spent;
+  ASSERT_NO_THROW(this->m_db->has_key_images(imgs, spent));
+  ASSERT_EQ(expected, spent);
+  for (size_t n = 0; n < imgs.size(); ++n)
+    ASSERT_EQ(expected[n], this->m_db->has_key_image(imgs[n]));
+}
+
+TYPED_TEST(BlockchainDBTest, GetOutputKeys)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // both coinbases have an output of this amount
+  const uint64_t amount = this->m_blocks[0].miner_tx.vout.back().amount;
+  ASSERT_EQ(2, this->m_db->get_num_outputs(amount));
+
+  // unsorted, with duplicates
+  const std::vector<uint64_t> offsets = {1, 0, 1};
+  std::vector<output_data_t> outputs;
+  ASSERT_NO_THROW(this->m_db->get_output_key(amount, offsets, outputs));
+  ASSERT_EQ(offsets.size(), outputs.size());
+  std::vector<tx_out_index> indices;
+  ASSERT_NO_THROW(this->m_db->get_output_tx_and_index(amount, offsets, indices));
+  ASSERT_EQ(offsets.size(), indices.size());
+  for (size_t n = 0; n < offsets.size(); ++n)
+  {
+    const output_data_t od = this->m_db->get_output_key(amount, offsets[n]);
+    ASSERT_HASH_EQ(od.pubkey, outputs[n].pubkey);
+    ASSERT_EQ(od.height, outputs[n].height);
+    ASSERT_EQ(offsets[n], outputs[n].height);
+    ASSERT_HASH_EQ(get_transaction_hash(this->m_blocks[offsets[n]].miner_tx), indices[n].first);
+  }
+
+  ASSERT_THROW(this->m_db->get_output_key(amount, std::vector<uint64_t>{0, 2}, outputs), OUTPUT_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, CacheInvalidatedOnPop)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  this->init_hard_fork();
+  this->m_db->set_cache_limits(1 << 20, 1 << 20, 1 << 20);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // the second lookup of each should be served from the cache
+  block b;
+  transaction tx;
+  const crypto::hash tx_hash = this->m_blocks[0].tx_hashes[0];
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_NO_THROW(b = this->m_db->get_block_from_height(1));
+    ASSERT_TRUE(compare_blocks(this->m_blocks[1], b));
+    ASSERT_NO_THROW(tx = this->m_db->get_tx(tx_hash));
+    ASSERT_HASH_EQ(tx_hash, get_transaction_hash(tx));
+  }
+  db_cache_stats stats = this->m_db->get_cache_stats();
+  ASSERT_EQ(1, stats.blocks.hits);
+  ASSERT_EQ(1, stats.txs.hits);
+
+  // popped objects must not be served from the cache
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_THROW(this->m_db->get_block_from_height(1), BLOCK_DNE);
+  ASSERT_NO_THROW(b = this->m_db->get_block_from_height(0));
+  ASSERT_TRUE(compare_blocks(this->m_blocks[0], b));
+
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_THROW(this->m_db->get_block_from_height(0), BLOCK_DNE);
+  ASSERT_THROW(this->m_db->get_tx(tx_hash), TX_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, OutputHistogram)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  const uint64_t amount = this->m_blocks[0].miner_tx.vout.back().amount;
+  const std::vector<uint64_t> amounts = {amount, 1};
+  std::map<uint64_t, uint64_t> histogram = this->m_db->get_output_histogram(amounts, false);
+  ASSERT_EQ(2, histogram.size());
+  ASSERT_EQ(2, histogram[amount]);
+  ASSERT_EQ(0, histogram[1]);
+
+  // both outputs are younger than the spendable age
+  histogram = this->m_db->get_output_histogram(amounts, true);
+  ASSERT_EQ(0, histogram[amount]);
+
+  // all amounts
+  histogram = this->m_db->get_output_histogram(std::vector<uint64_t>(), false);
+  ASSERT_EQ(2, histogram[amount]);
+
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  histogram = this->m_db->get_output_histogram(amounts, false);
+  ASSERT_EQ(1, histogram[amount]);
+}
+
+TYPED_TEST(BlockchainDBTest, ChainStats)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  chain_stats stats;
+  ASSERT_NO_THROW(stats.load(*this->m_db));
+  ASSERT_EQ(2, stats.height());
+  std::vector<size_t> sizes;
+  ASSERT_TRUE(stats.get_block_sizes(sizes, CRYPTONOTE_REWARD_BLOCKS_WINDOW));
+  ASSERT_EQ(2, sizes.size());
+  ASSERT_EQ(t_sizes[1], sizes[1]);
+
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_NO_THROW(stats.pop(*this->m_db));
+  ASSERT_EQ(1, stats.height());
+  ASSERT_EQ(t_sizes[0], stats.get_median_block_size());
+
+  stats.push(this->m_blocks[1].timestamp, t_diffs[1], t_sizes[1]);
+  ASSERT_EQ(2, stats.height());
+  ASSERT_EQ((t_sizes[0] + t_sizes[1]) / 2, stats.get_median_block_size());
+}
+
 }  // anonymous namespace
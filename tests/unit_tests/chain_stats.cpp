@@ -0,0 +1,139 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <deque>
+
+#include "misc_language.h"
+#include "cryptonote_core/chain_stats.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  TEST(rolling_median, empty)
+  {
+    rolling_median<uint64_t> m;
+    ASSERT_EQ(0, m.median());
+    ASSERT_FALSE(m.erase(1));
+  }
+
+  TEST(rolling_median, matches_epee_median)
+  {
+    rolling_median<uint64_t> m;
+    std::deque<uint64_t> window;
+    srand(0);
+    for (int i = 0; i < 1000; ++i)
+    {
+      // use a small range so there are many duplicates
+      const uint64_t v = rand() % 50;
+      window.push_back(v);
+      m.insert(v);
+      if (window.size() > 17)
+      {
+        ASSERT_TRUE(m.erase(window.front()));
+        window.pop_front();
+      }
+      std::vector<uint64_t> values(window.begin(), window.end());
+      ASSERT_EQ(epee::misc_utils::median(values), m.median());
+    }
+  }
+
+  TEST(chain_stats, windows)
+  {
+    chain_stats stats;
+    ASSERT_EQ(0, stats.height());
+
+    for (uint64_t h = 0; h < chain_stats::WINDOW_SIZE + 10; ++h)
+      stats.push(1000 + h * 120, h * 10, 100 + h);
+    const uint64_t height = chain_stats::WINDOW_SIZE + 10;
+    ASSERT_EQ(height, stats.height());
+
+    std::vector<uint64_t> timestamps;
+    std::vector<difficulty_type> difficulties;
+    stats.get_difficulty_window(timestamps, difficulties);
+    ASSERT_EQ(DIFFICULTY_BLOCKS_COUNT, timestamps.size());
+    ASSERT_EQ(DIFFICULTY_BLOCKS_COUNT, difficulties.size());
+    ASSERT_EQ((height - 1) * 10, difficulties.back());
+
+    uint64_t median_ts;
+    ASSERT_TRUE(stats.get_median_timestamp(median_ts));
+    std::vector<uint64_t> last_timestamps(timestamps.end() - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW, timestamps.end());
+    ASSERT_EQ(epee::misc_utils::median(last_timestamps), median_ts);
+
+    std::vector<size_t> sizes;
+    ASSERT_TRUE(stats.get_block_sizes(sizes, CRYPTONOTE_REWARD_BLOCKS_WINDOW));
+    ASSERT_EQ(CRYPTONOTE_REWARD_BLOCKS_WINDOW, sizes.size());
+    ASSERT_EQ(100 + height - 1, sizes.back());
+    ASSERT_EQ(epee::misc_utils::median(sizes), stats.get_median_block_size());
+
+    // older blocks are not kept
+    sizes.clear();
+    ASSERT_FALSE(stats.get_block_sizes(sizes, chain_stats::WINDOW_SIZE + 1));
+
+    ASSERT_TRUE(stats.get_blocks(height - 5, height - 2, timestamps, difficulties));
+    ASSERT_EQ(3, timestamps.size());
+    ASSERT_EQ(1000 + (height - 5) * 120, timestamps[0]);
+    ASSERT_EQ((height - 3) * 10, difficulties[2]);
+    ASSERT_FALSE(stats.get_blocks(0, 10, timestamps, difficulties));
+    ASSERT_FALSE(stats.get_blocks(height - 1, height + 1, timestamps, difficulties));
+  }
+
+  TEST(chain_stats, short_chain)
+  {
+    chain_stats stats;
+    stats.push(1000, 1, 10);
+    stats.push(1100, 2, 20);
+
+    // genesis is not used for difficulty
+    std::vector<uint64_t> timestamps;
+    std::vector<difficulty_type> difficulties;
+    stats.get_difficulty_window(timestamps, difficulties);
+    ASSERT_EQ(1, timestamps.size());
+    ASSERT_EQ(1100, timestamps[0]);
+
+    uint64_t median_ts;
+    ASSERT_FALSE(stats.get_median_timestamp(median_ts));
+
+    std::vector<size_t> sizes;
+    ASSERT_TRUE(stats.get_block_sizes(sizes, CRYPTONOTE_REWARD_BLOCKS_WINDOW));
+    ASSERT_EQ(2, sizes.size());
+    ASSERT_EQ(15, stats.get_median_block_size());
+
+    difficulty_type diff;
+    ASSERT_FALSE(stats.get_next_difficulty(120, diff));
+    stats.set_next_difficulty(120, 42);
+    ASSERT_TRUE(stats.get_next_difficulty(120, diff));
+    ASSERT_EQ(42, diff);
+    ASSERT_FALSE(stats.get_next_difficulty(60, diff));
+    stats.push(1200, 3, 30);
+    ASSERT_FALSE(stats.get_next_difficulty(120, diff));
+  }
+}
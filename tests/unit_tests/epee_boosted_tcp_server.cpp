@@ -28,6 +28,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <atomic>
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
@@ -81,6 +82,50 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  struct send_test_protocol_handler_config
+  {
+    send_test_protocol_handler_config() : endpoint(NULL) {}
+    std::atomic<epee::net_utils::i_service_endpoint*> endpoint; // the connection while it is open
+  };
+
+  // hands the connection to the test, which sends through it
+  struct send_test_protocol_handler
+  {
+    typedef test_connection_context connection_context;
+    typedef send_test_protocol_handler_config config_type;
+
+    send_test_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& /*conn_context*/)
+      : m_psnd_hndlr(psnd_hndlr)
+      , m_config(config)
+    {
+    }
+
+    void after_init_connection()
+    {
+      m_config.endpoint = m_psnd_hndlr;
+    }
+
+    void handle_qued_callback()
+    {
+    }
+
+    bool release_protocol()
+    {
+      m_config.endpoint = NULL;
+      return true;
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      return false;
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+    config_type& m_config;
+  };
+
+  typedef epee::net_utils::boosted_tcp_server<send_test_protocol_handler> send_test_tcp_server;
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -133,3 +178,75 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, rate_limited_peer_that_reads_is_not_dropped)
+{
+  send_test_tcp_server srv(epee::net_utils::e_connection_type_P2P); // P2P connections are rate limited
+  ASSERT_TRUE(srv.init_server(test_server_port + 1, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  const uint64_t rate_up_limit = epee::net_utils::connection_basic::get_rate_up_limit();
+  epee::net_utils::connection_basic::set_rate_up_limit(64 * 1024);
+  auto restore_limit = epee::misc_utils::create_scope_leave_handler([rate_up_limit](){ epee::net_utils::connection_basic::set_rate_up_limit(rate_up_limit); });
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket client(io_service);
+  client.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port + 1));
+
+  for (int i = 0; i < 500 && !srv.get_config_object().endpoint; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  epee::net_utils::i_service_endpoint* endpoint = srv.get_config_object().endpoint;
+  ASSERT_TRUE(endpoint != NULL);
+
+  // more messages than the send que holds, queued far faster than the limit lets them out
+  const std::string message(64, 'x');
+  const size_t message_count = ABSTRACT_SERVER_SEND_QUE_MAX_COUNT * 2;
+  for (size_t i = 0; i < message_count; ++i)
+    ASSERT_TRUE(endpoint->do_send(message.data(), message.size()));
+
+  std::string received(message.size() * message_count, 0);
+  boost::system::error_code ec;
+  boost::asio::read(client, boost::asio::buffer(&received[0], received.size()), ec);
+  ASSERT_FALSE(ec);
+  ASSERT_EQ(std::string(message_count * message.size(), 'x'), received);
+  ASSERT_TRUE(srv.get_config_object().endpoint != NULL);
+
+  client.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
+
+TEST(boosted_tcp_server, peer_that_does_not_read_is_dropped)
+{
+  send_test_tcp_server srv(epee::net_utils::e_connection_type_P2P);
+  ASSERT_TRUE(srv.init_server(test_server_port + 2, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket client(io_service);
+  client.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port + 2));
+
+  for (int i = 0; i < 500 && !srv.get_config_object().endpoint; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  epee::net_utils::i_service_endpoint* endpoint = srv.get_config_object().endpoint;
+  ASSERT_TRUE(endpoint != NULL);
+
+  // more than the socket buffers hold, so the client never reading stalls the writes
+  const std::string big_message(32 * 1024 * 1024, 'x');
+  ASSERT_TRUE(endpoint->do_send(big_message.data(), big_message.size()));
+
+  // the que is cut at the hard limit, long before the stalled write times out
+  const std::string message(64, 'x');
+  const size_t hard_limit = ABSTRACT_SERVER_SEND_QUE_MAX_COUNT * ABSTRACT_SERVER_SEND_QUE_HARD_LIMIT_FACTOR;
+  size_t sent = 0;
+  while (sent < hard_limit && endpoint->do_send(message.data(), message.size()))
+    ++sent;
+  ASSERT_EQ(hard_limit - 1, sent);
+  ASSERT_TRUE(srv.get_config_object().endpoint == NULL);
+
+  client.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
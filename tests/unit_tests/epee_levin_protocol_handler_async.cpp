@@ -219,13 +219,13 @@ namespace
   {
   };
 
-  class test_levin_protocol_handler__hanle_recv_with_invalid_data : public async_protocol_handler_test
+  class async_protocol_handler_request_test : public async_protocol_handler_test
   {
   public:
     static const int expected_command = 5615871;
     static const int expected_return_code = 782546;
 
-    test_levin_protocol_handler__hanle_recv_with_invalid_data()
+    async_protocol_handler_request_test()
       : m_expected_invoke_out_buf(512, 'y')
     {
     }
@@ -263,6 +263,14 @@ namespace
     std::string m_buf;
     std::string m_expected_invoke_out_buf;
   };
+
+  class test_levin_protocol_handler__hanle_recv_with_invalid_data : public async_protocol_handler_request_test
+  {
+  };
+
+  class test_levin_protocol_handler__hanle_recv_in_place : public async_protocol_handler_request_test
+  {
+  };
 }
 
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, new_handler_is_not_initialized)
@@ -530,3 +538,107 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpe
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+TEST_F(test_levin_protocol_handler__hanle_recv_in_place, receives_body_in_place)
+{
+  m_in_data.clear();
+  for (size_t i = 0; i < 10000; ++i)
+    m_in_data.push_back(static_cast<char>(i));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  char* ptr = nullptr;
+  size_t size = 0;
+  ASSERT_FALSE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+
+  // the header and the start of the body arrive through the usual buffer
+  const size_t first = sizeof(m_req_head) + 100;
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), first));
+
+  // the rest is read straight into the handler, in two reads
+  size_t offset = first;
+  while (offset < m_buf.size())
+  {
+    ASSERT_EQ(0, m_commands_handler.invoke_counter());
+    ASSERT_TRUE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+    ASSERT_EQ(m_buf.size() - offset, size);
+    const size_t n = std::min<size_t>(size, 6000);
+    memcpy(ptr, m_buf.data() + offset, n);
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(ptr, n));
+    offset += n;
+  }
+
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+  ASSERT_FALSE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_in_place, receives_next_packet_after_in_place_body)
+{
+  prepare_buf();
+  const std::string second_body(300, 's');
+  epee::levin::bucket_head2 second_head = m_req_head;
+  second_head.m_cb = second_body.size();
+  second_head.m_have_to_return_data = false;
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), sizeof(m_req_head)));
+  char* ptr = nullptr;
+  size_t size = 0;
+  ASSERT_TRUE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+  ASSERT_EQ(m_in_data.size(), size);
+  memcpy(ptr, m_in_data.data(), size);
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(ptr, size));
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+
+  // the next packet, header and body in one read
+  std::string next(reinterpret_cast<const char*>(&second_head), sizeof(second_head));
+  next += second_body;
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(next.data(), next.size()));
+  ASSERT_EQ(1, m_commands_handler.notify_counter());
+  ASSERT_EQ(second_body, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_in_place, does_not_allocate_body_before_it_arrives)
+{
+  // the header claims a body close to the limit, and the sender stalls
+  m_in_data.clear();
+  for (size_t i = 0; i < max_packet_size - 1; ++i)
+    m_in_data.push_back(static_cast<char>(i));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  const size_t first = sizeof(m_req_head) + 100;
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), first));
+  char* ptr = nullptr;
+  size_t size = 0;
+  ASSERT_TRUE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+  ASSERT_EQ(LEVIN_INITIAL_BODY_BUFFER_SIZE - 100, size);
+
+  // the buffer only grows with the data actually received
+  size_t offset = first;
+  while (offset < m_buf.size())
+  {
+    ASSERT_EQ(0, m_commands_handler.invoke_counter());
+    ASSERT_TRUE(m_conn->m_protocol_handler.get_recv_buffer(ptr, size));
+    const size_t received = offset - sizeof(m_req_head);
+    ASSERT_LE(received + size, std::max<size_t>(2 * received, LEVIN_INITIAL_BODY_BUFFER_SIZE));
+    memcpy(ptr, m_buf.data() + offset, size);
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(ptr, size));
+    offset += size;
+  }
+
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_in_place, grows_body_from_buffered_data)
+{
+  m_in_data.assign(3 * LEVIN_INITIAL_BODY_BUFFER_SIZE + 5, 'b');
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  // header and body in one read, without the in place buffer
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
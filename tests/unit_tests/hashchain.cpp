@@ -0,0 +1,155 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+namespace
+{
+  crypto::hash make_hash(uint64_t n)
+  {
+    crypto::hash h = cryptonote::null_hash;
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  void fill(tools::hashchain &hc, uint64_t n)
+  {
+    for (uint64_t i = hc.size(); i < n; ++i)
+      hc.push_back(make_hash(i));
+  }
+
+  void make_blocks(std::vector<tools::wallet2::parsed_block> &blocks, uint64_t from, uint64_t to, uint64_t fork)
+  {
+    blocks.clear();
+    for (uint64_t i = from; i < to; ++i)
+    {
+      blocks.push_back(tools::wallet2::parsed_block());
+      blocks.back().hash = make_hash(i < fork ? i : i + 1000000);
+    }
+  }
+
+  struct new_block_heights: public tools::i_wallet2_callback
+  {
+    virtual void on_new_block(uint64_t height, const cryptonote::block& block) { heights.push_back(height); }
+    std::vector<uint64_t> heights;
+  };
+
+  TEST(hashchain, keeps_recent_and_sparse_hashes)
+  {
+    tools::hashchain hc;
+    ASSERT_TRUE(hc.empty());
+    fill(hc, 5500);
+    ASSERT_EQ(5500, hc.size());
+    ASSERT_EQ(5500 - WALLET_BLOCKCHAIN_RECENT_HASHES, hc.offset());
+    ASSERT_EQ(make_hash(0), hc.genesis());
+    ASSERT_EQ(make_hash(5499), hc[5499]);
+    ASSERT_EQ(make_hash(hc.offset()), hc[hc.offset()]);
+    ASSERT_TRUE(hc.is_known(3000));
+    ASSERT_FALSE(hc.is_known(3001));
+    ASSERT_FALSE(hc.is_known(5500));
+    ASSERT_EQ(make_hash(3000), hc[3000]);
+  }
+
+  TEST(hashchain, get_nearest)
+  {
+    tools::hashchain hc;
+    fill(hc, 5500);
+    crypto::hash h;
+    ASSERT_EQ(5000, hc.get_nearest(5000, h));
+    ASSERT_EQ(make_hash(5000), h);
+    ASSERT_EQ(4000, hc.get_nearest(4499, h));
+    ASSERT_EQ(make_hash(4000), h);
+    ASSERT_EQ(0, hc.get_nearest(999, h));
+    ASSERT_EQ(make_hash(0), h);
+  }
+
+  TEST(hashchain, crop_and_refill)
+  {
+    tools::hashchain hc;
+    fill(hc, 5500);
+    hc.crop(5000);
+    ASSERT_EQ(5000, hc.size());
+    ASSERT_EQ(make_hash(4999), hc[4999]);
+
+    hc.crop(2500);
+    ASSERT_EQ(2500, hc.size());
+    ASSERT_EQ(2500, hc.offset());
+    ASSERT_TRUE(hc.is_known(2000));
+    ASSERT_FALSE(hc.is_known(3000));
+
+    fill(hc, 6000);
+    ASSERT_EQ(6000, hc.size());
+    ASSERT_EQ(make_hash(3000), hc[3000]);
+    ASSERT_EQ(make_hash(5999), hc[5999]);
+  }
+
+  TEST(hashchain, assign)
+  {
+    std::vector<crypto::hash> hashes;
+    for (uint64_t i = 0; i < 2500; ++i)
+      hashes.push_back(make_hash(i));
+    tools::hashchain hc;
+    hc.assign(hashes);
+    ASSERT_EQ(2500, hc.size());
+    ASSERT_EQ(make_hash(1000), hc[1000]);
+    ASSERT_EQ(make_hash(2499), hc[2499]);
+  }
+
+  TEST(hashchain, wallet_rescans_reorg_below_recent_hashes)
+  {
+    tools::wallet2 w;
+    new_block_heights callback;
+    w.callback(&callback);
+    std::vector<tools::wallet2::parsed_block> blocks;
+    uint64_t blocks_added;
+    make_blocks(blocks, 0, 5500, 5500);
+    w.process_parsed_blocks(0, blocks, blocks_added);
+    ASSERT_EQ(5500, blocks_added);
+    ASSERT_EQ(5500, w.get_blockchain_current_height());
+
+    // the chain forks at 4200, below the 1000 recent hashes the wallet keeps,
+    // so the daemon resumes from the sparse hash at 4000
+    callback.heights.clear();
+    make_blocks(blocks, 4000, 5600, 4200);
+    w.process_parsed_blocks(4000, blocks, blocks_added);
+    ASSERT_EQ(5600, w.get_blockchain_current_height());
+    ASSERT_EQ(1599, callback.heights.size());
+    for (size_t i = 0; i < callback.heights.size(); ++i)
+      ASSERT_EQ(4001 + i, callback.heights[i]);
+
+    // the new chain is the one kept now
+    callback.heights.clear();
+    make_blocks(blocks, 5000, 5600, 4200);
+    w.process_parsed_blocks(5000, blocks, blocks_added);
+    ASSERT_EQ(0, blocks_added);
+    ASSERT_TRUE(callback.heights.empty());
+  }
+}
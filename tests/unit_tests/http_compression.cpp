@@ -0,0 +1,112 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#ifdef HTTP_ENABLE_GZIP
+
+#include "include_base_utils.h"
+#include "gzip_encoding.h"
+#include "net/http_server_compression.h"
+
+using namespace epee::net_utils;
+
+namespace
+{
+  struct collecting_handler: public i_target_handler
+  {
+    std::string data;
+    bool handle_target_data(std::string& piece_of_transfer)
+    {
+      data += piece_of_transfer;
+      return true;
+    }
+  };
+
+  bool accepts(const std::string& accept_encoding)
+  {
+    http::http_header_info info;
+    info.m_etc_fields.push_back(std::make_pair("accept-encoding", accept_encoding));
+    return http::accepts_gzip(info);
+  }
+
+  TEST(http_compression, client_decodes_server_gzip)
+  {
+    std::string body;
+    for (size_t n = 0; body.size() < 1000000; ++n)
+      body += "{\"height\": " + std::to_string(n) + ", \"status\": \"OK\"},";
+
+    std::string gz;
+    ASSERT_TRUE(http::gzip_compress(body, gz, 1));
+    ASSERT_LT(gz.size(), body.size());
+
+    collecting_handler target;
+    content_encoding_gzip decoder(&target);
+    for (size_t n = 0; n < gz.size(); n += 4096)
+    {
+      std::string piece = gz.substr(n, 4096);
+      ASSERT_TRUE(decoder.update_in(piece));
+    }
+    ASSERT_EQ(body, target.data);
+  }
+
+  TEST(http_compression, accept_encoding)
+  {
+    ASSERT_TRUE(accepts("gzip"));
+    ASSERT_TRUE(accepts("deflate, gzip"));
+    ASSERT_TRUE(accepts("gzip;q=0.5"));
+    ASSERT_TRUE(accepts("*"));
+    ASSERT_FALSE(accepts("gzip;q=0"));
+    ASSERT_FALSE(accepts("identity"));
+    ASSERT_FALSE(accepts("x-gzip"));
+    ASSERT_FALSE(http::accepts_gzip(http::http_header_info()));
+  }
+
+  TEST(http_compression, cache)
+  {
+    http::gzip_response_cache cache;
+    std::string gz;
+    cache.put("body", "gz");
+    ASSERT_FALSE(cache.get("body", gz));
+
+    cache.set_limit(16);
+    cache.put("body", "gz");
+    ASSERT_TRUE(cache.get("body", gz));
+    ASSERT_EQ("gz", gz);
+    ASSERT_FALSE(cache.get("other", gz));
+
+    // over budget, the least recently used entry goes
+    cache.put("body2", "gz2");
+    cache.put("body3", "gz3");
+    ASSERT_FALSE(cache.get("body", gz));
+    ASSERT_TRUE(cache.get("body3", gz));
+    ASSERT_EQ("gz3", gz);
+  }
+}
+
+#endif
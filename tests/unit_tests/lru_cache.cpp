@@ -0,0 +1,105 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "common/lru_cache.h"
+
+namespace
+{
+  typedef tools::lru_cache<int, int> cache_t;
+
+  TEST(lru_cache, disabled_by_default)
+  {
+    cache_t cache;
+    int v;
+    cache.insert(1, 1, 1);
+    ASSERT_FALSE(cache.get(1, v));
+    ASSERT_EQ(0, cache.get_stats().entries);
+  }
+
+  TEST(lru_cache, get_and_erase)
+  {
+    cache_t cache(100, 1);
+    int v = 0;
+    ASSERT_FALSE(cache.get(1, v));
+    cache.insert(1, 10, 1);
+    ASSERT_TRUE(cache.get(1, v));
+    ASSERT_EQ(10, v);
+    cache.insert(1, 11, 1);
+    ASSERT_TRUE(cache.get(1, v));
+    ASSERT_EQ(11, v);
+    cache.erase(1);
+    ASSERT_FALSE(cache.get(1, v));
+
+    const tools::lru_cache_stats stats = cache.get_stats();
+    ASSERT_EQ(2, stats.hits);
+    ASSERT_EQ(2, stats.misses);
+    ASSERT_EQ(0, stats.entries);
+    ASSERT_EQ(0, stats.bytes);
+  }
+
+  TEST(lru_cache, evicts_least_recently_used)
+  {
+    cache_t cache(30, 1);
+    int v;
+    cache.insert(1, 1, 10);
+    cache.insert(2, 2, 10);
+    cache.insert(3, 3, 10);
+    ASSERT_TRUE(cache.get(1, v));
+    cache.insert(4, 4, 10);
+    ASSERT_TRUE(cache.get(1, v));
+    ASSERT_FALSE(cache.get(2, v));
+    ASSERT_TRUE(cache.get(3, v));
+    ASSERT_TRUE(cache.get(4, v));
+    ASSERT_EQ(1, cache.get_stats().evictions);
+    ASSERT_EQ(30, cache.get_stats().bytes);
+
+    // too large to ever fit
+    cache.insert(5, 5, 31);
+    ASSERT_FALSE(cache.get(5, v));
+
+    cache.set_limit(10);
+    ASSERT_EQ(1, cache.get_stats().entries);
+    ASSERT_TRUE(cache.get(4, v));
+  }
+
+  TEST(lru_cache, stale_generation)
+  {
+    cache_t cache(100, 4);
+    int v;
+    const uint64_t gen = cache.generation();
+    cache.insert(1, 1, 1, gen);
+    cache.clear();
+    ASSERT_FALSE(cache.get(1, v));
+    cache.insert(2, 2, 1, gen);
+    ASSERT_FALSE(cache.get(2, v));
+    cache.insert(2, 2, 1, cache.generation());
+    ASSERT_TRUE(cache.get(2, v));
+  }
+}
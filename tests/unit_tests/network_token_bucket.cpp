@@ -0,0 +1,102 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "p2p/network_throttle-detail.hpp"
+
+using epee::net_utils::network_token_bucket;
+
+TEST(network_token_bucket, unlimited_never_delays)
+{
+  network_token_bucket bucket;
+  ASSERT_EQ(0, bucket.get_rate());
+  ASSERT_EQ(0, bucket.reserve(1000000000, 10.0));
+  ASSERT_EQ(0, bucket.reserve(1000000000, 10.0));
+}
+
+TEST(network_token_bucket, burst_then_delay)
+{
+  network_token_bucket bucket;
+  bucket.set_rate(1000);
+  ASSERT_EQ(1000, bucket.get_rate());
+  // starts with 100 ms worth of tokens
+  ASSERT_EQ(0, bucket.reserve(100, 10.0));
+  ASSERT_NEAR(0.05, bucket.reserve(50, 10.0), 1e-9);
+  // half a second later the debt is paid and the bucket is full again, capped at the burst size
+  ASSERT_EQ(0, bucket.reserve(100, 10.5));
+  ASSERT_NEAR(0.1, bucket.reserve(100, 10.5), 1e-9);
+}
+
+TEST(network_token_bucket, waiting_reservations_queue_up)
+{
+  network_token_bucket bucket;
+  bucket.set_rate(1000);
+  ASSERT_EQ(0, bucket.reserve(100, 10.0));
+  // three peers asking at the same time are served one after the other
+  ASSERT_NEAR(0.2, bucket.reserve(200, 10.0), 1e-9);
+  ASSERT_NEAR(0.4, bucket.reserve(200, 10.0), 1e-9);
+  ASSERT_NEAR(0.6, bucket.reserve(200, 10.0), 1e-9);
+  // the first one comes back after its wait and lines up behind the others
+  ASSERT_NEAR(0.6, bucket.reserve(200, 10.2), 1e-9);
+}
+
+TEST(network_token_bucket, long_run_rate_matches_limit)
+{
+  network_token_bucket bucket;
+  bucket.set_rate(32 * 1024);
+  double now = 10.0;
+  size_t sent = 0;
+  while (now < 70.0)
+  {
+    now += bucket.reserve(4096, now);
+    sent += 4096;
+  }
+  // one minute at 32 kB/s, plus the initial burst
+  ASSERT_NEAR(60.0 * 32 * 1024, sent, 0.1 * 32 * 1024 + 4096);
+}
+
+TEST(network_token_bucket, lowering_rate_drops_saved_tokens)
+{
+  network_token_bucket bucket;
+  bucket.set_rate(10000);
+  ASSERT_EQ(0, bucket.reserve(0, 10.0));
+  bucket.set_rate(1000);
+  ASSERT_EQ(0, bucket.reserve(100, 10.0));
+  ASSERT_NEAR(0.1, bucket.reserve(100, 10.0), 1e-9);
+}
+
+TEST(network_token_bucket, clock_going_backwards_does_not_add_tokens)
+{
+  network_token_bucket bucket;
+  bucket.set_rate(1000);
+  ASSERT_EQ(0, bucket.reserve(100, 10.0));
+  ASSERT_NEAR(0.1, bucket.reserve(100, 9.0), 1e-9);
+  ASSERT_NEAR(0.1, bucket.reserve(0, 10.0), 1e-9);
+}
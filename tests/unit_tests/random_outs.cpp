@@ -0,0 +1,204 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include <unordered_set>
+
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  // the chain has outputs of these amounts, none of which the genesis block pays
+  const uint64_t AMOUNT_EVEN = 1234;  // one in every even height block
+  const uint64_t AMOUNT_FEW = 2345;   // one in each of the blocks at heights 2, 4 and 6
+  const uint64_t AMOUNT_ALL = 3456;   // one in every block
+  const uint64_t AMOUNT_NONE = 4567;  // none at all
+
+  // blocks above genesis; the outputs of the last CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE are not mature yet
+  const uint64_t CHAIN_BLOCKS = 110;
+  // the miner txes of odd height blocks are locked until this height
+  const uint64_t LOCKED_UNTIL = 1000000;
+
+  const std::pair<uint8_t, uint64_t> test_hard_forks[] = { std::make_pair(1, 0), std::make_pair(0, 0) };
+  const test_options fakechain_options = { test_hard_forks };
+
+  class random_outs : public ::testing::Test
+  {
+  protected:
+    random_outs(): m_pool(m_bc), m_bc(m_pool), m_db(NULL) {}
+
+    virtual void SetUp()
+    {
+      m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+      m_db = new BlockchainLMDB();
+      m_db->open(m_path);
+      ASSERT_TRUE(m_bc.init(m_db, false, &fakechain_options));
+
+      for (uint64_t height = 1; height <= CHAIN_BLOCKS; ++height)
+      {
+        block b = AUTO_VAL_INIT(b);
+        b.major_version = 1;
+        b.minor_version = 0;
+        b.timestamp = 1400000000 + height * DIFFICULTY_TARGET_V1;
+        b.prev_id = m_db->top_block_hash();
+        b.miner_tx.version = 1;
+        b.miner_tx.unlock_time = height % 2 ? LOCKED_UNTIL : 0;
+        txin_gen in;
+        in.height = height;
+        b.miner_tx.vin.push_back(in);
+        if (height % 2 == 0)
+          add_output(b.miner_tx, AMOUNT_EVEN);
+        if (height % 2 == 0 && height <= 6)
+          add_output(b.miner_tx, AMOUNT_FEW);
+        add_output(b.miner_tx, AMOUNT_ALL);
+        m_db->add_block(b, get_object_blobsize(b), height, 0, std::vector<transaction>());
+      }
+      ASSERT_EQ(CHAIN_BLOCKS + 1, m_bc.get_current_blockchain_height());
+    }
+
+    virtual void TearDown()
+    {
+      // deinit closes and deletes the db
+      if (m_db)
+        m_bc.deinit();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_path, ec);
+    }
+
+    static void add_output(transaction &tx, uint64_t amount)
+    {
+      tx_out out;
+      out.amount = amount;
+      out.target = txout_to_key(keypair::generate().pub);
+      tx.vout.push_back(out);
+    }
+
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount get(uint64_t amount, uint64_t count)
+    {
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req;
+      COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response res;
+      req.amounts.push_back(amount);
+      req.outs_count = count;
+      EXPECT_TRUE(m_bc.get_random_outs_for_amounts(req, res));
+      EXPECT_EQ(1, res.outs.size());
+      EXPECT_EQ(amount, res.outs.front().amount);
+      return res.outs.front();
+    }
+
+    // the indices picked, checking each is picked once and comes with its own key
+    std::vector<uint64_t> indices(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount &outs)
+    {
+      std::vector<uint64_t> picked;
+      std::unordered_set<uint64_t> seen;
+      for (const auto &o: outs.outs)
+      {
+        EXPECT_TRUE(seen.insert(o.global_amount_index).second);
+        EXPECT_EQ(m_db->get_output_key(outs.amount, o.global_amount_index).pubkey, o.out_key);
+        picked.push_back(o.global_amount_index);
+      }
+      return picked;
+    }
+
+    tx_memory_pool m_pool;
+    Blockchain m_bc;
+    BlockchainDB *m_db;
+    std::string m_path;
+  };
+}
+
+TEST_F(random_outs, stay_within_mature_outputs)
+{
+  // output i of AMOUNT_EVEN is at height 2i+2, so the first 50 are old enough
+  const uint64_t mature = 50;
+  ASSERT_EQ(CHAIN_BLOCKS / 2, m_db->get_num_outputs(AMOUNT_EVEN));
+
+  size_t older = 0, newer = 0;
+  for (int round = 0; round < 100; ++round)
+  {
+    const auto outs = get(AMOUNT_EVEN, 20);
+    ASSERT_EQ(20, outs.outs.size());
+    for (uint64_t i: indices(outs))
+    {
+      ASSERT_LT(i, mature);
+      if (i < mature / 2)
+        ++older;
+      else
+        ++newer;
+    }
+  }
+
+  // the distribution leans towards recent outputs
+  ASSERT_GT(newer, older);
+}
+
+TEST_F(random_outs, returns_all_when_fewer_than_requested)
+{
+  auto outs = get(AMOUNT_FEW, 10);
+  ASSERT_EQ(std::vector<uint64_t>({0, 1, 2}), indices(outs));
+
+  outs = get(AMOUNT_FEW, 3);
+  ASSERT_EQ(std::vector<uint64_t>({0, 1, 2}), indices(outs));
+
+  outs = get(AMOUNT_NONE, 10);
+  ASSERT_TRUE(outs.outs.empty());
+}
+
+TEST_F(random_outs, returns_only_unlocked_outputs)
+{
+  // output i of AMOUNT_ALL is at height i+1: the first 101 are mature,
+  // and the odd indices, from even height blocks, the only unlocked ones
+  std::vector<uint64_t> unlocked;
+  for (uint64_t i = 1; i < 101; i += 2)
+    unlocked.push_back(i);
+
+  for (int round = 0; round < 20; ++round)
+  {
+    const auto outs = get(AMOUNT_ALL, 10);
+    ASSERT_EQ(10, outs.outs.size());
+    for (uint64_t i: indices(outs))
+      ASSERT_EQ(1, i % 2);
+  }
+
+  // asking for more than are unlocked gets every unlocked one, whether
+  // the mature outputs are sampled or all taken
+  for (uint64_t count: {60, 200})
+  {
+    std::vector<uint64_t> picked = indices(get(AMOUNT_ALL, count));
+    std::sort(picked.begin(), picked.end());
+    ASSERT_EQ(unlocked, picked);
+  }
+}
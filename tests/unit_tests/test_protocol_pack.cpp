@@ -33,6 +33,7 @@
 #include "include_base_utils.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "storages/portable_storage_template_helper.h"
+#include "net/jsonrpc_structs.h"
 
 TEST(protocol_pack, protocol_pack_command) 
 {
@@ -53,3 +54,213 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+namespace
+{
+  struct test_inner
+  {
+    int32_t i;
+    std::string s;
+    std::list<uint16_t> v;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(i)
+      KV_SERIALIZE(s)
+      KV_SERIALIZE(v)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct test_outer
+  {
+    uint64_t u;
+    double d;
+    bool b;
+    test_inner inner;
+    std::vector<test_inner> inners;
+    std::list<std::string> strings;
+    std::list<crypto::hash> hashes;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(inner)
+      KV_SERIALIZE(inners)
+      KV_SERIALIZE(strings)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(hashes)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct narrow
+  {
+    uint8_t u;
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct wide
+  {
+    uint64_t u;
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  test_outer make_test_outer(size_t n)
+  {
+    test_outer o;
+    o.u = 0x123456789abcdefull;
+    o.d = 1.5;
+    o.b = true;
+    o.inner.i = -7;
+    o.inner.s = "inner";
+    o.inner.v.push_back(3);
+    for (size_t k = 0; k < n; ++k)
+    {
+      test_inner in;
+      in.i = k;
+      in.s = std::string(k % 100, 'x');
+      for (size_t j = 0; j < k % 70; ++j)
+        in.v.push_back(j);
+      o.inners.push_back(in);
+      o.strings.push_back(std::to_string(k));
+      o.hashes.push_back(crypto::cn_fast_hash(&k, sizeof(k)));
+    }
+    return o;
+  }
+
+  void check_test_outer(const test_outer& a, const test_outer& b)
+  {
+    ASSERT_EQ(a.u, b.u);
+    ASSERT_EQ(a.d, b.d);
+    ASSERT_EQ(a.b, b.b);
+    ASSERT_EQ(a.inner.i, b.inner.i);
+    ASSERT_EQ(a.inner.s, b.inner.s);
+    ASSERT_EQ(a.inner.v, b.inner.v);
+    ASSERT_EQ(a.inners.size(), b.inners.size());
+    for (size_t k = 0; k < a.inners.size(); ++k)
+    {
+      ASSERT_EQ(a.inners[k].i, b.inners[k].i);
+      ASSERT_EQ(a.inners[k].s, b.inners[k].s);
+      ASSERT_EQ(a.inners[k].v, b.inners[k].v);
+    }
+    ASSERT_EQ(a.strings, b.strings);
+    ASSERT_EQ(a.hashes, b.hashes);
+  }
+}
+
+TEST(protocol_pack, streaming_matches_portable_storage)
+{
+  // around the one, two and four byte count encodings
+  for (size_t n: {0, 1, 63, 64, 300, 16383, 16384})
+  {
+    const test_outer o = make_test_outer(n);
+
+    std::string dom_buff, stream_buff;
+    epee::serialization::portable_storage dom_out;
+    o.store(dom_out);
+    ASSERT_TRUE(dom_out.store_to_binary(dom_buff));
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(o, stream_buff));
+    // same entries, only their order within a section may differ
+    ASSERT_EQ(dom_buff.size(), stream_buff.size());
+
+    test_outer from_stream;
+    epee::serialization::portable_storage dom_in;
+    ASSERT_TRUE(dom_in.load_from_binary(stream_buff));
+    ASSERT_TRUE(from_stream.load(dom_in));
+    check_test_outer(o, from_stream);
+
+    test_outer from_dom;
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(from_dom, dom_buff));
+    check_test_outer(o, from_dom);
+  }
+}
+
+TEST(protocol_pack, streaming_reader_converts_integers)
+{
+  std::string buff;
+  narrow n;
+  n.u = 200;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(n, buff));
+  wide w;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(w, buff));
+  ASSERT_EQ(200u, w.u);
+
+  w.u = 1000;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(w, buff));
+  ASSERT_FALSE(epee::serialization::load_t_from_binary(n, buff));
+}
+
+TEST(protocol_pack, streaming_reader_rejects_truncated)
+{
+  std::string buff;
+  const test_outer o = make_test_outer(100);
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(o, buff));
+  for (size_t len = 0; len < buff.size(); len += 97)
+  {
+    epee::serialization::portable_storage_reader stg;
+    ASSERT_FALSE(stg.load_from_binary(buff.substr(0, len)));
+  }
+}
+
+TEST(protocol_pack, json_writer_matches_portable_storage)
+{
+  for (size_t n: {0, 1, 300})
+  {
+    test_outer o = make_test_outer(n);
+    o.inner.s = "quote \" slash / backslash \\ tab \t newline \r\n end";
+
+    for (bool newlines: {true, false})
+    {
+      std::string dom_buff, stream_buff;
+      epee::serialization::portable_storage dom_out;
+      o.store(dom_out);
+      ASSERT_TRUE(dom_out.dump_as_json(dom_buff, 0, newlines));
+      ASSERT_TRUE(epee::serialization::store_t_to_json(o, stream_buff, 0, newlines));
+      // same entries, only their order within a section may differ
+      ASSERT_EQ(dom_buff.size(), stream_buff.size());
+
+      test_outer from_stream;
+      ASSERT_TRUE(epee::serialization::load_t_from_json(from_stream, stream_buff));
+      check_test_outer(o, from_stream);
+    }
+
+    // fields declared in name order come out byte for byte the same
+    std::string dom_buff, stream_buff;
+    epee::serialization::portable_storage dom_out;
+    o.inner.store(dom_out);
+    ASSERT_TRUE(dom_out.dump_as_json(dom_buff));
+    ASSERT_TRUE(epee::serialization::store_t_to_json(o.inner, stream_buff));
+    ASSERT_EQ(dom_buff, stream_buff);
+  }
+}
+
+TEST(protocol_pack, json_writer_rpc_envelope)
+{
+  epee::json_rpc::response<test_inner, epee::json_rpc::dummy_error> resp;
+  resp.jsonrpc = "2.0";
+  resp.id = epee::serialization::storage_entry(std::string("7"));
+  resp.result.i = std::numeric_limits<int32_t>::min();
+  resp.result.s = "ok";
+  resp.result.v.push_back(0);
+  resp.result.v.push_back(65535);
+
+  std::string dom_buff, stream_buff;
+  epee::serialization::portable_storage dom_out;
+  resp.store(dom_out);
+  ASSERT_TRUE(dom_out.dump_as_json(dom_buff));
+  ASSERT_TRUE(epee::serialization::store_t_to_json(resp, stream_buff));
+  ASSERT_EQ(dom_buff.size(), stream_buff.size());
+
+  epee::serialization::portable_storage ps;
+  ASSERT_TRUE(ps.load_from_json(stream_buff));
+  std::string id;
+  ASSERT_TRUE(ps.get_value("id", id, nullptr));
+  ASSERT_EQ("7", id);
+  epee::json_rpc::response<test_inner, epee::json_rpc::dummy_error> loaded;
+  ASSERT_TRUE(loaded.load(ps));
+  ASSERT_EQ(resp.result.i, loaded.result.i);
+  ASSERT_EQ(resp.result.s, loaded.result.s);
+  ASSERT_EQ(resp.result.v, loaded.result.v);
+}
@@ -0,0 +1,310 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "wallet/transfer_tx_store.h"
+
+namespace
+{
+  crypto::hash make_hash(uint64_t n)
+  {
+    crypto::hash h;
+    memset(&h, 0, sizeof(h));
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  cryptonote::blobdata make_blob(uint64_t n, size_t size)
+  {
+    cryptonote::blobdata blob(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+      blob[i] = (char)(n + i);
+    return blob;
+  }
+
+  class transfer_tx_store_test : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+      crypto::generate_chacha8_key(std::string("key"), m_key);
+    }
+
+    virtual void TearDown()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(m_path, ec);
+      boost::filesystem::remove(m_path + ".new", ec);
+    }
+
+    uint64_t file_size() const
+    {
+      return boost::filesystem::file_size(m_path);
+    }
+
+    std::string m_path;
+    crypto::chacha8_key m_key;
+  };
+
+  TEST_F(transfer_tx_store_test, add_and_get)
+  {
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    ASSERT_TRUE(store.add(make_hash(2), make_blob(2, 200)));
+    ASSERT_EQ(2, store.size());
+    ASSERT_EQ(200, store.get_blob_size(make_hash(2)));
+    ASSERT_EQ(0, store.get_blob_size(make_hash(3)));
+
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(store.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(1, 100), blob);
+    ASSERT_TRUE(store.get(make_hash(2), blob));
+    ASSERT_EQ(make_blob(2, 200), blob);
+    ASSERT_FALSE(store.get(make_hash(3), blob));
+
+    // the blobs are encrypted in the file
+    std::ifstream in(m_path, std::ios_base::binary);
+    const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(std::string::npos, contents.find(make_blob(2, 200)));
+  }
+
+  TEST_F(transfer_tx_store_test, erased_with_last_reference)
+  {
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_FALSE(store.add_ref(make_hash(1)));
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    ASSERT_TRUE(store.add_ref(make_hash(1)));
+    ASSERT_TRUE(store.add(make_hash(2), make_blob(2, 100)));
+
+    store.release(make_hash(1));
+    ASSERT_TRUE(store.has(make_hash(1)));
+    ASSERT_EQ(0, store.get_garbage_size());
+    store.release(make_hash(1));
+    ASSERT_FALSE(store.has(make_hash(1)));
+    ASSERT_NE(0, store.get_garbage_size());
+    ASSERT_TRUE(store.has(make_hash(2)));
+
+    // a released tx can be added again
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(3, 50)));
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(store.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(3, 50), blob);
+  }
+
+  TEST_F(transfer_tx_store_test, reopen_and_set_refs)
+  {
+    {
+      tools::transfer_tx_store store;
+      ASSERT_TRUE(store.open(m_path, m_key));
+      for (uint64_t n = 0; n < 10; ++n)
+        ASSERT_TRUE(store.add(make_hash(n), make_blob(n, 100 + n)));
+      // re-added after being erased, the later record wins
+      store.release(make_hash(5));
+      ASSERT_TRUE(store.add(make_hash(5), make_blob(50, 20)));
+    }
+
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_EQ(10, store.size());
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(store.get(make_hash(5), blob));
+    ASSERT_EQ(make_blob(50, 20), blob);
+    ASSERT_TRUE(store.get(make_hash(9), blob));
+    ASSERT_EQ(make_blob(9, 109), blob);
+
+    std::unordered_map<crypto::hash, size_t> refs;
+    refs[make_hash(1)] = 2;
+    refs[make_hash(5)] = 1;
+    refs[make_hash(11)] = 1;
+    store.set_refs(refs);
+    ASSERT_EQ(2, store.size());
+    ASSERT_TRUE(store.has(make_hash(1)));
+    ASSERT_TRUE(store.has(make_hash(5)));
+    store.release(make_hash(1));
+    ASSERT_TRUE(store.has(make_hash(1)));
+    store.release(make_hash(1));
+    ASSERT_FALSE(store.has(make_hash(1)));
+  }
+
+  TEST_F(transfer_tx_store_test, store_compacts)
+  {
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    for (uint64_t n = 0; n < 10; ++n)
+      ASSERT_TRUE(store.add(make_hash(n), make_blob(n, 1000)));
+    const uint64_t full_size = file_size();
+
+    // little garbage, the file is left alone
+    store.release(make_hash(0));
+    ASSERT_TRUE(store.store(m_path, m_key));
+    ASSERT_EQ(full_size, file_size());
+    ASSERT_NE(0, store.get_garbage_size());
+
+    for (uint64_t n = 1; n < 8; ++n)
+      store.release(make_hash(n));
+    ASSERT_TRUE(store.store(m_path, m_key));
+    ASSERT_EQ(0, store.get_garbage_size());
+    ASSERT_GT(full_size / 4, file_size());
+    ASSERT_EQ(2, store.size());
+
+    // still appends to the rewritten file
+    ASSERT_TRUE(store.add(make_hash(20), make_blob(20, 10)));
+    tools::transfer_tx_store reopened;
+    ASSERT_TRUE(reopened.open(m_path, m_key));
+    ASSERT_EQ(3, reopened.size());
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(reopened.get(make_hash(9), blob));
+    ASSERT_EQ(make_blob(9, 1000), blob);
+    ASSERT_TRUE(reopened.get(make_hash(20), blob));
+    ASSERT_EQ(make_blob(20, 10), blob);
+  }
+
+  TEST_F(transfer_tx_store_test, store_with_new_key)
+  {
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    crypto::chacha8_key key;
+    crypto::generate_chacha8_key(std::string("other key"), key);
+    ASSERT_TRUE(store.store(m_path, key));
+
+    tools::transfer_tx_store reopened;
+    ASSERT_TRUE(reopened.open(m_path, key));
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(reopened.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(1, 100), blob);
+  }
+
+  TEST_F(transfer_tx_store_test, drops_torn_record)
+  {
+    {
+      tools::transfer_tx_store store;
+      ASSERT_TRUE(store.open(m_path, m_key));
+      ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+      ASSERT_TRUE(store.add(make_hash(2), make_blob(2, 100)));
+    }
+    boost::filesystem::resize_file(m_path, file_size() - 10);
+
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_EQ(1, store.size());
+    ASSERT_TRUE(store.has(make_hash(1)));
+    ASSERT_TRUE(store.add(make_hash(3), make_blob(3, 100)));
+
+    tools::transfer_tx_store reopened;
+    ASSERT_TRUE(reopened.open(m_path, m_key));
+    ASSERT_EQ(2, reopened.size());
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(reopened.get(make_hash(3), blob));
+    ASSERT_EQ(make_blob(3, 100), blob);
+  }
+
+  TEST_F(transfer_tx_store_test, memory_until_stored)
+  {
+    tools::transfer_tx_store store;
+    ASSERT_FALSE(store.is_open());
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(store.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(1, 100), blob);
+    ASSERT_FALSE(boost::filesystem::exists(m_path));
+
+    ASSERT_TRUE(store.store(m_path, m_key));
+    ASSERT_TRUE(store.is_open());
+    tools::transfer_tx_store reopened;
+    ASSERT_TRUE(reopened.open(m_path, m_key));
+    ASSERT_TRUE(reopened.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(1, 100), blob);
+  }
+
+  TEST_F(transfer_tx_store_test, refuses_file_for_another_key)
+  {
+    {
+      tools::transfer_tx_store store;
+      ASSERT_TRUE(store.open(m_path, m_key));
+      ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    }
+    const uint64_t size = file_size();
+    crypto::chacha8_key key;
+    crypto::generate_chacha8_key(std::string("other key"), key);
+    tools::transfer_tx_store store;
+    ASSERT_FALSE(store.open(m_path, key));
+    ASSERT_FALSE(store.is_open());
+    // and leaves it as it was
+    ASSERT_EQ(size, file_size());
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_EQ(1, store.size());
+  }
+
+  TEST_F(transfer_tx_store_test, refuses_foreign_and_newer_files)
+  {
+    {
+      std::ofstream out(m_path, std::ios_base::binary);
+      out << std::string(1000, 'x');
+    }
+    tools::transfer_tx_store store;
+    ASSERT_FALSE(store.open(m_path, m_key));
+
+    ASSERT_TRUE(store.open(m_path, m_key, true));
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+    {
+      // the version follows the 20 byte magic
+      std::fstream f(m_path, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+      f.seekp(20);
+      const uint32_t version = 2;
+      f.write((const char*)&version, sizeof(version));
+    }
+    tools::transfer_tx_store reopened;
+    ASSERT_FALSE(reopened.open(m_path, m_key));
+  }
+
+  TEST_F(transfer_tx_store_test, starts_over_file_cut_in_its_header)
+  {
+    {
+      std::ofstream out(m_path, std::ios_base::binary);
+      out << "Monero";
+    }
+    tools::transfer_tx_store store;
+    ASSERT_TRUE(store.open(m_path, m_key));
+    ASSERT_EQ(0, store.size());
+    ASSERT_TRUE(store.add(make_hash(1), make_blob(1, 100)));
+
+    tools::transfer_tx_store reopened;
+    ASSERT_TRUE(reopened.open(m_path, m_key));
+    cryptonote::blobdata blob;
+    ASSERT_TRUE(reopened.get(make_hash(1), blob));
+    ASSERT_EQ(make_blob(1, 100), blob);
+  }
+}
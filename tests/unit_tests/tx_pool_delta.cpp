@@ -0,0 +1,376 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "net/http_server_impl_base.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/tx_pool.h"
+#include "wallet/wallet2.h"
+
+using namespace epee;
+
+namespace
+{
+  crypto::hash make_hash(uint64_t n)
+  {
+    crypto::hash h = cryptonote::null_hash;
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  void sort_hashes(std::vector<crypto::hash> &hashes)
+  {
+    std::sort(hashes.begin(), hashes.end(), [](const crypto::hash &a, const crypto::hash &b) { return memcmp(&a, &b, sizeof(a)) < 0; });
+  }
+
+  TEST(pool_change_log, changes_since_version)
+  {
+    cryptonote::pool_change_log log;
+    std::vector<crypto::hash> added, removed;
+    const uint64_t start = log.version();
+    ASSERT_TRUE(log.get_changes(start, added, removed));
+    ASSERT_TRUE(added.empty());
+    ASSERT_TRUE(removed.empty());
+
+    log.record(make_hash(1), true);
+    log.record(make_hash(2), true);
+    const uint64_t middle = log.version();
+    ASSERT_EQ(start + 2, middle);
+    log.record(make_hash(1), false);
+    log.record(make_hash(3), true);
+    // came and went, only the last state is reported
+    log.record(make_hash(2), false);
+    log.record(make_hash(2), true);
+
+    ASSERT_TRUE(log.get_changes(start, added, removed));
+    ASSERT_EQ(2, added.size());
+    ASSERT_TRUE(std::find(added.begin(), added.end(), make_hash(2)) != added.end());
+    ASSERT_TRUE(std::find(added.begin(), added.end(), make_hash(3)) != added.end());
+    ASSERT_EQ(1, removed.size());
+    ASSERT_EQ(make_hash(1), removed[0]);
+
+    ASSERT_TRUE(log.get_changes(middle, added, removed));
+    ASSERT_EQ(2, added.size());
+    ASSERT_EQ(1, removed.size());
+
+    ASSERT_TRUE(log.get_changes(log.version(), added, removed));
+    ASSERT_TRUE(added.empty());
+    ASSERT_TRUE(removed.empty());
+  }
+
+  TEST(pool_change_log, needs_whole_pool_outside_the_log)
+  {
+    cryptonote::pool_change_log log(3);
+    std::vector<crypto::hash> added, removed;
+    const uint64_t start = log.version();
+    // a fresh client, or one from before the daemon started
+    ASSERT_FALSE(log.get_changes(0, added, removed));
+    ASSERT_FALSE(log.get_changes(start - 1, added, removed));
+    // or one from a later run of the daemon
+    ASSERT_FALSE(log.get_changes(start + 1, added, removed));
+
+    for (uint64_t n = 0; n < 5; ++n)
+      log.record(make_hash(n), true);
+    // the first two changes fell off the log
+    ASSERT_FALSE(log.get_changes(start, added, removed));
+    ASSERT_FALSE(log.get_changes(start + 1, added, removed));
+    ASSERT_TRUE(log.get_changes(start + 2, added, removed));
+    ASSERT_EQ(3, added.size());
+    ASSERT_TRUE(removed.empty());
+  }
+
+  // answers the wallet's pool calls from a script
+  class fake_daemon: public epee::http_server_impl_base<fake_daemon>
+  {
+  public:
+    typedef epee::net_utils::connection_context_base connection_context;
+
+    fake_daemon(): m_delta_supported(true), m_delta_timeouts(0), m_delta_calls(0), m_pool_calls(0) {}
+
+    void add_tx(uint64_t n)
+    {
+      cryptonote::transaction tx;
+      tx.version = 1;
+      tx.unlock_time = n;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_txs[cryptonote::get_transaction_hash(tx)] = cryptonote::tx_to_blob(tx);
+    }
+
+    crypto::hash get_txid(uint64_t n)
+    {
+      cryptonote::transaction tx;
+      tx.version = 1;
+      tx.unlock_time = n;
+      return cryptonote::get_transaction_hash(tx);
+    }
+
+    void push_delta(bool full, uint64_t version, const std::vector<uint64_t> &added, const std::vector<uint64_t> &removed)
+    {
+      cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response res;
+      res.status = CORE_RPC_STATUS_OK;
+      res.full = full;
+      res.version = version;
+      for (uint64_t n: added)
+      {
+        add_tx(n);
+        res.added.push_back(get_txid(n));
+      }
+      for (uint64_t n: removed)
+        res.removed.push_back(get_txid(n));
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_deltas.push_back(res);
+    }
+
+    void set_pool(const std::vector<uint64_t> &pool)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pool.clear();
+      for (uint64_t n: pool)
+        m_pool.push_back(get_txid(n));
+    }
+
+    std::vector<crypto::hash> take_fetched()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::vector<crypto::hash> fetched;
+      fetched.swap(m_fetched);
+      sort_hashes(fetched);
+      return fetched;
+    }
+
+    std::vector<crypto::hash> txids(const std::vector<uint64_t> &txes)
+    {
+      std::vector<crypto::hash> ids;
+      for (uint64_t n: txes)
+        ids.push_back(get_txid(n));
+      sort_hashes(ids);
+      return ids;
+    }
+
+    std::mutex m_mutex;
+    bool m_delta_supported;
+    size_t m_delta_timeouts; // delta calls still to be answered as by a proxy that timed out
+    size_t m_delta_calls;
+    size_t m_pool_calls;
+    std::vector<uint64_t> m_since_versions;
+
+  private:
+    CHAIN_HTTP_TO_MAP2(connection_context);
+
+    BEGIN_URI_MAP2()
+      else if (query_info.m_URI == "/get_transaction_pool_delta.bin" && !answer_delta(response_info)) return true;
+      MAP_URI_AUTO_BIN2("/get_transaction_pool_delta.bin", on_get_transaction_pool_delta, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA)
+      MAP_URI_AUTO_JON2("/get_transaction_pool", on_get_transaction_pool, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL)
+      MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, cryptonote::COMMAND_RPC_GET_TRANSACTIONS)
+    END_URI_MAP2()
+
+    // false when the delta call gets an error status instead of an answer
+    bool answer_delta(epee::net_utils::http::http_response_info& response_info)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_delta_calls;
+      if (!m_delta_supported)
+      {
+        // an older daemon does not know the call
+        response_info.m_response_code = 404;
+        response_info.m_response_comment = "Not found";
+        return false;
+      }
+      if (m_delta_timeouts)
+      {
+        --m_delta_timeouts;
+        response_info.m_response_code = 504;
+        response_info.m_response_comment = "Gateway Timeout";
+        return false;
+      }
+      return true;
+    }
+    bool on_get_transaction_pool_delta(const cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request& req, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response& res)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_deltas.empty())
+        return false;
+      m_since_versions.push_back(req.since_version);
+      res = m_deltas.front();
+      m_deltas.pop_front();
+      return true;
+    }
+
+    bool on_get_transaction_pool(const cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::request& req, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL::response& res)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_pool_calls;
+      for (const auto &txid: m_pool)
+      {
+        cryptonote::tx_info info;
+        info.id_hash = epee::string_tools::pod_to_hex(txid);
+        res.transactions.push_back(info);
+      }
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    bool on_get_transactions(const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request& req, cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response& res)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const auto &hex: req.txs_hashes)
+      {
+        crypto::hash txid;
+        if (!epee::string_tools::hex_to_pod(hex, txid))
+          return false;
+        m_fetched.push_back(txid);
+        auto i = m_txs.find(txid);
+        if (i == m_txs.end())
+        {
+          res.missed_tx.push_back(hex);
+          continue;
+        }
+        cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry e;
+        e.tx_hash = hex;
+        e.as_hex = epee::string_tools::buff_to_hex_nodelimer(i->second);
+        e.in_pool = true;
+        e.block_height = 0;
+        res.txs.push_back(e);
+      }
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    std::deque<cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response> m_deltas;
+    std::vector<crypto::hash> m_pool;
+    std::unordered_map<crypto::hash, cryptonote::blobdata> m_txs;
+    std::vector<crypto::hash> m_fetched;
+  };
+
+  class wallet_pool_state: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_daemon.init("0", "127.0.0.1"));
+      ASSERT_TRUE(m_daemon.run(2, false));
+      m_daemon_address = "http://127.0.0.1:" + std::to_string(m_daemon.get_binded_port());
+      m_wallet.init(m_daemon_address);
+    }
+
+    virtual void TearDown()
+    {
+      m_daemon.send_stop_signal();
+      m_daemon.timed_wait_server_stop(5000);
+      m_daemon.deinit();
+    }
+
+    fake_daemon m_daemon;
+    std::string m_daemon_address;
+    tools::wallet2 m_wallet;
+  };
+
+  TEST_F(wallet_pool_state, applies_deltas)
+  {
+    // no blobs are sent along, so the wallet fetches every tx it sees as new
+    m_daemon.push_delta(true, 100, {1, 2}, {});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({1, 2}), m_daemon.take_fetched());
+
+    m_daemon.push_delta(false, 102, {3}, {1});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({3}), m_daemon.take_fetched());
+
+    // 1 was removed, so it is new again
+    m_daemon.push_delta(false, 103, {1}, {});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({1}), m_daemon.take_fetched());
+
+    // the version fell off the daemon's log, the whole pool comes back and
+    // only what the wallet did not have is new
+    m_daemon.push_delta(true, 500, {1, 2, 3, 4}, {});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({4}), m_daemon.take_fetched());
+
+    m_daemon.push_delta(false, 501, {}, {});
+    m_wallet.update_pool_state();
+    ASSERT_TRUE(m_daemon.take_fetched().empty());
+
+    std::lock_guard<std::mutex> lock(m_daemon.m_mutex);
+    ASSERT_EQ(std::vector<uint64_t>({0, 100, 102, 103, 500}), m_daemon.m_since_versions);
+    ASSERT_EQ(0, m_daemon.m_pool_calls);
+  }
+
+  TEST_F(wallet_pool_state, falls_back_to_whole_pool)
+  {
+    m_daemon.m_delta_supported = false;
+    m_daemon.add_tx(1);
+    m_daemon.add_tx(2);
+    m_daemon.set_pool({1, 2});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({1, 2}), m_daemon.take_fetched());
+
+    m_daemon.add_tx(3);
+    m_daemon.set_pool({2, 3});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({3}), m_daemon.take_fetched());
+    {
+      // the delta call is not tried again for this daemon
+      std::lock_guard<std::mutex> lock(m_daemon.m_mutex);
+      ASSERT_EQ(1, m_daemon.m_delta_calls);
+      ASSERT_EQ(2, m_daemon.m_pool_calls);
+    }
+
+    // but it is once the wallet is pointed at a daemon again
+    m_wallet.init(m_daemon_address);
+    m_wallet.update_pool_state();
+    std::lock_guard<std::mutex> lock(m_daemon.m_mutex);
+    ASSERT_EQ(2, m_daemon.m_delta_calls);
+    ASSERT_EQ(3, m_daemon.m_pool_calls);
+  }
+
+  TEST_F(wallet_pool_state, retries_delta_after_a_timeout)
+  {
+    // the delta call times out once, the whole pool stands in for it
+    m_daemon.m_delta_timeouts = 1;
+    m_daemon.add_tx(1);
+    m_daemon.set_pool({1});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({1}), m_daemon.take_fetched());
+
+    // and the wallet goes back to deltas on the next update
+    m_daemon.push_delta(false, 200, {2}, {});
+    m_wallet.update_pool_state();
+    ASSERT_EQ(m_daemon.txids({2}), m_daemon.take_fetched());
+    std::lock_guard<std::mutex> lock(m_daemon.m_mutex);
+    ASSERT_EQ(2, m_daemon.m_delta_calls);
+    ASSERT_EQ(1, m_daemon.m_pool_calls);
+  }
+}
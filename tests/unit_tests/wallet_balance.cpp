@@ -0,0 +1,159 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "wallet_test_utils.h"
+
+namespace
+{
+  class wallet_balance: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_daemon.init("0", "127.0.0.1"));
+      ASSERT_TRUE(m_daemon.run(2, false));
+      unit_test::init_wallet(m_wallet, m_daemon);
+      m_other.generate();
+      m_daemon.add_block();
+      m_daemon.refresh(m_wallet, 0);
+    }
+
+    virtual void TearDown()
+    {
+      m_daemon.send_stop_signal();
+      m_daemon.timed_wait_server_stop(5000);
+      m_daemon.deinit();
+    }
+
+    // adds a block and feeds it to the wallet
+    void mine(const std::vector<cryptonote::transaction> &txes = std::vector<cryptonote::transaction>())
+    {
+      const uint64_t height = m_daemon.add_block(txes);
+      ASSERT_EQ(1, m_daemon.refresh(m_wallet, height));
+    }
+
+    cryptonote::transaction pay_wallet(uint64_t amount, uint64_t unlock_time = 0)
+    {
+      return unit_test::make_payment(m_wallet.get_account().get_keys().m_account_address, amount, cryptonote::null_hash, unlock_time);
+    }
+
+    // the unspent transfer of that amount
+    crypto::key_image key_image(uint64_t amount)
+    {
+      tools::wallet2::transfer_container transfers;
+      m_wallet.get_transfers(transfers);
+      for (const auto &td: transfers)
+        if (!td.m_spent && td.amount() == amount)
+          return td.m_key_image;
+      ADD_FAILURE() << "no unspent transfer of " << amount;
+      return crypto::key_image();
+    }
+
+    // checks the running balances against going through every transfer, like they used to be computed
+    void check_balances()
+    {
+      const uint64_t height = m_daemon.height();
+      const uint64_t now = time(NULL);
+      uint64_t balance = 0, unlocked = 0;
+      tools::wallet2::transfer_container transfers;
+      m_wallet.get_transfers(transfers);
+      for (const auto &td: transfers)
+      {
+        if (td.m_spent)
+          continue;
+        balance += td.amount();
+        if (td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > height)
+          continue;
+        if (td.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER ? height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= td.m_unlock_time
+            : now + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V1 >= td.m_unlock_time)
+          unlocked += td.amount();
+      }
+      ASSERT_EQ(balance, m_wallet.balance());
+      ASSERT_EQ(unlocked, m_wallet.unlocked_balance());
+    }
+
+    unit_test::wallet_test_daemon m_daemon;
+    tools::wallet2 m_wallet;
+    cryptonote::account_base m_other;
+  };
+}
+
+TEST_F(wallet_balance, matches_recompute)
+{
+  // at heights 1 to 4: plain, locked until height 20, locked until a time to
+  // come, and locked until a time gone
+  mine({pay_wallet(1000)});
+  mine({pay_wallet(2000, 20)});
+  mine({pay_wallet(4000, time(NULL) + 100000)});
+  mine({pay_wallet(8000, 600000000)});
+  check_balances();
+  ASSERT_EQ(15000, m_wallet.balance());
+  ASSERT_EQ(0, m_wallet.unlocked_balance());
+
+  // the outputs unlock one after the other as the chain grows
+  while (m_daemon.height() < 20)
+  {
+    mine();
+    check_balances();
+  }
+  ASSERT_EQ(15000, m_wallet.balance());
+  ASSERT_EQ(11000, m_wallet.unlocked_balance());
+
+  // spend with change, then without
+  cryptonote::transaction tx = pay_wallet(300);
+  unit_test::add_spend(tx, key_image(1000), 1000);
+  mine({tx});
+  check_balances();
+  ASSERT_EQ(14300, m_wallet.balance());
+
+  tx = unit_test::make_payment(m_other.get_keys().m_account_address, 8000);
+  unit_test::add_spend(tx, key_image(8000), 8000);
+  mine({tx});
+  check_balances();
+  ASSERT_EQ(6300, m_wallet.balance());
+
+  // a reorg drops both spends and the change, and brings in another payment
+  m_daemon.pop_blocks(18);
+  m_daemon.add_block({pay_wallet(500)});
+  m_daemon.refresh(m_wallet, 17);
+  check_balances();
+  for (int n = 0; n < 12; ++n)
+  {
+    mine();
+    check_balances();
+  }
+
+  // and another one takes the payments from heights 3 and 4 away
+  m_daemon.pop_blocks(3);
+  m_daemon.add_block();
+  m_daemon.refresh(m_wallet, 2);
+  check_balances();
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "wallet_test_utils.h"
+
+namespace
+{
+  crypto::hash make_hash(uint64_t n)
+  {
+    crypto::hash h = cryptonote::null_hash;
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  const crypto::hash payment_a = make_hash(1);
+  const crypto::hash payment_b = make_hash(2);
+
+  typedef std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payment_list;
+
+  std::vector<uint64_t> heights(const payment_list &payments)
+  {
+    std::vector<uint64_t> h;
+    for (const auto &p: payments)
+      h.push_back(p.second.m_block_height);
+    return h;
+  }
+
+  std::vector<uint64_t> heights(const std::list<tools::wallet2::payment_details> &payments)
+  {
+    std::vector<uint64_t> h;
+    for (const auto &p: payments)
+      h.push_back(p.m_block_height);
+    std::sort(h.begin(), h.end());
+    return h;
+  }
+
+  class wallet_payments: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_daemon.init("0", "127.0.0.1"));
+      ASSERT_TRUE(m_daemon.run(2, false));
+      unit_test::init_wallet(m_wallet, m_daemon);
+      m_daemon.add_block();
+    }
+
+    virtual void TearDown()
+    {
+      m_daemon.send_stop_signal();
+      m_daemon.timed_wait_server_stop(5000);
+      m_daemon.deinit();
+    }
+
+    // a block paying the wallet once for each of the payment ids
+    std::vector<cryptonote::transaction> receive(const std::vector<crypto::hash> &payment_ids)
+    {
+      std::vector<cryptonote::transaction> txes;
+      for (const auto &payment_id: payment_ids)
+        txes.push_back(unit_test::make_payment(m_wallet.get_account().get_keys().m_account_address, 1000, payment_id));
+      m_daemon.add_block(txes);
+      return txes;
+    }
+
+    // payments at heights 1: a, 2: a and b, 3: a twice, 4: b, 5: a
+    void receive_payments()
+    {
+      receive({payment_a});
+      receive({payment_a, payment_b});
+      receive({payment_a, payment_a});
+      receive({payment_b});
+      receive({payment_a});
+      ASSERT_EQ(6, m_daemon.refresh(m_wallet, 0));
+    }
+
+    // the heights of a page of the payments, and whether there are more
+    std::pair<std::vector<uint64_t>, bool> page(const std::vector<crypto::hash> &payment_ids, uint64_t min_height, size_t max_count)
+    {
+      payment_list payments;
+      const bool more = m_wallet.get_payments(payment_ids, payments, min_height, max_count);
+      return std::make_pair(heights(payments), more);
+    }
+
+    unit_test::wallet_test_daemon m_daemon;
+    tools::wallet2 m_wallet;
+  };
+
+  typedef std::pair<std::vector<uint64_t>, bool> page_t;
+}
+
+TEST_F(wallet_payments, pages_never_split_a_height)
+{
+  receive_payments();
+
+  // each page starts above the last height of the one before
+  ASSERT_EQ(page_t({1, 2, 2}, true), page({payment_a, payment_b}, 0, 2));
+  ASSERT_EQ(page_t({3, 3}, true), page({payment_a, payment_b}, 2, 2));
+  ASSERT_EQ(page_t({4, 5}, false), page({payment_a, payment_b}, 3, 2));
+
+  ASSERT_EQ(page_t({1}, true), page({payment_a}, 0, 1));
+  ASSERT_EQ(page_t({2}, true), page({payment_a}, 1, 1));
+  ASSERT_EQ(page_t({3, 3}, true), page({payment_a}, 2, 1));
+  ASSERT_EQ(page_t({5}, false), page({payment_a}, 3, 1));
+
+  // no payment ids is all of them
+  ASSERT_EQ(page_t({1, 2, 2}, true), page({}, 0, 3));
+  ASSERT_EQ(page_t({3, 3, 4}, true), page({}, 2, 3));
+  ASSERT_EQ(page_t({5}, false), page({}, 4, 3));
+
+  // a page exactly as large as what is left
+  ASSERT_EQ(page_t({4, 5}, false), page({}, 3, 2));
+
+  // no limit
+  ASSERT_EQ(page_t({1, 2, 2, 3, 3, 4, 5}, false), page({}, 0, 0));
+  ASSERT_EQ(page_t({2, 4}, false), page({payment_b}, 0, 0));
+}
+
+TEST_F(wallet_payments, empty_results)
+{
+  // nothing received yet
+  ASSERT_EQ(page_t({}, false), page({}, 0, 10));
+  ASSERT_EQ(page_t({}, false), page({payment_a}, 0, 0));
+  payment_list payments;
+  m_wallet.get_payments(payments, 0);
+  ASSERT_TRUE(payments.empty());
+
+  receive_payments();
+
+  // an unknown payment id, or nothing above the given height
+  ASSERT_EQ(page_t({}, false), page({make_hash(3)}, 0, 10));
+  ASSERT_EQ(page_t({}, false), page({payment_a, payment_b}, 5, 10));
+  ASSERT_EQ(page_t({}, false), page({}, 5, 1));
+
+  std::list<tools::wallet2::payment_details> id_payments;
+  m_wallet.get_payments(make_hash(3), id_payments);
+  ASSERT_TRUE(id_payments.empty());
+  m_wallet.get_payments(payment_b, id_payments, 4);
+  ASSERT_TRUE(id_payments.empty());
+
+  // empty height ranges
+  m_wallet.get_payments(payments, 5);
+  ASSERT_TRUE(payments.empty());
+  m_wallet.get_payments(payments, 3, 3);
+  ASSERT_TRUE(payments.empty());
+  m_wallet.get_payments(payments, 4, 2);
+  ASSERT_TRUE(payments.empty());
+}
+
+TEST_F(wallet_payments, indices_follow_detach)
+{
+  receive_payments();
+
+  // the chain forks above height 2: the payments at 3 to 5 go, and new ones come at 3 and 4
+  m_daemon.pop_blocks(3);
+  const crypto::hash txid_b = cryptonote::get_transaction_hash(receive({payment_b}).front());
+  const crypto::hash txid_a = cryptonote::get_transaction_hash(receive({payment_a}).front());
+  ASSERT_EQ(1, m_daemon.refresh(m_wallet, 2));
+
+  // by payment id
+  std::list<tools::wallet2::payment_details> id_payments;
+  m_wallet.get_payments(payment_a, id_payments);
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 4}), heights(id_payments));
+  ASSERT_EQ(txid_a, id_payments.back().m_tx_hash);
+  id_payments.clear();
+  m_wallet.get_payments(payment_b, id_payments);
+  ASSERT_EQ(std::vector<uint64_t>({2, 3}), heights(id_payments));
+
+  // by height
+  payment_list payments;
+  m_wallet.get_payments(payments, 0);
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 2, 3, 4}), heights(payments));
+  payments.clear();
+  m_wallet.get_payments(payments, 2);
+  ASSERT_EQ(std::vector<uint64_t>({3, 4}), heights(payments));
+  ASSERT_EQ(payment_b, payments.front().first);
+  ASSERT_EQ(txid_b, payments.front().second.m_tx_hash);
+
+  // and paged
+  ASSERT_EQ(page_t({1, 2, 2, 3, 4}, false), page({}, 0, 0));
+  ASSERT_EQ(page_t({2, 2}, true), page({payment_b, payment_a}, 1, 2));
+  ASSERT_EQ(page_t({3, 4}, false), page({payment_b, payment_a}, 2, 2));
+
+  // and later blocks are indexed as before
+  receive({payment_b});
+  ASSERT_EQ(1, m_daemon.refresh(m_wallet, 4));
+  ASSERT_EQ(page_t({4, 5}, false), page({payment_a, payment_b}, 3, 0));
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "gtest/gtest.h"
+
+#include "wallet/wallet_scanner.h"
+#include "wallet_test_utils.h"
+
+namespace
+{
+  class wallet_scanner: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_daemon.init("0", "127.0.0.1"));
+      ASSERT_TRUE(m_daemon.run(2, false));
+      unit_test::init_wallet(m_alice, m_daemon);
+      unit_test::init_wallet(m_bob, m_daemon);
+      m_scanner.add_wallet(&m_alice);
+      m_scanner.add_wallet(&m_bob);
+      m_daemon.add_block();
+    }
+
+    virtual void TearDown()
+    {
+      m_daemon.send_stop_signal();
+      m_daemon.timed_wait_server_stop(5000);
+      m_daemon.deinit();
+    }
+
+    cryptonote::transaction pay(const tools::wallet2 &wallet, uint64_t amount)
+    {
+      return unit_test::make_payment(wallet.get_account().get_keys().m_account_address, amount);
+    }
+
+    unit_test::wallet_test_daemon m_daemon;
+    tools::wallet2 m_alice;
+    tools::wallet2 m_bob;
+    tools::wallet_scanner m_scanner;
+  };
+}
+
+TEST_F(wallet_scanner, two_accounts_from_one_batch)
+{
+  m_daemon.add_block({pay(m_alice, 1000)});
+  m_daemon.add_block({pay(m_bob, 2000)});
+  m_daemon.add_block();
+  m_daemon.add_block({pay(m_alice, 30), pay(m_bob, 40)});
+
+  uint64_t blocks_fetched = 0;
+  m_scanner.refresh(blocks_fetched);
+
+  // one batch with every block, then one finding nothing new
+  EXPECT_EQ(2, m_daemon.getblocks_calls());
+  EXPECT_EQ(m_daemon.height(), blocks_fetched);
+  EXPECT_EQ(m_daemon.height(), m_alice.get_blockchain_current_height());
+  EXPECT_EQ(m_daemon.height(), m_bob.get_blockchain_current_height());
+  EXPECT_EQ(1030, m_alice.balance());
+  EXPECT_EQ(2040, m_bob.balance());
+
+  tools::wallet2::transfer_container transfers;
+  m_alice.get_transfers(transfers);
+  EXPECT_EQ(2, transfers.size());
+  m_bob.get_transfers(transfers);
+  EXPECT_EQ(2, transfers.size());
+}
+
+TEST_F(wallet_scanner, wallet_ahead_sees_only_new_blocks)
+{
+  m_daemon.add_block({pay(m_alice, 1000), pay(m_bob, 2000)});
+  m_daemon.refresh(m_alice, 0);
+  ASSERT_EQ(1000, m_alice.balance());
+
+  m_daemon.add_block({pay(m_alice, 30), pay(m_bob, 40)});
+
+  uint64_t blocks_fetched = 0;
+  m_scanner.refresh(blocks_fetched);
+
+  // bob drives the download from the start, alice only processes the new block
+  EXPECT_EQ(2, m_daemon.getblocks_calls());
+  EXPECT_EQ(m_daemon.height(), blocks_fetched);
+  EXPECT_EQ(m_daemon.height(), m_alice.get_blockchain_current_height());
+  EXPECT_EQ(m_daemon.height(), m_bob.get_blockchain_current_height());
+  EXPECT_EQ(1030, m_alice.balance());
+  EXPECT_EQ(2040, m_bob.balance());
+}
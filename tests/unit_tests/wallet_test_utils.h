@@ -0,0 +1,233 @@
+// Copyright (c) 2014-2016, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "include_base_utils.h"
+#include "net/http_server_impl_base.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+
+using namespace epee;
+
+namespace unit_test
+{
+  /*!
+   * \brief A chain of blocks for wallet tests, served like a daemon would
+   *
+   * Blocks are fed to the wallet through process_parsed_blocks, or pulled
+   * from /getblocks.bin; the daemon answers the calls the wallet makes while
+   * processing them.
+   */
+  class wallet_test_daemon: public epee::http_server_impl_base<wallet_test_daemon>
+  {
+  public:
+    typedef epee::net_utils::connection_context_base connection_context;
+
+    wallet_test_daemon(): m_nonce(0), m_num_outputs(0), m_getblocks_calls(0) {}
+
+    //! appends a block carrying these txes, and returns its height
+    uint64_t add_block(const std::vector<cryptonote::transaction> &txes = std::vector<cryptonote::transaction>())
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      cryptonote::block b = AUTO_VAL_INIT(b);
+      b.major_version = 1;
+      b.timestamp = time(NULL);
+      // a block added again after pop_blocks gets another hash
+      b.nonce = ++m_nonce;
+      if (!m_blocks.empty())
+        b.prev_id = cryptonote::get_block_hash(m_block_list.back());
+      cryptonote::block_complete_entry bce;
+      for (const auto &tx: txes)
+      {
+        const crypto::hash txid = cryptonote::get_transaction_hash(tx);
+        b.tx_hashes.push_back(txid);
+        bce.txs.push_back(cryptonote::tx_to_blob(tx));
+        std::vector<uint64_t> &indices = m_output_indices[txid];
+        for (size_t n = 0; n < tx.vout.size(); ++n)
+          indices.push_back(m_num_outputs++);
+      }
+      bce.block = cryptonote::block_to_blob(b);
+      m_blocks.push_back(bce);
+      m_block_list.push_back(b);
+      return m_blocks.size() - 1;
+    }
+
+    //! drops the blocks from this height on, the next ones added make a fork
+    void pop_blocks(uint64_t height)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_blocks.resize(height);
+      m_block_list.resize(height);
+    }
+
+    uint64_t height()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_blocks.size();
+    }
+
+    //! the blocks from start_height on, as the wallet gets them
+    std::vector<tools::wallet2::parsed_block> get_blocks(uint64_t start_height)
+    {
+      std::vector<cryptonote::block_complete_entry> blocks;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        blocks.assign(m_blocks.begin() + start_height, m_blocks.end());
+      }
+      std::vector<tools::wallet2::parsed_block> parsed_blocks;
+      tools::wallet2::parse_blocks(blocks, parsed_blocks);
+      return parsed_blocks;
+    }
+
+    //! feeds the wallet the blocks from start_height on
+    uint64_t refresh(tools::wallet2 &wallet, uint64_t start_height)
+    {
+      uint64_t blocks_added = 0;
+      wallet.process_parsed_blocks(start_height, get_blocks(start_height), blocks_added);
+      return blocks_added;
+    }
+
+    //! how many times /getblocks.bin was called
+    size_t getblocks_calls()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_getblocks_calls;
+    }
+
+  private:
+    CHAIN_HTTP_TO_MAP2(connection_context);
+
+    BEGIN_URI_MAP2()
+      MAP_URI_AUTO_BIN2("/getblocks.bin", on_get_blocks, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST)
+      MAP_URI_AUTO_BIN2("/get_o_indexes.bin", on_get_indexes, cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES)
+      MAP_URI_AUTO_BIN2("/get_transaction_pool_delta.bin", on_get_pool_delta, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA)
+    END_URI_MAP2()
+
+    //! the blocks from the most recent one the wallet knows, all of them if it knows none
+    bool on_get_blocks(const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request& req, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response& res)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_getblocks_calls;
+      res.start_height = 0;
+      for (const crypto::hash &id: req.block_ids)
+      {
+        auto i = std::find_if(m_block_list.begin(), m_block_list.end(),
+          [&id](const cryptonote::block &b) { return cryptonote::get_block_hash(b) == id; });
+        if (i != m_block_list.end())
+        {
+          res.start_height = i - m_block_list.begin();
+          break;
+        }
+      }
+      res.blocks.assign(m_blocks.begin() + res.start_height, m_blocks.end());
+      res.current_height = m_blocks.size();
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    bool on_get_indexes(const cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto i = m_output_indices.find(req.txid);
+      if (i == m_output_indices.end())
+        return false;
+      res.o_indexes = i->second;
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    //! the pool is always empty
+    bool on_get_pool_delta(const cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::request& req, cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_DELTA::response& res)
+    {
+      res.version = 1;
+      res.full = true;
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    std::mutex m_mutex;
+    std::vector<cryptonote::block_complete_entry> m_blocks;
+    std::vector<cryptonote::block> m_block_list;
+    std::unordered_map<crypto::hash, std::vector<uint64_t>> m_output_indices;
+    uint64_t m_nonce;
+    uint64_t m_num_outputs;
+    size_t m_getblocks_calls;
+  };
+
+  //! a tx paying amount to the address, with an unencrypted payment id unless it is null
+  inline cryptonote::transaction make_payment(const cryptonote::account_public_address &to, uint64_t amount,
+    const crypto::hash &payment_id = cryptonote::null_hash, uint64_t unlock_time = 0)
+  {
+    cryptonote::transaction tx;
+    tx.version = 1;
+    tx.unlock_time = unlock_time;
+    const cryptonote::keypair tx_key = cryptonote::keypair::generate();
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+    if (payment_id != cryptonote::null_hash)
+    {
+      cryptonote::blobdata extra_nonce;
+      cryptonote::set_payment_id_to_tx_extra_nonce(extra_nonce, payment_id);
+      cryptonote::add_extra_nonce_to_tx_extra(tx.extra, extra_nonce);
+    }
+    crypto::key_derivation derivation;
+    crypto::public_key out_key;
+    crypto::generate_key_derivation(to.m_view_public_key, tx_key.sec, derivation);
+    crypto::derive_public_key(derivation, 0, to.m_spend_public_key, out_key);
+    cryptonote::tx_out out;
+    out.amount = amount;
+    out.target = cryptonote::txout_to_key(out_key);
+    tx.vout.push_back(out);
+    return tx;
+  }
+
+  //! adds an input spending the output with this key image, the wallet does not check signatures
+  inline void add_spend(cryptonote::transaction &tx, const crypto::key_image &key_image, uint64_t amount)
+  {
+    cryptonote::txin_to_key in;
+    in.amount = amount;
+    in.key_offsets.push_back(0);
+    in.k_image = key_image;
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(1));
+  }
+
+  //! a wallet with a new account, using the daemon
+  inline void init_wallet(tools::wallet2 &wallet, wallet_test_daemon &daemon)
+  {
+    wallet.init("http://127.0.0.1:" + std::to_string(daemon.get_binded_port()));
+    wallet.get_account().generate();
+  }
+}